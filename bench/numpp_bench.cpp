@@ -0,0 +1,509 @@
+/*
+ * Performance suite of NumPP, in the style of Google Benchmark.
+ *
+ * Every benchmark runs its operation repeatedly until it has taken at least --benchmark_min_time seconds
+ * and reports the time per iteration, GFLOP/s (for operations with a known operation count)
+ * and the bytes and number of matrix allocations per iteration.
+ * With --benchmark_format=json (or --benchmark_out=<file>) the results are written as JSON,
+ * so two builds can be compared by diffing their output.
+ *
+ * Usage: numpp_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]
+ *                    [--benchmark_max_size=<n>] [--benchmark_format=console|json]
+ *                    [--benchmark_out=<file>] [--benchmark_list_tests]
+ * */
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NumPP/Matrix2D"
+
+/*
+ * Matrix sizes every benchmark runs at (n by n matrices).
+ * */
+const size_t SIZES[] = {2, 4, 16, 64, 256, 1024, 4096};
+
+/*
+ * Iteration counts grow until a run takes at least the minimum time, but never beyond this.
+ * */
+const size_t MAX_ITERATIONS = 1000000000;
+
+/*
+ * Forwards to another resource and counts what is allocated through it.
+ * Installed as the default resource while a benchmark is measured, so it sees the storage of every matrix
+ * created by the operation (scratch buffers taken from numpp::pool_resource() are not counted).
+ * */
+class CountingResource : public numpp::MemoryResource {
+private:
+    numpp::MemoryResource* _upstream;
+    std::atomic<size_t> _bytes;
+    std::atomic<size_t> _allocations;
+public:
+    explicit CountingResource(numpp::MemoryResource* upstream) : _upstream(upstream), _bytes(0), _allocations(0) {}
+
+    void* allocate(size_t bytes, size_t alignment) override {
+        _bytes += bytes;
+        _allocations++;
+        return _upstream->allocate(bytes, alignment);
+    }
+
+    void deallocate(void* p, size_t bytes, size_t alignment) override {
+        _upstream->deallocate(p, bytes, alignment);
+    }
+
+    void reset() {
+        _bytes = 0;
+        _allocations = 0;
+    }
+
+    size_t bytes() const {
+        return _bytes;
+    }
+
+    size_t allocations() const {
+        return _allocations;
+    }
+};
+
+/*
+ * Keep the compiler from removing a computation whose result is otherwise unused.
+ * */
+template <class T>
+void doNotOptimize(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Benchmark {
+    std::string name;
+    double flops;
+
+    /*
+     * Prepares the inputs (not measured) and returns the operation to measure.
+     * */
+    std::function<std::function<void()>()> setup;
+};
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    double real_time;    // Nanoseconds per iteration
+    double cpu_time;     // Nanoseconds per iteration, summed over all threads of the process
+    double gflops;
+    double bytes_allocated;
+    double allocations;
+};
+
+double processCpuSeconds() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+/*
+ * A well-conditioned n by n matrix, safe to invert and eliminate.
+ * */
+numpp::Matrix wellConditioned(size_t n) {
+    numpp::Matrix res = numpp::random(n, n, -10, 10);
+    for (size_t i = 0; i < n; i++) {
+        res[static_cast<int>(i)][static_cast<int>(i)] = 20.0 * static_cast<double>(n);
+    }
+    return res;
+}
+
+std::vector<Benchmark> makeBenchmarks(size_t max_size) {
+    std::vector<Benchmark> benchmarks;
+    for (size_t n : SIZES) {
+        if (n > max_size) {
+            continue;
+        }
+        const double n2 = static_cast<double>(n) * static_cast<double>(n);
+        const double n3 = n2 * static_cast<double>(n);
+        const std::string size = "/" + std::to_string(n);
+        const int quarter = static_cast<int>(n / 4);
+        const int half = static_cast<int>(n / 2 > 0 ? n / 2 : 1);
+
+        benchmarks.push_back({"multiply" + size, 2 * n3, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                numpp::Matrix c = numpp::multiply(*a, *b);
+                doNotOptimize(c);
+            });
+        }});
+
+        benchmarks.push_back({"elementwise_add" + size, n2, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                numpp::Matrix c = *a + *b;
+                doNotOptimize(c);
+            });
+        }});
+
+        // Three operations fused into one pass by the expression templates.
+        benchmarks.push_back({"elementwise_fused" + size, 3 * n2, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                numpp::Matrix c = *a * *b + *a / 2.0;
+                doNotOptimize(c);
+            });
+        }});
+
+        benchmarks.push_back({"elementwise_inplace" + size, n2, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                *a += *b;
+                doNotOptimize(*a);
+            });
+        }});
+
+        benchmarks.push_back({"transpose" + size, 0, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a]() {
+                numpp::Matrix t = a->T();
+                doNotOptimize(t);
+            });
+        }});
+
+        // Copy the central n/2 by n/2 block out of the matrix.
+        benchmarks.push_back({"slice_copy" + size, 0, [n, quarter, half]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, quarter, half]() {
+                numpp::Matrix block = (*a)[{quarter, quarter + half}][{quarter, quarter + half}];
+                doNotOptimize(block);
+            });
+        }});
+
+        // Write a n/2 by n/2 matrix into the central block of the matrix.
+        benchmarks.push_back({"slice_assign" + size, 0, [n, quarter, half]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(static_cast<size_t>(half), static_cast<size_t>(half), -10, 10)));
+            return std::function<void()>([a, b, quarter, half]() {
+                (*a)[{quarter, quarter + half}][{quarter, quarter + half}] = *b;
+                doNotOptimize(*a);
+            });
+        }});
+
+        // Gaussian elimination takes about 2n^3/3 flops, Gauss-Jordan about n^3.
+        benchmarks.push_back({"upper_triangular" + size, 2 * n3 / 3, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(wellConditioned(n)));
+            return std::function<void()>([a]() {
+                numpp::Matrix u = numpp::upper_triangular(*a);
+                doNotOptimize(u);
+            });
+        }});
+
+        benchmarks.push_back({"rref" + size, n3, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(wellConditioned(n)));
+            return std::function<void()>([a]() {
+                numpp::Matrix r = numpp::rref(*a);
+                doNotOptimize(r);
+            });
+        }});
+
+        benchmarks.push_back({"determinant" + size, 2 * n3 / 3, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(wellConditioned(n)));
+            return std::function<void()>([a]() {
+                double det = numpp::determinant(*a);
+                doNotOptimize(det);
+            });
+        }});
+
+        benchmarks.push_back({"invert" + size, 2 * n3, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(wellConditioned(n)));
+            return std::function<void()>([a]() {
+                numpp::Matrix inv = numpp::invert(*a);
+                doNotOptimize(inv);
+            });
+        }});
+
+        benchmarks.push_back({"concatenate_axis0" + size, 0, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                numpp::Matrix c = numpp::concatenate(*a, *b, 0);
+                doNotOptimize(c);
+            });
+        }});
+
+        benchmarks.push_back({"concatenate_axis1" + size, 0, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            std::shared_ptr<numpp::Matrix> b(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a, b]() {
+                numpp::Matrix c = numpp::concatenate(*a, *b, 1);
+                doNotOptimize(c);
+            });
+        }});
+
+        // Sum every element through the iterator, one addition per element.
+        benchmarks.push_back({"iterate" + size, n2, [n]() {
+            std::shared_ptr<numpp::Matrix> a(new numpp::Matrix(numpp::random(n, n, -10, 10)));
+            return std::function<void()>([a]() {
+                double total = 0;
+                for (double x : *a) {
+                    total += x;
+                }
+                doNotOptimize(total);
+            });
+        }});
+    }
+    return benchmarks;
+}
+
+/*
+ * Time `iterations` calls of `run`, returning the real and CPU seconds and the allocations they made.
+ * */
+void measure(const std::function<void()>& run, size_t iterations, CountingResource& counter,
+             double& real_seconds, double& cpu_seconds) {
+    counter.reset();
+    const double cpu_begin = processCpuSeconds();
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        run();
+    }
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    cpu_seconds = processCpuSeconds() - cpu_begin;
+    real_seconds = std::chrono::duration<double>(end - begin).count();
+}
+
+Result runBenchmark(const Benchmark& benchmark, double min_time, CountingResource& counter) {
+    std::function<void()> run = benchmark.setup();
+
+    // Grow the iteration count like Google Benchmark: aim 40% past the minimum time, at most 10x per step.
+    // Short first runs also warm up caches, the thread pool and the memory pools, and are discarded.
+    numpp::MemoryResource* previous = numpp::set_default_resource(&counter);
+    size_t iterations = 1;
+    double real_seconds = 0;
+    double cpu_seconds = 0;
+    while (true) {
+        measure(run, iterations, counter, real_seconds, cpu_seconds);
+        if (real_seconds >= min_time || iterations >= MAX_ITERATIONS) {
+            break;
+        }
+        double multiplier = min_time * 1.4 / std::max(real_seconds, 1e-9);
+        multiplier = std::min(10.0, multiplier);
+        iterations = std::min(MAX_ITERATIONS, std::max(iterations + 1, static_cast<size_t>(static_cast<double>(iterations) * multiplier)));
+    }
+    numpp::set_default_resource(previous);
+
+    Result res;
+    res.name = benchmark.name;
+    res.iterations = iterations;
+    res.real_time = real_seconds * 1e9 / static_cast<double>(iterations);
+    res.cpu_time = cpu_seconds * 1e9 / static_cast<double>(iterations);
+    res.gflops = benchmark.flops > 0 ? benchmark.flops / res.real_time : 0;
+    res.bytes_allocated = static_cast<double>(counter.bytes()) / static_cast<double>(iterations);
+    res.allocations = static_cast<double>(counter.allocations()) / static_cast<double>(iterations);
+    return res;
+}
+
+std::string simdName() {
+    switch (numpp::kernels::simd_level()) {
+        case numpp::kernels::SIMD_AVX512:
+            return "avx512";
+        case numpp::kernels::SIMD_AVX2:
+            return "avx2";
+        case numpp::kernels::SIMD_SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+std::string jsonString(const std::string& text) {
+    std::string res = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+        }
+        res += c;
+    }
+    return res + "\"";
+}
+
+std::string jsonNumber(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+void writeJson(std::ostream& os, const std::vector<Result>& results, const std::string& executable) {
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+    os << "{\n";
+    os << "  \"context\": {\n";
+    os << "    \"date\": " << jsonString(date) << ",\n";
+    os << "    \"executable\": " << jsonString(executable) << ",\n";
+    os << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    os << "    \"num_threads\": " << numpp::get_num_threads() << ",\n";
+    os << "    \"simd\": " << jsonString(simdName()) << ",\n";
+#ifdef NDEBUG
+    os << "    \"library_build_type\": \"release\"\n";
+#else
+    os << "    \"library_build_type\": \"debug\"\n";
+#endif
+    os << "  },\n";
+    os << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        os << "    {\n";
+        os << "      \"name\": " << jsonString(r.name) << ",\n";
+        os << "      \"iterations\": " << r.iterations << ",\n";
+        os << "      \"real_time\": " << jsonNumber(r.real_time) << ",\n";
+        os << "      \"cpu_time\": " << jsonNumber(r.cpu_time) << ",\n";
+        os << "      \"time_unit\": \"ns\",\n";
+        os << "      \"gflops\": " << jsonNumber(r.gflops) << ",\n";
+        os << "      \"bytes_allocated\": " << jsonNumber(r.bytes_allocated) << ",\n";
+        os << "      \"allocations\": " << jsonNumber(r.allocations) << "\n";
+        os << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n";
+    os << "}\n";
+}
+
+std::string formatTime(double ns) {
+    char buffer[32];
+    if (ns >= 1e9) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f s", ns / 1e9);
+    }
+    else if (ns >= 1e6) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f ms", ns / 1e6);
+    }
+    else if (ns >= 1e3) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f us", ns / 1e3);
+    }
+    else {
+        std::snprintf(buffer, sizeof(buffer), "%.1f ns", ns);
+    }
+    return buffer;
+}
+
+void printHeader() {
+    std::printf("%-28s %14s %14s %12s %10s %16s %8s\n", "Benchmark", "Time", "CPU", "Iterations", "GFLOP/s", "Bytes/iter", "Allocs");
+    std::printf("%s\n", std::string(108, '-').c_str());
+}
+
+void printResult(const Result& r) {
+    char gflops[32] = "-";
+    if (r.gflops > 0) {
+        std::snprintf(gflops, sizeof(gflops), "%.2f", r.gflops);
+    }
+    std::printf("%-28s %14s %14s %12zu %10s %16.0f %8.1f\n", r.name.c_str(), formatTime(r.real_time).c_str(),
+                formatTime(r.cpu_time).c_str(), r.iterations, gflops, r.bytes_allocated, r.allocations);
+    std::fflush(stdout);
+}
+
+/*
+ * The value of `--name=value`, or nullptr if `arg` is another flag.
+ * */
+const char* flagValue(const char* arg, const char* name) {
+    const size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) == 0 && arg[length] == '=') {
+        return arg + length + 1;
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    std::string filter = ".";
+    double min_time = 0.5;
+    size_t max_size = 4096;
+    std::string format = "console";
+    std::string out_path;
+    bool list_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = nullptr;
+        if ((value = flagValue(argv[i], "--benchmark_filter")) != nullptr) {
+            filter = value;
+        }
+        else if ((value = flagValue(argv[i], "--benchmark_min_time")) != nullptr) {
+            min_time = std::atof(value);  // "0.5" and "0.5s" both read as seconds
+        }
+        else if ((value = flagValue(argv[i], "--benchmark_max_size")) != nullptr) {
+            max_size = static_cast<size_t>(std::atol(value));
+        }
+        else if ((value = flagValue(argv[i], "--benchmark_format")) != nullptr) {
+            format = value;
+        }
+        else if ((value = flagValue(argv[i], "--benchmark_out")) != nullptr) {
+            out_path = value;
+        }
+        else if (std::strcmp(argv[i], "--benchmark_list_tests") == 0) {
+            list_only = true;
+        }
+        else {
+            std::fprintf(stderr,
+                         "Usage: %s [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]\n"
+                         "       [--benchmark_max_size=<n>] [--benchmark_format=console|json]\n"
+                         "       [--benchmark_out=<file>] [--benchmark_list_tests]\n", argv[0]);
+            return std::strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (format != "console" && format != "json") {
+        std::fprintf(stderr, "Unknown --benchmark_format: %s\n", format.c_str());
+        return 1;
+    }
+
+    std::regex pattern;
+    try {
+        pattern = std::regex(filter);
+    }
+    catch (const std::regex_error&) {
+        std::fprintf(stderr, "Invalid --benchmark_filter: %s\n", filter.c_str());
+        return 1;
+    }
+
+    std::vector<Benchmark> selected;
+    for (const Benchmark& benchmark : makeBenchmarks(max_size)) {
+        if (std::regex_search(benchmark.name, pattern)) {
+            selected.push_back(benchmark);
+        }
+    }
+    if (list_only) {
+        for (const Benchmark& benchmark : selected) {
+            std::printf("%s\n", benchmark.name.c_str());
+        }
+        return 0;
+    }
+
+    const bool console = format == "console";
+    if (console) {
+        std::printf("Running %s\nThreads: %zu, SIMD: %s\n", argv[0], numpp::get_num_threads(), simdName().c_str());
+        printHeader();
+    }
+
+    CountingResource counter(numpp::new_delete_resource());
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : selected) {
+        results.push_back(runBenchmark(benchmark, min_time, counter));
+        if (console) {
+            printResult(results.back());
+        }
+    }
+
+    if (!console) {
+        writeJson(std::cout, results, argv[0]);
+    }
+    if (!out_path.empty()) {
+        std::ofstream out(out_path);
+        if (!out) {
+            std::fprintf(stderr, "Cannot write %s\n", out_path.c_str());
+            return 1;
+        }
+        writeJson(out, results, argv[0]);
+    }
+    return 0;
+}
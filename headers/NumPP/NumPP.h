@@ -1,8 +1,21 @@
 #include "NumPPDeclaration.h"
+#include "NumPPMemory.h"
+#include "NumPPStats.h"
+#include "NumPPParallel.h"
+#include "NumPPKernels.h"
+#include "NumPPExpression.h"
+#include "NumPPMask.h"
+#include "NumPPReduction.h"
+#include "NumPPFixed.h"
+#include "NumPPSparse.h"
+#include "NumPPBatch.h"
+#include "NumPPIO.h"
 #include <iostream>
 #include <random>
 #include <utility>
 #include <algorithm>
+#include <cstdlib>
+#include <new>
 
 namespace numpp {
     using std::cout;
@@ -19,147 +32,332 @@ namespace numpp {
         return message.c_str();
     }
 
-    Matrix::Matrix(Vector2D vector2d) : _matrix(std::move(vector2d)){}
+    IOException::IOException(std::string msg) : message(std::move(msg)) {
+        if (show_numpp_exception_details)
+            cout << "NumPP Exception: " << message << endl;
+    }
+
+    const char* IOException::what() const noexcept {
+        return message.c_str();
+    }
 
-    Matrix::Matrix(std::initializer_list<std::vector<double>> initList) {
-        Vector2D res;
-        for (const std::vector<double>& rowVec : initList) {
-            res.emplace_back(rowVec);
+    template <class Scalar>
+    Scalar* BasicAlignedBuffer<Scalar>::allocate(size_t size) {
+        if (size == 0) {
+            return nullptr;
         }
-        _matrix = res;
+        NUMPP_STATS_ALLOCATION(size * sizeof(Scalar));
+        return static_cast<Scalar*>(_resource->allocate(size * sizeof(Scalar), alignment));
     }
 
-    Matrix::Matrix(MatrixSection matrixSection) : _matrix(matrixSection._matrix) {}
+    template <class Scalar>
+    void BasicAlignedBuffer<Scalar>::deallocate() {
+        if (_data != nullptr) {
+            _resource->deallocate(_data, _size * sizeof(Scalar), alignment);
+        }
+    }
 
-    Matrix::Matrix(size_t m, size_t n, double number = 0) : _matrix(Vector2D(m, std::vector<double>(n,number))) {}
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::BasicAlignedBuffer() : _data(nullptr), _size(0), _resource(get_default_resource()) {}
 
-    Matrix::Matrix(const Matrix &other) = default;
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::BasicAlignedBuffer(size_t size, MemoryResource* resource) :
+            _data(nullptr), _size(size), _resource(resource) {
+        _data = allocate(size);
+    }
 
-    Matrix::Matrix(Matrix&& other) noexcept : _matrix(std::move(other._matrix)) {}
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::BasicAlignedBuffer(Scalar* data, size_t size, MemoryResource* resource) :
+            _data(data), _size(size), _resource(resource) {}
+
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::BasicAlignedBuffer(const BasicAlignedBuffer<Scalar>& other) : BasicAlignedBuffer<Scalar>(other._size) {
+        std::copy(other._data, other._data + other._size, _data);
+    }
 
-    Matrix Matrix::operator*(double other) const {
-        Matrix product_mat = *this;
-        std::transform(product_mat.begin(), product_mat.end(),  product_mat.begin(),
-                       [other](double elem)->double{return elem * other;});
-        return product_mat;
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::BasicAlignedBuffer(BasicAlignedBuffer<Scalar>&& other) noexcept :
+            _data(other._data), _size(other._size), _resource(other._resource) {
+        other._data = nullptr;
+        other._size = 0;
     }
 
-    Matrix Matrix::operator*(const Matrix &other) const {
-        if (!(this->shape()[0] == other.shape()[0] && this->shape()[1] == other.shape()[1])) {
-            throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same."};
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>& BasicAlignedBuffer<Scalar>::operator=(const BasicAlignedBuffer<Scalar>& other) {
+        if (this != &other) {
+            if (_size != other._size) {
+                BasicAlignedBuffer<Scalar> buffer(other._size, _resource);
+                swap(buffer);
+            }
+            std::copy(other._data, other._data + other._size, _data);
+        }
+        return *this;
+    }
+
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>& BasicAlignedBuffer<Scalar>::operator=(BasicAlignedBuffer<Scalar>&& other) {
+        if (this != &other) {
+            if (_resource != other._resource) {
+                // The memory belongs to another resource: keep ours and copy into it.
+                return *this = static_cast<const BasicAlignedBuffer<Scalar>&>(other);
+            }
+            deallocate();
+            _data = other._data;
+            _size = other._size;
+            other._data = nullptr;
+            other._size = 0;
         }
+        return *this;
+    }
+
+    template <class Scalar>
+    void BasicAlignedBuffer<Scalar>::swap(BasicAlignedBuffer<Scalar>& other) noexcept {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_resource, other._resource);
+    }
 
-        Matrix _mat = *this;
-        Matrix product_mat = other;
-        std::transform(_mat.begin(), _mat.end(), product_mat.begin(), product_mat.begin(),
-                       [](double elem1, double elem2)->double{return elem1 * elem2;});
-        return product_mat;
+    template <class Scalar>
+    Scalar* BasicAlignedBuffer<Scalar>::data() {
+        return _data;
     }
 
-    Matrix Matrix::operator+(double other) const {
-        Matrix product_mat = *this;
-        std::transform(product_mat.begin(), product_mat.end(),  product_mat.begin(),
-                       [other](double elem)->double{return elem + other;});
-        return product_mat;
+    template <class Scalar>
+    const Scalar* BasicAlignedBuffer<Scalar>::data() const {
+        return _data;
     }
 
-    Matrix Matrix::operator+(const Matrix& other) const {
-        if (!(this->shape()[0] == other.shape()[0] && this->shape()[1] == other.shape()[1])) {
-            throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same."};
+    template <class Scalar>
+    size_t BasicAlignedBuffer<Scalar>::size() const {
+        return _size;
+    }
+
+    template <class Scalar>
+    MemoryResource* BasicAlignedBuffer<Scalar>::resource() const {
+        return _resource;
+    }
+
+    template <class Scalar>
+    BasicAlignedBuffer<Scalar>::~BasicAlignedBuffer() {
+        deallocate();
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(const BasicVector2D<Scalar>& vector2d) : BasicMatrix<Scalar>(vector2d.size(), vector2d.empty() ? 0 : vector2d[0].size(), Scalar()) {
+        for (size_t r = 0; r < _rows; r++) {
+            if (vector2d[r].size() != _cols) {
+                throw IllegalArithmeticsException{"All rows of a matrix must have the same size."};
+            }
+            std::copy(vector2d[r].begin(), vector2d[r].end(), _data + r * _stride);
         }
+    }
 
-        Matrix _mat = *this;
-        Matrix product_mat = other;
-        std::transform(_mat.begin(), _mat.end(), product_mat.begin(), product_mat.begin(),
-                       [](double elem1, double elem2)->double{return elem1 + elem2;});
-        return product_mat;
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(std::initializer_list<std::vector<Scalar>> initList) :
+            BasicMatrix<Scalar>(initList.size(), initList.size() == 0 ? 0 : initList.begin()->size(), Scalar()) {
+        Scalar* row_data = _data;
+        for (const std::vector<Scalar>& rowVec : initList) {
+            if (rowVec.size() != _cols) {
+                throw IllegalArithmeticsException{"All rows of a matrix must have the same size."};
+            }
+            std::copy(rowVec.begin(), rowVec.end(), row_data);
+            row_data += _stride;
+        }
     }
 
-    Matrix Matrix::operator+() const {
-        return *this;
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(const BasicMatrixSection<Scalar>& matrixSection) : BasicMatrix<Scalar>(static_cast<const BasicMatrix<Scalar>&>(matrixSection)) {}
+
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(size_t m, size_t n, Scalar number) :
+            _buffer(m * n), _data(_buffer.data()), _rows(m), _cols(n), _stride(n) {
+        NUMPP_STATS_COUNT(constructions);
+        std::fill(_data, _data + m * n, number);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(size_t m, size_t n, BasicAlignedBuffer<Scalar> buffer) :
+            _buffer(std::move(buffer)), _data(_buffer.data()), _rows(m), _cols(n), _stride(n) {
+        if (_buffer.size() < m * n) {
+            throw IllegalArithmeticsException{"The buffer is too small for the requested shape."};
+        }
+        NUMPP_STATS_COUNT(constructions);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(const BasicMatrix<Scalar> &other) :
+            _buffer(other._rows * other._cols), _data(_buffer.data()),
+            _rows(other._rows), _cols(other._cols), _stride(other._cols) {
+        NUMPP_STATS_COUNT(copies);
+        for (size_t r = 0; r < _rows; r++) {
+            const Scalar* src = other._data + r * other._stride;
+            std::copy(src, src + _cols, _data + r * _stride);
+        }
     }
 
-    Matrix Matrix::operator/(const Matrix& other) const {
-        if (!(this->shape()[0] == other.shape()[0] && this->shape()[1] == other.shape()[1])) {
-            throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same."};
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(BasicMatrix<Scalar>&& other) :
+            _buffer(), _data(nullptr), _rows(0), _cols(0), _stride(0) {
+        if (!other.ownsData()) {
+            *this = other;
+            return;
         }
 
-        Matrix _mat = *this;
-        Matrix product_mat = other;
-        std::transform(_mat.begin(), _mat.end(), product_mat.begin(), product_mat.begin(),
-                       [](double elem1, double elem2)->double{return elem1 / elem2;});
-        return product_mat;
+        // A new matrix takes over the storage together with its resource.
+        NUMPP_STATS_COUNT(moves);
+        _buffer.swap(other._buffer);
+        _data = _buffer.data();
+        _rows = other._rows;
+        _cols = other._cols;
+        _stride = other._stride;
+
+        other._data = other._buffer.data();
+        other._rows = other._cols = other._stride = 0;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar>::BasicMatrix(Scalar* data, size_t rows, size_t cols, size_t stride) :
+            _buffer(), _data(data), _rows(rows), _cols(cols), _stride(stride) {}
+
+    template <class Scalar>
+    bool BasicMatrix<Scalar>::ownsData() const {
+        return _data == _buffer.data();
     }
 
-    Matrix Matrix::operator/(double other) const {
-        Matrix product_mat = *this;
-        std::transform(product_mat.begin(), product_mat.end(),  product_mat.begin(),
-                       [other](double elem)->double{return elem / other;});
-        return product_mat;
+    template <class Scalar>
+    bool BasicMatrix<Scalar>::overlaps(const BasicMatrix<Scalar>& other) const {
+        return kernels::blocks_overlap(_data, _rows, _cols, _stride, other._data, other._rows, other._cols, other._stride);
     }
 
-    Matrix Matrix::operator-(const Matrix& other) const {
-        return *this + (-other);
+    template <class Scalar>
+    template <class Kernel>
+    void BasicMatrix<Scalar>::apply_kernel(Kernel kernel, const BasicMatrix<Scalar>& x, const BasicMatrix<Scalar>& y, BasicMatrix<Scalar>& out) {
+        if (x._stride == x._cols && y._stride == y._cols && out._stride == out._cols) {
+            // Chunks start on cache-line boundaries so threads never write to the same line.
+            parallel::parallel_for(0, x._rows * x._cols, parallel::MIN_ELEMENTS_PER_TASK, [&](size_t begin, size_t end) {
+                kernel(end - begin, x._data + begin, y._data + begin, out._data + begin);
+            }, 8);
+        }
+        else {
+            const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(x._cols, 1) + 1;
+            parallel::parallel_for(0, x._rows, grain, [&](size_t r_begin, size_t r_end) {
+                for (size_t r = r_begin; r < r_end; r++) {
+                    kernel(x._cols, x._data + r * x._stride, y._data + r * y._stride, out._data + r * out._stride);
+                }
+            });
+        }
     }
 
-    Matrix Matrix::operator-(double other) const {
-        return *this + (-other);
+    template <class Scalar>
+    template <class Kernel>
+    void BasicMatrix<Scalar>::apply_kernel(Kernel kernel, const BasicMatrix<Scalar>& x, Scalar y, BasicMatrix<Scalar>& out) {
+        if (x._stride == x._cols && out._stride == out._cols) {
+            parallel::parallel_for(0, x._rows * x._cols, parallel::MIN_ELEMENTS_PER_TASK, [&](size_t begin, size_t end) {
+                kernel(end - begin, x._data + begin, y, out._data + begin);
+            }, 8);
+        }
+        else {
+            const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(x._cols, 1) + 1;
+            parallel::parallel_for(0, x._rows, grain, [&](size_t r_begin, size_t r_end) {
+                for (size_t r = r_begin; r < r_end; r++) {
+                    kernel(x._cols, x._data + r * x._stride, y, out._data + r * out._stride);
+                }
+            });
+        }
     }
 
-    Matrix Matrix::operator-() const {
-        return *this * (-1);
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrix<Scalar>::operator+() const {
+        return *this;
     }
 
-    Matrix Matrix::operator*=(double other) {
-        Matrix res = *this * other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator*=(Scalar other) {
+        apply_kernel(kernels::binary_with_scalar_kernel<Scalar>(kernels::OP_MUL), *this, other, *this);
+        return *this;
     }
 
-    Matrix Matrix::operator*=(const Matrix& other) {
-        Matrix res = *this * other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator*=(const BasicMatrix<Scalar>& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            return updateWith<kernels::MulOp>(MatrixReference<Scalar>(other));
+        }
+
+        if (overlaps(other)) {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_MUL), *this, BasicMatrix<Scalar>{other}, *this);
+        }
+        else {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_MUL), *this, other, *this);
+        }
+        return *this;
     }
 
-    Matrix Matrix::operator+=(double other) {
-        Matrix res = *this + other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator+=(Scalar other) {
+        apply_kernel(kernels::binary_with_scalar_kernel<Scalar>(kernels::OP_ADD), *this, other, *this);
+        return *this;
     }
 
-    Matrix Matrix::operator+=(const Matrix& other) {
-        Matrix res = *this + other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator+=(const BasicMatrix<Scalar>& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            return updateWith<kernels::AddOp>(MatrixReference<Scalar>(other));
+        }
+
+        if (overlaps(other)) {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_ADD), *this, BasicMatrix<Scalar>{other}, *this);
+        }
+        else {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_ADD), *this, other, *this);
+        }
+        return *this;
     }
 
-    Matrix Matrix::operator/=(double other) {
-        Matrix res = *this / other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator/=(Scalar other) {
+        apply_kernel(kernels::binary_with_scalar_kernel<Scalar>(kernels::OP_DIV), *this, other, *this);
+        return *this;
     }
 
-    Matrix Matrix::operator/=(const Matrix& other) {
-        Matrix res = *this / other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator/=(const BasicMatrix<Scalar>& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            return updateWith<kernels::DivOp>(MatrixReference<Scalar>(other));
+        }
+
+        if (overlaps(other)) {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_DIV), *this, BasicMatrix<Scalar>{other}, *this);
+        }
+        else {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_DIV), *this, other, *this);
+        }
+        return *this;
     }
 
-    Matrix Matrix::operator-=(double other) {
-        Matrix res = *this - other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator-=(Scalar other) {
+        apply_kernel(kernels::binary_with_scalar_kernel<Scalar>(kernels::OP_SUB), *this, other, *this);
+        return *this;
     }
 
-    Matrix Matrix::operator-=(const Matrix& other) {
-        Matrix res = *this - other;
-        std::copy(res.begin(), res.end(), this->begin());
-        return res;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator-=(const BasicMatrix<Scalar>& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            return updateWith<kernels::SubOp>(MatrixReference<Scalar>(other));
+        }
+
+        if (overlaps(other)) {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_SUB), *this, BasicMatrix<Scalar>{other}, *this);
+        }
+        else {
+            apply_kernel(kernels::binary_kernel<Scalar>(kernels::OP_SUB), *this, other, *this);
+        }
+        return *this;
     }
 
-    MatrixSection Matrix::operator[](SignedSlice slice_numpp) {
-        Vector2D vec2d;
+    template <class Scalar>
+    BasicMatrixSection<Scalar> BasicMatrix<Scalar>::operator[](SignedSlice slice_numpp) {
+        NUMPP_STATS_PROFILE("operator[]");
         Slice slice {
             static_cast<size_t>(std::abs(slice_numpp.start_idx)),
             static_cast<size_t>(std::abs(slice_numpp.end_idx))
@@ -168,200 +366,432 @@ namespace numpp {
         Section section;
 
         if (slice_numpp.start_idx < 0) {
-            slice.start_idx = shape()[0] + slice_numpp.start_idx;
+            slice.start_idx = _rows + slice_numpp.start_idx;
         }
         if (slice_numpp.end_idx < 0) {
-            slice.end_idx = shape()[0] + slice_numpp.start_idx;
+            slice.end_idx = _rows + slice_numpp.end_idx;
         }
         else if (slice_numpp.end_idx == ED) {
-            slice.end_idx = shape()[0];
-        }
-
-        for (size_t r = slice.start_idx; r < slice.end_idx; r++) {
-            vec2d.push_back(this->_matrix[r]);
+            slice.end_idx = _rows;
         }
 
         section.state = 1;
         section.row_slice = slice;
-        section.col_slice = {0, shape()[1]};
+        section.col_slice = {0, _cols};
 
-        MatrixSection res{vec2d, this, section};
-        return res;
+        return BasicMatrixSection<Scalar>{this, section};
     }
 
-    MatrixSection Matrix::operator[](int index_numpp) {
+    template <class Scalar>
+    BasicMatrixSection<Scalar> BasicMatrix<Scalar>::operator[](int index_numpp) {
         SignedSlice signedSlice;
         if (index_numpp == ED) {
-            signedSlice = {0, static_cast<int>(shape()[0])};
+            signedSlice = {0, static_cast<int>(_rows)};
         }
         else if (index_numpp >= 0) {
             signedSlice = {index_numpp, index_numpp + 1};
         }
         else {
-            signedSlice = {index_numpp, static_cast<int>(shape()[0] + index_numpp + 1)};
+            signedSlice = {index_numpp, static_cast<int>(_rows + index_numpp + 1)};
         }
         return (*this)[signedSlice];
     }
 
-    Matrix& Matrix::operator=(const Matrix& other) = default;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator=(const BasicMatrix<Scalar>& other) {
+        if (this != &other) {
+            if (overlaps(other)) {
+                // `other` is a view into our own storage: copy it out before the storage is replaced.
+                return *this = BasicMatrix<Scalar>{other};
+            }
 
-    Matrix::Iterator::Iterator(Vector2D& vector2d, size_t row, size_t col) :
-            _vector2d(vector2d), cur_row(row), cur_col(col) {}
+            NUMPP_STATS_COUNT(copies);
+            if (_buffer.size() != other._rows * other._cols) {
+                _buffer = BasicAlignedBuffer<Scalar>(other._rows * other._cols, _buffer.resource());
+            }
+            _data = _buffer.data();
+            _rows = other._rows;
+            _cols = other._cols;
+            _stride = other._cols;
+
+            for (size_t r = 0; r < _rows; r++) {
+                const Scalar* src = other._data + r * other._stride;
+                std::copy(src, src + _cols, _data + r * _stride);
+            }
+        }
+        return *this;
+    }
 
-    Matrix::Iterator::Iterator(const Iterator& iterator) = default;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator=(BasicMatrix<Scalar>&& other) {
+        if (!other.ownsData()) {
+            // Moving from a view must not alias the view's parent: copy the elements instead.
+            BasicMatrix<Scalar> copy{other};
+            return *this = std::move(copy);
+        }
+
+        if (this != &other) {
+            NUMPP_STATS_COUNT(moves);
+            // Takes over `other`'s storage if both come from the same resource, otherwise copies into our own.
+            _buffer = std::move(other._buffer);
+            _data = _buffer.data();
+            _rows = other._rows;
+            _cols = other._cols;
+            _stride = other._stride;
+
+            other._data = other._buffer.data();
+            other._rows = other._cols = other._stride = 0;
+        }
+        return *this;
+    }
 
-    Matrix::Iterator::IteratorBeyondRangeException::IteratorBeyondRangeException(std::string msg) : message(
-            std::move(msg)) {
+    template <class Scalar>
+    BasicMatrix<Scalar>::IteratorBeyondRangeException::IteratorBeyondRangeException(std::string msg) : message(std::move(msg)) {
         if (show_numpp_exception_details)
             cout << "NumPP Exception: " << message << endl;
     }
 
-    const char *Matrix::Iterator::IteratorBeyondRangeException::what() const noexcept {
+    template <class Scalar>
+    const char *BasicMatrix<Scalar>::IteratorBeyondRangeException::what() const noexcept {
         return message.c_str();
     }
 
-    Matrix::Iterator::reference Matrix::Iterator::operator*() {
-        return _vector2d[cur_row][cur_col];
+    template <class Scalar>
+    template <class T>
+    BasicMatrix<Scalar>::BasicIterator<T>::BasicIterator() :
+            _ptr(nullptr), _row_end(nullptr), _row(0), _rows(0), _cols(0), _stride(0) {}
+
+    template <class Scalar>
+    template <class T>
+    BasicMatrix<Scalar>::BasicIterator<T>::BasicIterator(T* data, size_t rows, size_t cols, size_t stride, size_t row, size_t col) :
+            _ptr(data + row * stride + col), _row_end(data + row * stride + cols),
+            _row(row), _rows(rows), _cols(cols), _stride(stride) {}
+
+    template <class Scalar>
+    template <class T>
+    template <class U, class>
+    BasicMatrix<Scalar>::BasicIterator<T>::BasicIterator(const BasicIterator<U>& other) :
+            _ptr(other._ptr), _row_end(other._row_end), _row(other._row),
+            _rows(other._rows), _cols(other._cols), _stride(other._stride) {}
+
+    template <class Scalar>
+    template <class T>
+    void BasicMatrix<Scalar>::BasicIterator<T>::check(size_t linear_index) const {
+#ifdef NUMPP_DEBUG
+        if (linear_index > _rows * _cols) {
+            throw IteratorBeyondRangeException{"The iterator has moved beyond the elements of the matrix."};
+        }
+#else
+        (void) linear_index;
+#endif
     }
 
-    Matrix::Iterator& Matrix::Iterator::operator++() {
-        size_t max_row = _vector2d.size();
-        size_t max_col = _vector2d[0].size();
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>::reference BasicMatrix<Scalar>::BasicIterator<T>::operator*() const {
+        return *_ptr;
+    }
 
-        if (cur_row == max_row) {
-            throw IteratorBeyondRangeException{"You have gotten the end of the iterator."};
-        }
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>::pointer BasicMatrix<Scalar>::BasicIterator<T>::operator->() const {
+        return _ptr;
+    }
+
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>::reference BasicMatrix<Scalar>::BasicIterator<T>::operator[](difference_type n) const {
+        return *(*this + n);
+    }
 
-        if (cur_col == max_col - 1) {
-            // cur is at the last element of this row
-            cur_row++;
-            cur_col = 0;
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>& BasicMatrix<Scalar>::BasicIterator<T>::operator++() {
+#ifdef NUMPP_DEBUG
+        if (_row == _rows) {
+            throw IteratorBeyondRangeException{"You have gotten the end of the iterator."};
         }
-        else {
-            cur_col++;
+#endif
+        if (++_ptr == _row_end) {
+            // Move to the first element of the next row.
+            _ptr += _stride - _cols;
+            _row_end += _stride;
+            _row++;
         }
-
         return *this;
     }
 
-    Matrix::Iterator Matrix::Iterator::operator++(int) {
-        Iterator temp = *this;
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T> BasicMatrix<Scalar>::BasicIterator<T>::operator++(int) {
+        BasicIterator temp = *this;
         ++(*this);
         return temp;
     }
 
-    bool Matrix::Iterator::operator==(const Iterator &other) const {
-        return &(other._vector2d) == &(this->_vector2d) && other.cur_row == this->cur_row
-               && other.cur_col == this->cur_col;
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>& BasicMatrix<Scalar>::BasicIterator<T>::operator--() {
+        if (_ptr == _row_end - _cols) {
+#ifdef NUMPP_DEBUG
+            if (_row == 0) {
+                throw IteratorBeyondRangeException{"You are at the beginning of the iterator."};
+            }
+#endif
+            // Move to the last element of the previous row.
+            _row_end -= _stride;
+            _ptr = _row_end;
+            _row--;
+        }
+        --_ptr;
+        return *this;
     }
 
-    bool Matrix::Iterator::operator!=(const Iterator &other) const {
-        return !(*this == other);
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T> BasicMatrix<Scalar>::BasicIterator<T>::operator--(int) {
+        BasicIterator temp = *this;
+        --(*this);
+        return temp;
     }
 
-    Matrix::Iterator &Matrix::Iterator::operator--() {
-        size_t max_row = _vector2d.size();
-        size_t max_col = _vector2d[0].size();
-
-        if (cur_row  == max_row) {
-            // cur is at the row beyond the last row (the end of iterator)
-            cur_row--;
-            cur_col = max_col - 1;
-        }
-        else
-        {
-            if (cur_col == 0) {
-                // cur is at the first element of this row
-                if (cur_row == 0) {
-                    // cur is at the first row
-                    throw IteratorBeyondRangeException{"You are at the beginning of the iterator."};
-                } else {
-                    cur_row--;
-                    cur_col = max_col - 1;
-                }
-            } else {
-                cur_col--;
-            }
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>& BasicMatrix<Scalar>::BasicIterator<T>::operator+=(difference_type n) {
+        if (n == 0) {
+            return *this;
         }
-
+        const size_t target = index() + n;
+        check(target);
+        const difference_type row_step = static_cast<difference_type>(target / _cols) - static_cast<difference_type>(_row);
+        _row_end += row_step * static_cast<difference_type>(_stride);
+        _ptr = _row_end - _cols + target % _cols;
+        _row += row_step;
         return *this;
     }
 
-    Matrix::Iterator Matrix::Iterator::operator--(int) {
-        Iterator temp = *this;
-        --(*this);
-        return temp;
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>& BasicMatrix<Scalar>::BasicIterator<T>::operator-=(difference_type n) {
+        return *this += -n;
+    }
+
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T> BasicMatrix<Scalar>::BasicIterator<T>::operator+(difference_type n) const {
+        BasicIterator res = *this;
+        res += n;
+        return res;
     }
 
-    Matrix::Iterator::pointer Matrix::Iterator::operator->() {
-        return &_vector2d[cur_row][cur_col];
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T> BasicMatrix<Scalar>::BasicIterator<T>::operator-(difference_type n) const {
+        BasicIterator res = *this;
+        res += -n;
+        return res;
+    }
+
+    template <class Scalar>
+    template <class T>
+    typename BasicMatrix<Scalar>::template BasicIterator<T>::difference_type BasicMatrix<Scalar>::BasicIterator<T>::operator-(const BasicIterator& other) const {
+        return static_cast<difference_type>(index()) - static_cast<difference_type>(other.index());
+    }
+
+    template <class Scalar>
+    template <class T>
+    size_t BasicMatrix<Scalar>::BasicIterator<T>::index() const {
+        return _row * _cols + (_cols - (_row_end - _ptr));
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator==(const BasicIterator& other) const {
+        return _ptr == other._ptr;
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator!=(const BasicIterator& other) const {
+        return !(*this == other);
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator<(const BasicIterator& other) const {
+        return index() < other.index();
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator>(const BasicIterator& other) const {
+        return other < *this;
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator<=(const BasicIterator& other) const {
+        return !(other < *this);
+    }
+
+    template <class Scalar>
+    template <class T>
+    bool BasicMatrix<Scalar>::BasicIterator<T>::operator>=(const BasicIterator& other) const {
+        return !(*this < other);
+    }
+
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::Iterator BasicMatrix<Scalar>::begin() {
+        return Iterator{_data, _rows, _cols, _stride, 0, 0};
+    }
+
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::Iterator BasicMatrix<Scalar>::end() {
+        // An empty matrix ends where it begins.
+        return Iterator{_data, _rows, _cols, _stride, _cols == 0 ? 0 : _rows, 0};
+    }
+
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::ConstIterator BasicMatrix<Scalar>::begin() const {
+        return cbegin();
     }
 
-    Matrix::Iterator Matrix::begin() {
-        return Iterator{_matrix, 0, 0};
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::ConstIterator BasicMatrix<Scalar>::end() const {
+        return cend();
     }
 
-    Matrix::Iterator Matrix::end() {
-        return Iterator{_matrix, _matrix.size(), 0};
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::ConstIterator BasicMatrix<Scalar>::cbegin() const {
+        return ConstIterator{_data, _rows, _cols, _stride, 0, 0};
     }
 
-    std::vector<size_t> Matrix::shape() const {
-        return std::vector<size_t>{this->_matrix.size(), this->_matrix[0].size()};
+    template <class Scalar>
+    typename BasicMatrix<Scalar>::ConstIterator BasicMatrix<Scalar>::cend() const {
+        return ConstIterator{_data, _rows, _cols, _stride, _cols == 0 ? 0 : _rows, 0};
     }
 
-    double Matrix::at(size_t x, size_t y) const {
-        return this->_matrix[x][y];
+    template <class Scalar>
+    std::vector<size_t> BasicMatrix<Scalar>::shape() const {
+        return std::vector<size_t>{_rows, _cols};
     }
 
-    Matrix Matrix::row(int row_index) const {
-        return Matrix{*this}[row_index];
+    template <class Scalar>
+    size_t BasicMatrix<Scalar>::rowCount() const {
+        return _rows;
     }
 
-    Matrix Matrix::column(int col_index) const {
-        return Matrix{*this}[{0, ED}][col_index];
+    template <class Scalar>
+    size_t BasicMatrix<Scalar>::colCount() const {
+        return _cols;
     }
 
-    std::vector<Matrix> Matrix::rows() const {
-        std::vector<Matrix> res;
-        Matrix matrix = *this;
-        for (int r = 0; r < shape()[0]; r++) {
-            res.push_back(matrix.row(r));
+    template <class Scalar>
+    Scalar BasicMatrix<Scalar>::at(size_t x, size_t y) const {
+        return _data[x * _stride + y];
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrix<Scalar>::row(int row_index) const {
+        // Slicing only creates a view, which is copied out before anything could write through it.
+        return BasicMatrix<Scalar>{const_cast<BasicMatrix<Scalar>&>(*this)[row_index]};
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrix<Scalar>::column(int col_index) const {
+        return BasicMatrix<Scalar>{const_cast<BasicMatrix<Scalar>&>(*this)[{0, ED}][col_index]};
+    }
+
+    template <class Scalar>
+    std::vector<BasicMatrix<Scalar>> BasicMatrix<Scalar>::rows() const {
+        std::vector<BasicMatrix<Scalar>> res;
+        res.reserve(_rows);
+        for (size_t r = 0; r < _rows; r++) {
+            BasicMatrix<Scalar> row_matrix(1, _cols, BasicAlignedBuffer<Scalar>(_cols));
+            std::copy(_data + r * _stride, _data + r * _stride + _cols, row_matrix._data);
+            res.push_back(std::move(row_matrix));
         }
         return res;
     }
 
-    std::vector<Matrix> Matrix::columns() const {
-        std::vector<Matrix> res;
-        Matrix matrix = *this;
-        for (int c = 0; c < shape()[1]; c++) {
-            res.push_back(matrix.column(c));
+    template <class Scalar>
+    std::vector<BasicMatrix<Scalar>> BasicMatrix<Scalar>::columns() const {
+        std::vector<BasicMatrix<Scalar>> res;
+        res.reserve(_cols);
+        for (size_t c = 0; c < _cols; c++) {
+            BasicMatrix<Scalar> col_matrix(_rows, 1, BasicAlignedBuffer<Scalar>(_rows));
+            for (size_t r = 0; r < _rows; r++) {
+                col_matrix._data[r] = _data[r * _stride + c];
+            }
+            res.push_back(std::move(col_matrix));
         }
         return res;
     }
 
-    Matrix Matrix::T() const {
-        Vector2D transposed_vec2d(shape()[1], std::vector<double> (shape()[0], 0));
-        for (int row = 0; row < shape()[0]; row++) {
-            Matrix cur_row = this->row(row);
-            int elem_index = 0;
-            for (double element : cur_row) {
-                transposed_vec2d[elem_index][row] = element;
-                elem_index++;
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrix<Scalar>::T() const {
+        NUMPP_STATS_PROFILE("T");
+        BasicMatrix<Scalar> transposed(_cols, _rows, BasicAlignedBuffer<Scalar>(_rows * _cols));
+        kernels::transpose(_rows, _cols, _data, _stride, transposed._data, transposed._stride);
+        return transposed;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::transposeInPlace() {
+        if (_rows == _cols) {
+            kernels::transpose_square_inplace(_rows, _data, _stride);
+        }
+        else if (ownsData()) {
+            *this = T();
+        }
+        else {
+            throw IllegalArithmeticsException{"Cannot transpose a non-square matrix section in place."};
+        }
+        return *this;
+    }
+
+    template <class Scalar>
+    template <class U>
+    BasicMatrix<U> BasicMatrix<Scalar>::astype() const {
+        BasicAlignedBuffer<U> buffer(_rows * _cols);
+        U* dst = buffer.data();
+        for (size_t r = 0; r < _rows; r++) {
+            const Scalar* src = _data + r * _stride;
+            for (size_t c = 0; c < _cols; c++) {
+                *dst++ = static_cast<U>(src[c]);
             }
         }
-        return Matrix{transposed_vec2d};
+        return BasicMatrix<U>(_rows, _cols, std::move(buffer));
+    }
+
+    template <class Scalar>
+    BasicVector2D<Scalar> BasicMatrix<Scalar>::toVector2D() const {
+        BasicVector2D<Scalar> res(_rows);
+        for (size_t r = 0; r < _rows; r++) {
+            const Scalar* src = _data + r * _stride;
+            res[r].assign(src, src + _cols);
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    Scalar* BasicMatrix<Scalar>::dataHolder() {
+        return _data;
     }
 
-    Vector2D Matrix::toVector2D() const {
-        return _matrix;
+    template <class Scalar>
+    const Scalar* BasicMatrix<Scalar>::dataHolder() const {
+        return _data;
     }
 
-    Vector2D* Matrix::dataHolder() {
-        return &_matrix;
+    template <class Scalar>
+    size_t BasicMatrix<Scalar>::stride() const {
+        return _stride;
     }
 
-    double Matrix::num() const {
-        if (shape()[0] == 1 && shape()[1] == 1) {
+    template <class Scalar>
+    Scalar BasicMatrix<Scalar>::num() const {
+        if (_rows == 1 && _cols == 1) {
             return at(0, 0);
         }
         else {
@@ -369,18 +799,34 @@ namespace numpp {
         }
     }
 
-    Matrix::~Matrix() = default;
+    template <class Scalar>
+    BasicMatrix<Scalar>::~BasicMatrix() = default;
+
+    template <class Scalar>
+    BasicMatrixSection<Scalar>::BasicMatrixSection(BasicMatrix<Scalar>& matrix) :
+            BasicMatrixSection<Scalar>(&matrix, Section{1, {0, matrix._rows}, {0, matrix._cols}}) {}
 
-    MatrixSection::MatrixSection(Vector2D vector2D) : Matrix(std::move(vector2D)), _parentMatrix(nullptr), _indexesOfParentMatrix({0}) {}
+    template <class Scalar>
+    BasicMatrixSection<Scalar>::BasicMatrixSection(BasicMatrix<Scalar> *parentMatrix, Section indexesOfParentMatrix) :
+            BasicMatrix<Scalar>(parentMatrix->_data + indexesOfParentMatrix.row_slice.start_idx * parentMatrix->_stride
+                   + indexesOfParentMatrix.col_slice.start_idx,
+                   indexesOfParentMatrix.row_slice.end_idx - indexesOfParentMatrix.row_slice.start_idx,
+                   indexesOfParentMatrix.col_slice.end_idx - indexesOfParentMatrix.col_slice.start_idx,
+                   parentMatrix->_stride),
+            _parentMatrix(parentMatrix), _indexesOfParentMatrix(indexesOfParentMatrix) {}
 
-    MatrixSection::MatrixSection(Vector2D vector2D, Matrix *parentMatrix, Section indexesOfParentMatrix) : Matrix(std::move(vector2D)), _parentMatrix(parentMatrix), _indexesOfParentMatrix(indexesOfParentMatrix) {}
+    template <class Scalar>
+    BasicMatrixSection<Scalar>::BasicMatrixSection(const BasicMatrixSection<Scalar>& other) :
+            BasicMatrix<Scalar>(other._data, other._rows, other._cols, other._stride),
+            _parentMatrix(other._parentMatrix), _indexesOfParentMatrix(other._indexesOfParentMatrix) {}
 
-    MatrixSection MatrixSection::operator[](SignedSlice slice_numpp) {
+    template <class Scalar>
+    BasicMatrixSection<Scalar> BasicMatrixSection<Scalar>::operator[](SignedSlice slice_numpp) {
+        NUMPP_STATS_PROFILE("operator[]");
         if (_indexesOfParentMatrix.state == 2) {
             throw IllegalArithmeticsException{"Cannot slice a matrix too many times, two times at most."};
         }
 
-        Vector2D vec2d;
         Slice slice {
             static_cast<size_t>(std::abs(slice_numpp.start_idx)),
             static_cast<size_t>(std::abs(slice_numpp.end_idx))
@@ -388,306 +834,405 @@ namespace numpp {
 
         Section section;
         if (slice_numpp.start_idx < 0) {
-            slice.start_idx = shape()[1] + slice_numpp.start_idx;
+            slice.start_idx = _cols + slice_numpp.start_idx;
         }
 
         if (slice_numpp.end_idx < 0) {
-            slice.end_idx = shape()[1] + slice_numpp.start_idx;
+            slice.end_idx = _cols + slice_numpp.end_idx;
         }
         else if (slice_numpp.end_idx == ED) {
-            slice.end_idx = shape()[1];
-        }
-
-        for(size_t r = 0; r < shape()[0]; r++) {
-            std::vector<double> vec;
-            for (size_t c = slice.start_idx; c < slice.end_idx; c++) {
-                vec.push_back(this->at(r, c));
-            }
-
-            vec2d.emplace_back(vec);
+            slice.end_idx = _cols;
         }
 
         section.state = 2;
         section.row_slice = this->_indexesOfParentMatrix.row_slice;
-        section.col_slice = slice;
+        section.col_slice = {this->_indexesOfParentMatrix.col_slice.start_idx + slice.start_idx,
+                             this->_indexesOfParentMatrix.col_slice.start_idx + slice.end_idx};
 
-        MatrixSection res{vec2d, this->_parentMatrix, section};
-        return res;
+        return BasicMatrixSection<Scalar>{this->_parentMatrix, section};
     }
 
-    MatrixSection MatrixSection::operator[](int index_numpp) {
+    template <class Scalar>
+    BasicMatrixSection<Scalar> BasicMatrixSection<Scalar>::operator[](int index_numpp) {
         SignedSlice signedSlice;
         if (index_numpp == ED) {
-            signedSlice = {0, static_cast<int>(shape()[1])};
+            signedSlice = {0, static_cast<int>(_cols)};
         }
         else if (index_numpp >= 0) {
             signedSlice = {index_numpp, index_numpp + 1};
         }
         else {
-            signedSlice = {index_numpp, static_cast<int>(shape()[1] + index_numpp + 1)};
+            signedSlice = {index_numpp, static_cast<int>(_cols + index_numpp + 1)};
         }
         return (*this)[signedSlice];
     }
 
-    Matrix& MatrixSection::operator=(double other) {
-        std::vector<double> fill_vector(shape()[0] * shape()[1], other);
-        std::copy(fill_vector.begin(), fill_vector.end(), begin());
-        Vector2D new_vector2d(shape()[0], std::vector<double>(shape()[1], other));
-        this->_matrix = new_vector2d;
-        return *this;
-    }
-
-    Matrix& MatrixSection::operator=(const Matrix& other) {
-        Matrix other_copy{other};
-        std::copy(other_copy.begin(), other_copy.end(), begin());
-        this->_matrix = other_copy.toVector2D();
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrixSection<Scalar>::operator=(Scalar other) {
+        for (size_t r = 0; r < _rows; r++) {
+            std::fill(_data + r * _stride, _data + r * _stride + _cols, other);
+        }
         return *this;
     }
 
-    MatrixSection::Iterator::Iterator(Vector2D& vector2d, size_t row, size_t col, Section sect = {0}) :
-            Matrix::Iterator(vector2d, row, col), _section(sect) {}
-
-    MatrixSection::Iterator::Iterator(const Iterator& iterator) = default;
-
-    MatrixSection::Iterator& MatrixSection::Iterator::operator++() {
-        // If section is activated, move the section into the left top position, aligning (0, 0) element.
-        size_t offset_row = 0;  // Vertical offset
-        size_t offset_col = 0;  // Horizontal offset
-
-        size_t max_row = _vector2d.size();
-        size_t max_col = _vector2d[0].size();
-
-        if (_section.state > 0) {
-            offset_row = _section.row_slice.start_idx;
-            offset_col = _section.col_slice.start_idx;
-
-            max_row = _section.row_slice.end_idx - _section.row_slice.start_idx;
-            max_col = _section.col_slice.end_idx - _section.col_slice.start_idx;
+    template <class Scalar>
+    BasicMatrix<Scalar>& BasicMatrixSection<Scalar>::operator=(const BasicMatrix<Scalar>& other) {
+        if (other._rows * other._cols != _rows * _cols) {
+            throw IllegalArithmeticsException{"To assign to a matrix section, both sides must have the same number of elements."};
         }
 
-        if (cur_row - offset_row == max_row) {
-            throw IteratorBeyondRangeException{"You have gotten the end of the iterator."};
+        if (this->overlaps(other)) {
+            return *this = BasicMatrix<Scalar>{other};
         }
 
-        if (cur_col - offset_col == max_col - 1) {
-            // cur is at the last element of this row
-            if (cur_row - offset_row == max_row - 1) {
-                // cur is at the last row
-                if (cur_col < _vector2d[0].size() - 1) {
-                    // Have gotten in the right board of section but there are gaps to get in the right board of origin matrix
-                    cur_col++;
-
-                }
-                else {
-                    cur_row++;
-                    cur_col = 0;
-                }
-            }
-            else {
-                cur_row++;
-                cur_col = offset_col;
+        if (other._rows == _rows) {
+            for (size_t r = 0; r < _rows; r++) {
+                const Scalar* src = other._data + r * other._stride;
+                std::copy(src, src + _cols, _data + r * _stride);
             }
         }
         else {
-            cur_col++;
+            // Same number of elements but a different shape: copy in row-major order.
+            size_t r = 0;
+            size_t c = 0;
+            for (size_t other_r = 0; other_r < other._rows; other_r++) {
+                for (size_t other_c = 0; other_c < other._cols; other_c++) {
+                    _data[r * _stride + c] = other._data[other_r * other._stride + other_c];
+                    if (++c == _cols) {
+                        c = 0;
+                        r++;
+                    }
+                }
+            }
         }
-
         return *this;
     }
 
-    MatrixSection::Iterator MatrixSection::Iterator::operator++(int) {
-        Iterator temp = *this;
-        ++(*this);
-        return temp;
+    template <class Scalar>
+    BasicMatrixSection<Scalar>& BasicMatrixSection<Scalar>::operator=(const BasicMatrixSection<Scalar>& other) {
+        *this = static_cast<const BasicMatrix<Scalar>&>(other);
+        return *this;
     }
 
-    MatrixSection::Iterator &MatrixSection::Iterator::operator--() {
-        size_t offset_row = 0;  // Vertical offset
-        size_t offset_col = 0;  // Horizontal offset
-
-        size_t max_row = _vector2d.size();
-        size_t max_col = _vector2d[0].size();
-
-        if (_section.state > 0) {
-            offset_row = _section.row_slice.start_idx;
-            offset_col = _section.col_slice.start_idx;
-
-            max_row = _section.row_slice.end_idx - _section.row_slice.start_idx;
-            max_col = _section.col_slice.end_idx - _section.col_slice.start_idx;
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrixSection<Scalar>::operator=(const MatrixExpression<E>& expression) {
+        if (expression.rows() != _rows || expression.cols() != _cols) {
+            throw IllegalArithmeticsException{"To assign to a matrix section, the shapes of both sides must be the same."};
         }
 
-        if (cur_row - offset_row == max_row) {
-            // cur is at the row beyond the last row (the end of iterator)
-            cur_row--;
-            cur_col = max_col + offset_col - 1;
-        }
-        else
-        {
-            if (cur_col - offset_col == 0) {
-                // cur is at the first element of this row
-                if (cur_row - offset_row == 0) {
-                    // cur is at the first row
-                    throw IteratorBeyondRangeException{"You are at the beginning of the iterator."};
-                } else {
-                    cur_row--;
-                    cur_col = max_col + offset_col - 1;
-                }
-            } else {
-                cur_col--;
-            }
+        if (expression.derived().overlaps(_data, _rows, _cols, _stride)) {
+            return *this = BasicMatrix<Scalar>{expression};
         }
-
+        evaluate(expression.derived(), _data, _stride);
         return *this;
     }
 
-    MatrixSection::Iterator MatrixSection::Iterator::operator--(int) {
-        Iterator temp = *this;
-        --(*this);
-        return temp;
-    }
-
-    MatrixSection::Iterator MatrixSection::begin() {
-        return Iterator{*_parentMatrix->dataHolder(),
-                            _indexesOfParentMatrix.row_slice.start_idx,
-                            _indexesOfParentMatrix.col_slice.start_idx,
-                            _indexesOfParentMatrix};
-    }
-
-    MatrixSection::Iterator MatrixSection::end() {
-        return ++Iterator{*_parentMatrix->dataHolder(), _indexesOfParentMatrix.row_slice.end_idx - 1,
-                            _indexesOfParentMatrix.col_slice.end_idx - 1, _indexesOfParentMatrix};
-    }
-
-    MatrixSection::~MatrixSection() = default;
+    template <class Scalar>
+    BasicMatrixSection<Scalar>::~BasicMatrixSection() = default;
 
 
-    Matrix zeros(size_t m, size_t n) {
+    template <class Scalar>
+    BasicMatrix<Scalar> zeros(size_t m, size_t n) {
         return {m, n};
     }
 
-    Matrix ones(size_t m, size_t n) {
-        return {m, n, 1};
+    template <class Scalar>
+    BasicMatrix<Scalar> ones(size_t m, size_t n) {
+        return {m, n, Scalar(1)};
     }
 
-    Matrix identity(size_t m) {
-        Matrix res{m, m};
-        for (int r = 0; r < m; r++) {
-            res[r][r] = 1;
+    template <class Scalar>
+    BasicMatrix<Scalar> identity(size_t m) {
+        BasicMatrix<Scalar> res{m, m};
+        for (size_t r = 0; r < m; r++) {
+            res.dataHolder()[r * res.stride() + r] = Scalar(1);
         }
         return res;
     }
 
-    Matrix random(size_t m, size_t n, int min, int max) {
+    template <class Scalar>
+    BasicMatrix<Scalar> random(size_t m, size_t n, int min, int max) {
         std::random_device rd;
         std::mt19937 gen(rd());
         std::uniform_int_distribution<> dis(min, max);
-        Vector2D _vector2d(m, std::vector<double>(n));
-        for (int row = 0; row < m; row++) {
-            for (int col = 0; col < n; col++) {
-                _vector2d[row][col] = dis(gen);
-            }
+        BasicMatrix<Scalar> res{m, n};
+        Scalar* data = res.dataHolder();
+        for (size_t i = 0; i < m * n; i++) {
+            data[i] = static_cast<Scalar>(dis(gen));
         }
-        return Matrix{_vector2d};
+        return res;
     }
 
-    void show(const Matrix &matrix) {
-        Matrix _matrix = matrix;
-        cout << "Matrix([" << endl;
-        int cur_index = 0;
-        const size_t col_size = _matrix.shape()[1];
-        for(double element : _matrix) {
-            if (cur_index == 0)
-                cout << "\t[";
-
-            cout << std::defaultfloat << element;
-
-            if (cur_index == col_size - 1) {
-                cout << "]" << endl;
-            }
-            else {
-                cout << ", ";
-            }
+    template <class Scalar>
+    void show(const BasicMatrix<Scalar> &matrix) {
+        write(cout, matrix, PrintOptions(static_cast<int>(cout.precision()), SIZE_MAX));
+        cout << std::flush;
+    }
 
-            cur_index++;
-            if (cur_index == col_size)
-                cur_index = 0;
-        }
-        cout << "])" << endl;
+    template <class E>
+    void show(const MatrixExpression<E>& expression) {
+        show(expression.eval());
     }
 
-    Matrix multiply(const Matrix& matrix, double c) {
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix, typename NonDeduced<Scalar>::type c) {
         return matrix * c;
     }
 
-    Matrix multiply(const Matrix& matrix1, const Matrix& matrix2) {
-        // Checking shapes of two matrices.
-        if (matrix1.shape()[1] == matrix2.shape()[0]) {
-            Vector2D product_vec2d(matrix1.shape()[0], std::vector<double>(matrix2.shape()[1], 0));
-
-            for (int row_of_mat1 = 0; row_of_mat1 < matrix1.shape()[0]; row_of_mat1++) {
-                Matrix mul_row = matrix1.row(row_of_mat1);
-                for (int col_of_mat2 = 0; col_of_mat2 < matrix2.shape()[1]; col_of_mat2++) {
-                    Matrix mul_col = matrix2.column(col_of_mat2);
-                    Matrix element_wise_product = mul_row * mul_col.T();
-                    double sum = std::accumulate(element_wise_product.begin(), element_wise_product.end(),
-                                                 0.0);
-                    product_vec2d[row_of_mat1][col_of_mat2] = sum;
-                }
-            }
+    /*
+     * op(matrix1) * op(matrix2), where op transposes an operand by swapping its row and column strides.
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply_strided(const BasicMatrix<Scalar>& matrix1, bool transpose1, const BasicMatrix<Scalar>& matrix2, bool transpose2) {
+        NUMPP_STATS_PROFILE("multiply");
+        const size_t m = transpose1 ? matrix1.colCount() : matrix1.rowCount();
+        const size_t k = transpose1 ? matrix1.rowCount() : matrix1.colCount();
+        const size_t n = transpose2 ? matrix2.rowCount() : matrix2.colCount();
 
-            return Matrix{product_vec2d};
-        }
-        else {
+        // Checking shapes of two matrices.
+        if (k != (transpose2 ? matrix2.colCount() : matrix2.rowCount())) {
             throw IllegalArithmeticsException{
                     "The column size of the first matrix must be the same as the row size of the second matrix on "
                     "the matrix multiplication operation."
             };
         }
+
+        BasicMatrix<Scalar> product{m, n};
+        const size_t stride1 = matrix1.stride();
+        const size_t stride2 = matrix2.stride();
+        kernels::gemm(m, n, k,
+                      matrix1.dataHolder(), transpose1 ? 1 : stride1, transpose1 ? stride1 : 1,
+                      matrix2.dataHolder(), transpose2 ? 1 : stride2, transpose2 ? stride2 : 1,
+                      product.dataHolder(), product.stride());
+        return product;
     }
 
-    Matrix sum(const Matrix& matrix, double c) {
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2) {
+        return multiply_strided(matrix1, false, matrix2, false);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicTransposedView<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2) {
+        return multiply_strided(matrix1.base(), true, matrix2, false);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix1, const BasicTransposedView<Scalar>& matrix2) {
+        return multiply_strided(matrix1, false, matrix2.base(), true);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicTransposedView<Scalar>& matrix1, const BasicTransposedView<Scalar>& matrix2) {
+        return multiply_strided(matrix1.base(), true, matrix2.base(), true);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix, typename NonDeduced<Scalar>::type c) {
         return matrix + c;
     }
 
-    Matrix sum(const Matrix& matrix1, const Matrix& matrix2) {
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2) {
         return matrix1 + matrix2;
     }
 
-    Matrix transpose(const Matrix& matrix) {
+    template <class Scalar>
+    BasicMatrix<Scalar> transpose(const BasicMatrix<Scalar>& matrix) {
         return matrix.T();
     }
 
-    Matrix minor(const Matrix& matrix, size_t m, size_t n) {
+    template <class Scalar>
+    BasicTransposedView<Scalar>::BasicTransposedView(const BasicMatrix<Scalar>& matrix) : _matrix(&matrix) {}
+
+    template <class Scalar>
+    const BasicMatrix<Scalar>& BasicTransposedView<Scalar>::base() const {
+        return *_matrix;
+    }
+
+    template <class Scalar>
+    std::vector<size_t> BasicTransposedView<Scalar>::shape() const {
+        return std::vector<size_t>{_matrix->colCount(), _matrix->rowCount()};
+    }
+
+    template <class Scalar>
+    size_t BasicTransposedView<Scalar>::rowCount() const {
+        return _matrix->colCount();
+    }
+
+    template <class Scalar>
+    size_t BasicTransposedView<Scalar>::colCount() const {
+        return _matrix->rowCount();
+    }
+
+    template <class Scalar>
+    Scalar BasicTransposedView<Scalar>::at(size_t x, size_t y) const {
+        return _matrix->at(y, x);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicTransposedView<Scalar>::eval() const {
+        return _matrix->T();
+    }
+
+    template <class Scalar>
+    BasicTransposedView<Scalar> transpose_view(const BasicMatrix<Scalar>& matrix) {
+        return BasicTransposedView<Scalar>{matrix};
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> minor(const BasicMatrix<Scalar>& matrix, size_t m, size_t n) {
+        NUMPP_STATS_PROFILE("minor");
         // Checking shape of the given matrix (must be a square matrix)
-        if (matrix.shape()[0] != matrix.shape()[1]) {
+        if (matrix.rowCount() != matrix.colCount()) {
             throw IllegalArithmeticsException{"Cannot calculate minor for a non-square matrix."};
         }
 
-        if (!(m < matrix.shape()[0] && n < matrix.shape()[1])) {
+        if (!(m < matrix.rowCount() && n < matrix.colCount())) {
             throw IllegalArithmeticsException("Illegal index of row or column.");
         }
 
-        Vector2D vector2d = matrix.toVector2D();
-        vector2d.erase(vector2d.begin() + (long) m);
-        for (auto& row : vector2d) {
-            row.erase(row.begin() + (long) n);
+        const size_t size = matrix.rowCount();
+        BasicMatrix<Scalar> res{size - 1, size - 1};
+        Scalar* dst = res.dataHolder();
+        for (size_t r = 0; r < size; r++) {
+            if (r == m) {
+                continue;
+            }
+            for (size_t c = 0; c < size; c++) {
+                if (c != n) {
+                    *dst++ = matrix.at(r, c);
+                }
+            }
         }
-        return Matrix{vector2d};
+        return res;
     }
 
-    double determinant(const Matrix& matrix) {
-        if (matrix.shape()[0] == matrix.shape()[1]) {
-            if (matrix.shape()[0] == 2) {
-                return matrix.at(0, 0) * matrix.at(1, 1) - matrix.at(0, 1) * matrix.at(1, 0);
-            }
-            else
-            {
-                Matrix upper_triangle = upper_triangular(matrix);
-                    double res = 1;
-                    for (int row = 0; row < upper_triangle.shape()[0]; row++) {
-                        res *= upper_triangle.at(row, row);
-                    }
-                    return res;
+    template <class Scalar>
+    BasicLUDecomposition<Scalar>::BasicLUDecomposition(const BasicMatrix<Scalar>& matrix) :
+            _lu(matrix), _permutation(matrix.rowCount()), _sign(1), _singular(false) {
+        NUMPP_STATS_PROFILE("lu");
+        if (matrix.rowCount() != matrix.colCount()) {
+            throw IllegalArithmeticsException{"Cannot calculate LU decomposition for a non-square matrix."};
+        }
+        _singular = !kernels::lu_factor(_lu.rowCount(), _lu.dataHolder(), _lu.stride(), _permutation.data(), _sign);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicLUDecomposition<Scalar>::L() const {
+        const size_t n = _lu.rowCount();
+        BasicMatrix<Scalar> res = identity<Scalar>(n);
+        for (size_t r = 1; r < n; r++) {
+            std::copy(_lu.dataHolder() + r * _lu.stride(), _lu.dataHolder() + r * _lu.stride() + r,
+                      res.dataHolder() + r * res.stride());
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicLUDecomposition<Scalar>::U() const {
+        const size_t n = _lu.rowCount();
+        BasicMatrix<Scalar> res = zeros<Scalar>(n, n);
+        for (size_t r = 0; r < n; r++) {
+            std::copy(_lu.dataHolder() + r * _lu.stride() + r, _lu.dataHolder() + r * _lu.stride() + n,
+                      res.dataHolder() + r * res.stride() + r);
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicLUDecomposition<Scalar>::P() const {
+        const size_t n = _lu.rowCount();
+        BasicMatrix<Scalar> res = zeros<Scalar>(n, n);
+        for (size_t r = 0; r < n; r++) {
+            res.dataHolder()[r * res.stride() + _permutation[r]] = Scalar(1);
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    const BasicMatrix<Scalar>& BasicLUDecomposition<Scalar>::packed() const {
+        return _lu;
+    }
+
+    template <class Scalar>
+    const std::vector<size_t>& BasicLUDecomposition<Scalar>::permutation() const {
+        return _permutation;
+    }
+
+    template <class Scalar>
+    bool BasicLUDecomposition<Scalar>::isSingular() const {
+        return _singular;
+    }
+
+    template <class Scalar>
+    Scalar BasicLUDecomposition<Scalar>::determinant() const {
+        if (_singular) {
+            return Scalar();
+        }
+        Scalar res = static_cast<Scalar>(_sign);
+        for (size_t i = 0; i < _lu.rowCount(); i++) {
+            res *= _lu.at(i, i);
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicLUDecomposition<Scalar>::solve(const BasicMatrix<Scalar>& b) const {
+        const size_t n = _lu.rowCount();
+        if (b.rowCount() != n) {
+            throw IllegalArithmeticsException{"The right-hand side must have as many rows as the factored matrix."};
+        }
+        if (_singular) {
+            throw IllegalArithmeticsException{"Cannot solve a linear system whose matrix is singular."};
+        }
+
+        const size_t k = b.colCount();
+        BasicMatrix<Scalar> x(n, k, BasicAlignedBuffer<Scalar>(n * k));
+        for (size_t r = 0; r < n; r++) {
+            const Scalar* src = b.dataHolder() + _permutation[r] * b.stride();
+            std::copy(src, src + k, x.dataHolder() + r * x.stride());
+        }
+        kernels::lu_solve(n, _lu.dataHolder(), _lu.stride(), x.dataHolder(), x.stride(), k);
+        return x;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicLUDecomposition<Scalar>::invert() const {
+        if (_singular) {
+            throw IllegalArithmeticsException{"The given matrix has no invert since its determinant is zero."};
+        }
+        return solve(identity<Scalar>(_lu.rowCount()));
+    }
+
+    template <class Scalar>
+    BasicLUDecomposition<Scalar> lu(const BasicMatrix<Scalar>& matrix) {
+        return BasicLUDecomposition<Scalar>{matrix};
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> solve(const BasicMatrix<Scalar>& a, const BasicMatrix<Scalar>& b) {
+        NUMPP_STATS_PROFILE("solve");
+        return lu(a).solve(b);
+    }
+
+    template <class Scalar>
+    Scalar determinant(const BasicMatrix<Scalar>& matrix) {
+        NUMPP_STATS_PROFILE("determinant");
+        if (matrix.rowCount() == matrix.colCount()) {
+            // Small matrices use the closed forms of the fixed-size matrices.
+            switch (matrix.rowCount()) {
+                case 1:
+                    return kernels::SmallSquare<Scalar, 1>::determinant(matrix.dataHolder(), matrix.stride());
+                case 2:
+                    return kernels::SmallSquare<Scalar, 2>::determinant(matrix.dataHolder(), matrix.stride());
+                case 3:
+                    return kernels::SmallSquare<Scalar, 3>::determinant(matrix.dataHolder(), matrix.stride());
+                case 4:
+                    return kernels::SmallSquare<Scalar, 4>::determinant(matrix.dataHolder(), matrix.stride());
+                default:
+                    return lu(matrix).determinant();
             }
         }
         else {
@@ -695,36 +1240,57 @@ namespace numpp {
         }
     }
 
-    Matrix adjugate(const Matrix& matrix) {
-        Vector2D adjugate_vec2d = matrix.toVector2D();
-        for (int row = 0; row < matrix.shape()[0]; row++) {
-            for (int col = 0; col < matrix.shape()[1]; col++) {
+    template <class Scalar>
+    BasicMatrix<Scalar> adjugate(const BasicMatrix<Scalar>& matrix) {
+        NUMPP_STATS_PROFILE("adjugate");
+        BasicLUDecomposition<Scalar> factorization = lu(matrix);
+        if (!factorization.isSingular()) {
+            // adj(A) = det(A) * A^-1
+            return factorization.invert() * factorization.determinant();
+        }
+
+        // Singular matrices have no inverse: fall back to the cofactors.
+        BasicVector2D<Scalar> adjugate_vec2d = matrix.toVector2D();
+        for (size_t row = 0; row < matrix.rowCount(); row++) {
+            for (size_t col = 0; col < matrix.colCount(); col++) {
                 adjugate_vec2d[row][col] =
-                        std::pow(-1, row + col + 2) * determinant(minor(matrix, row, col));
+                        ((row + col) % 2 == 0 ? Scalar(1) : Scalar(-1)) * determinant(minor(matrix, row, col));
             }
         }
-        return Matrix{adjugate_vec2d}.T();
+        return BasicMatrix<Scalar>{adjugate_vec2d}.T();
     }
 
-    Matrix invert(const Matrix& matrix) {
-        double det = determinant(matrix);
-        if (det == 0)
-        {
-            throw IllegalArithmeticsException{"The given matrix has no invert since its determinant is zero."};
+    template <class Scalar>
+    BasicMatrix<Scalar> invert(const BasicMatrix<Scalar>& matrix) {
+        NUMPP_STATS_PROFILE("invert");
+        if (matrix.rowCount() != matrix.colCount()) {
+            throw IllegalArithmeticsException{"Cannot calculate the inverse of a non-square matrix."};
         }
-
-        Matrix res = adjugate(matrix) / det;
-        return res;
+        return lu(matrix).invert();
     }
 
-    Matrix concatenate(const Matrix& matrix1, const Matrix& matrix2, int axis=0) {
+    template <class Scalar>
+    BasicMatrix<Scalar> concatenate(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2, int axis) {
+        NUMPP_STATS_PROFILE("concatenate");
         if (axis == 0) {
             // Concatenate vertically
-            if (matrix1.shape()[1] == matrix2.shape()[1]) {
-                Vector2D res_vec2d = matrix1.toVector2D();
-                Vector2D vec2d_other = matrix2.toVector2D();
-                res_vec2d.insert(res_vec2d.end(), vec2d_other.begin(), vec2d_other.end());
-                return Matrix{res_vec2d};
+            if (matrix1.colCount() == matrix2.colCount()) {
+                const size_t rows1 = matrix1.rowCount();
+                const size_t rows2 = matrix2.rowCount();
+                const size_t cols = matrix1.colCount();
+                BasicMatrix<Scalar> res{rows1 + rows2, cols};
+                Scalar* dst = res.dataHolder();
+                for (size_t r = 0; r < rows1; r++) {
+                    for (size_t c = 0; c < cols; c++) {
+                        *dst++ = matrix1.at(r, c);
+                    }
+                }
+                for (size_t r = 0; r < rows2; r++) {
+                    for (size_t c = 0; c < cols; c++) {
+                        *dst++ = matrix2.at(r, c);
+                    }
+                }
+                return res;
             }
             else {
                 throw IllegalArithmeticsException{"To concatenate two matrices through axis 0, "
@@ -733,14 +1299,21 @@ namespace numpp {
         }
         else if (axis == 1) {
             // Concatenate horizontally
-            if (matrix1.shape()[0] == matrix2.shape()[0]) {
-                Vector2D res_vec2d = matrix1.toVector2D();
-                Vector2D vec2d_other = matrix2.toVector2D();
-                for (int row = 0; row < res_vec2d.size(); row++) {
-                    res_vec2d[row].insert(res_vec2d[row].end(), vec2d_other[row].begin(),
-                                          vec2d_other[row].end());
+            if (matrix1.rowCount() == matrix2.rowCount()) {
+                const size_t rows = matrix1.rowCount();
+                const size_t cols1 = matrix1.colCount();
+                const size_t cols2 = matrix2.colCount();
+                BasicMatrix<Scalar> res{rows, cols1 + cols2};
+                Scalar* dst = res.dataHolder();
+                for (size_t r = 0; r < rows; r++) {
+                    for (size_t c = 0; c < cols1; c++) {
+                        *dst++ = matrix1.at(r, c);
+                    }
+                    for (size_t c = 0; c < cols2; c++) {
+                        *dst++ = matrix2.at(r, c);
+                    }
                 }
-                return Matrix{res_vec2d};
+                return res;
             }
             else {
                 throw IllegalArithmeticsException{"To concatenate two matrices through axis 1, "
@@ -752,84 +1325,75 @@ namespace numpp {
         }
     }
 
-    Matrix ero_swap(const Matrix& matrix, size_t r1, size_t r2) {
-        Vector2D res = matrix.toVector2D();
-        std::vector<double> tmp = res[r1];
-        std::transform(res[r2].begin(), res[r2].end(), res[r1].begin(),
-                       [](double elem) -> double {return elem;});
-        std::transform(tmp.begin(), tmp.end(), res[r2].begin(),
-                       [](double elem) -> double {return elem;});
-        return Matrix{res};
-    }
-
-    Matrix ero_multiply(const Matrix& matrix, size_t r, double c) {
-        Vector2D res_vec2d = matrix.toVector2D();
-        std::transform(res_vec2d[r].begin(), res_vec2d[r].end(), res_vec2d[r].begin(),
-                       [c](double elem) -> double {
-                           return elem * c;
-        });
-        return Matrix{res_vec2d};
-    }
-
-    Matrix ero_sum(const Matrix& matrix, size_t r1, double c, size_t r2) {
-        Vector2D res_vec2d = matrix.toVector2D();
-        std::transform(res_vec2d[r1].begin(), res_vec2d[r1].end(), res_vec2d[r2].begin(),
-                       res_vec2d[r2].begin(),
-                       [c](double elem1, double elem2) -> double {
-                           return elem2 + c * elem1;
-        });
-        return Matrix{res_vec2d};
-    }
-
-    Matrix upper_triangular(const Matrix& matrix) {
-        Matrix eliminated_mat = matrix;
-        int pivot_num = 0;
-
-        for (int col = 0; col < eliminated_mat.shape()[1]; col++) {
-            // Find the first non-zero element to be as pivot.
-            // If the pivot has been found (pivot_row != -1), use it to eliminate other non-zero elements.
-            int pivot_row = -1;
-            for (int row = pivot_num; row < eliminated_mat.shape()[0]; row++) {
-                if (eliminated_mat.at(row, col) != 0) {
-                    if (pivot_row == -1){
-                        // Found the pivot.
-                        pivot_row = row;
-                        pivot_num++;
-                    }
-                    else {
-                        eliminated_mat = ero_sum(eliminated_mat, pivot_row,
-                                -(eliminated_mat.at(row, col)/eliminated_mat.at(pivot_row, col)),
-                                row);
-                    }
-                }
-            }
-            if (pivot_row != -1) {
-                eliminated_mat = ero_swap(eliminated_mat, pivot_row, pivot_num - 1);
-            }
+    template <class Scalar>
+    void ero_swap_inplace(BasicMatrix<Scalar>& matrix, size_t r1, size_t r2) {
+        if (!(r1 < matrix.rowCount() && r2 < matrix.rowCount())) {
+            throw IllegalArithmeticsException("Illegal index of row or column.");
+        }
+        if (r1 != r2) {
+            Scalar* row1 = matrix.dataHolder() + r1 * matrix.stride();
+            std::swap_ranges(row1, row1 + matrix.colCount(), matrix.dataHolder() + r2 * matrix.stride());
         }
-        return eliminated_mat;
     }
 
-    Matrix rref(const Matrix& matrix) {
-        Matrix res = upper_triangular(matrix);
-
-        for (int r = 0; r < res.shape()[0]; r++) {
-            int pivot_idx = -1;
-            for (int c = 0; c < res.shape()[1]; c++) {
-                if (res[r][c].num() != 0) {
-                    pivot_idx = c;
-                    if (res[r][c].num() != 1) {
-                        res[r] /= res[r][c].num();
-                    }
-                    break;
-                }
-            }
+    template <class Scalar>
+    void ero_multiply_inplace(BasicMatrix<Scalar>& matrix, size_t r, typename NonDeduced<Scalar>::type c) {
+        if (!(r < matrix.rowCount())) {
+            throw IllegalArithmeticsException("Illegal index of row or column.");
+        }
+        Scalar* row = matrix.dataHolder() + r * matrix.stride();
+        kernels::binary_with_scalar_kernel<Scalar>(kernels::OP_MUL)(matrix.colCount(), row, c, row);
+    }
 
-            // Eliminate the element above this pivot element
-            if (r > 0 && pivot_idx > -1 && res[r - 1][pivot_idx].num() != 0) {
-                res[r - 1] += res[r] * res[r-1][pivot_idx].num();
-            }
+    template <class Scalar>
+    void ero_sum_inplace(BasicMatrix<Scalar>& matrix, size_t r1, typename NonDeduced<Scalar>::type c, size_t r2) {
+        if (!(r1 < matrix.rowCount() && r2 < matrix.rowCount())) {
+            throw IllegalArithmeticsException("Illegal index of row or column.");
         }
+        if (r1 == r2) {
+            ero_multiply_inplace(matrix, r1, Scalar(1) + c);
+            return;
+        }
+        kernels::axpy(matrix.colCount(), c, matrix.dataHolder() + r1 * matrix.stride(), 1,
+                      matrix.dataHolder() + r2 * matrix.stride());
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_swap(const BasicMatrix<Scalar>& matrix, size_t r1, size_t r2) {
+        BasicMatrix<Scalar> res = matrix;
+        ero_swap_inplace(res, r1, r2);
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_multiply(const BasicMatrix<Scalar>& matrix, size_t r, typename NonDeduced<Scalar>::type c) {
+        BasicMatrix<Scalar> res = matrix;
+        ero_multiply_inplace(res, r, c);
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_sum(const BasicMatrix<Scalar>& matrix, size_t r1, typename NonDeduced<Scalar>::type c, size_t r2) {
+        BasicMatrix<Scalar> res = matrix;
+        ero_sum_inplace(res, r1, c, r2);
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> upper_triangular(const BasicMatrix<Scalar>& matrix) {
+        static_assert(is_field<Scalar>::value, "Elimination needs a floating-point or complex element type.");
+        NUMPP_STATS_PROFILE("upper_triangular");
+        BasicMatrix<Scalar> res = matrix;
+        kernels::row_echelon(res.rowCount(), res.colCount(), res.dataHolder(), res.stride(), false);
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> rref(const BasicMatrix<Scalar>& matrix) {
+        static_assert(is_field<Scalar>::value, "Elimination needs a floating-point or complex element type.");
+        NUMPP_STATS_PROFILE("rref");
+        BasicMatrix<Scalar> res = matrix;
+        kernels::row_echelon(res.rowCount(), res.colCount(), res.dataHolder(), res.stride(), true);
         return res;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,405 @@
+#ifndef NUMPP_BATCH_H
+#define NUMPP_BATCH_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPParallel.h"
+#include "NumPPStats.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace numpp {
+    /*
+     * Many matrices of the same shape in one buffer, for workloads made of thousands of small independent problems
+     * (one 3 by 3 or 6 by 6 system per particle, pixel, sensor, ...).
+     *
+     * The matrices are interleaved: element (x, y) of all of them is one contiguous array, indexed by the position
+     * of the matrix in the batch, and `elementData(x, y)` points at it. Batched `multiply`, `solve`, `invert` and
+     * `determinant` run their SIMD packets across the batch and split the batch across threads, so a batch costs
+     * one allocation and one call instead of one per matrix, and small shapes still fill whole registers.
+     * */
+    template <class Scalar>
+    class BasicMatrixBatch {
+    private:
+        size_t _count;
+        size_t _rows;
+        size_t _cols;
+
+        /*
+         * Distance between the arrays of two consecutive elements: `_count` rounded up to a whole cache line,
+         * plus one line when that would be a multiple of 4 KiB, which maps every element to the same cache sets.
+         * */
+        size_t _stride;
+
+        BasicAlignedBuffer<Scalar> _data;
+
+        static size_t padded(size_t count);
+
+    public:
+        typedef Scalar value_type;
+
+        /*
+         * `count` zero matrices of shape rows by cols.
+         * */
+        BasicMatrixBatch(size_t count, size_t rows, size_t cols);
+
+        /*
+         * Copy of the given matrices, which must all have the same shape; otherwise throws IllegalArithmeticsException.
+         * */
+        explicit BasicMatrixBatch(const std::vector<BasicMatrix<Scalar>>& matrices);
+
+        /*
+         * `count` identity matrices of size n.
+         * */
+        static BasicMatrixBatch identity(size_t count, size_t n);
+
+        /*
+         * {size(), rowCount(), colCount()}
+         * */
+        std::vector<size_t> shape() const;
+
+        /*
+         * Number of matrices in the batch.
+         * */
+        size_t size() const;
+
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        size_t stride() const;
+
+        /*
+         * Element (x, y) of matrix `index`.
+         * */
+        Scalar at(size_t index, size_t x, size_t y) const;
+
+        Scalar& operator()(size_t index, size_t x, size_t y);
+        const Scalar& operator()(size_t index, size_t x, size_t y) const;
+
+        /*
+         * Element (x, y) of every matrix, as a contiguous array of size() elements.
+         * */
+        Scalar* elementData(size_t x, size_t y);
+        const Scalar* elementData(size_t x, size_t y) const;
+
+        /*
+         * Copy of matrix `index`, and the other way round; setMatrix throws IllegalArithmeticsException on a shape mismatch.
+         * */
+        BasicMatrix<Scalar> matrix(size_t index) const;
+        void setMatrix(size_t index, const BasicMatrix<Scalar>& matrix);
+
+        std::vector<BasicMatrix<Scalar>> toMatrices() const;
+
+        Scalar* dataHolder();
+        const Scalar* dataHolder() const;
+    };
+
+    typedef BasicMatrixBatch<double> MatrixBatch;
+
+    template <class Scalar>
+    size_t BasicMatrixBatch<Scalar>::padded(size_t count) {
+        const size_t line = std::max<size_t>(BasicAlignedBuffer<Scalar>::alignment / sizeof(Scalar), 1);
+        const size_t stride = (count + line - 1) / line * line;
+        return stride != 0 && stride * sizeof(Scalar) % 4096 == 0 ? stride + line : stride;
+    }
+
+    template <class Scalar>
+    BasicMatrixBatch<Scalar>::BasicMatrixBatch(size_t count, size_t rows, size_t cols) :
+            _count(count), _rows(rows), _cols(cols), _stride(padded(count)), _data(padded(count) * rows * cols) {
+        std::fill(_data.data(), _data.data() + _data.size(), Scalar());
+    }
+
+    template <class Scalar>
+    BasicMatrixBatch<Scalar>::BasicMatrixBatch(const std::vector<BasicMatrix<Scalar>>& matrices) :
+            BasicMatrixBatch(matrices.size(), matrices.empty() ? 0 : matrices[0].rowCount(),
+                             matrices.empty() ? 0 : matrices[0].colCount()) {
+        for (size_t i = 0; i < matrices.size(); i++) {
+            setMatrix(i, matrices[i]);
+        }
+    }
+
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> BasicMatrixBatch<Scalar>::identity(size_t count, size_t n) {
+        BasicMatrixBatch<Scalar> res(count, n, n);
+        for (size_t d = 0; d < n; d++) {
+            Scalar* diagonal = res.elementData(d, d);
+            std::fill(diagonal, diagonal + count, Scalar(1));
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    std::vector<size_t> BasicMatrixBatch<Scalar>::shape() const {
+        return std::vector<size_t>{_count, _rows, _cols};
+    }
+
+    template <class Scalar>
+    size_t BasicMatrixBatch<Scalar>::size() const {
+        return _count;
+    }
+
+    template <class Scalar>
+    size_t BasicMatrixBatch<Scalar>::rowCount() const {
+        return _rows;
+    }
+
+    template <class Scalar>
+    size_t BasicMatrixBatch<Scalar>::colCount() const {
+        return _cols;
+    }
+
+    template <class Scalar>
+    size_t BasicMatrixBatch<Scalar>::stride() const {
+        return _stride;
+    }
+
+    template <class Scalar>
+    Scalar BasicMatrixBatch<Scalar>::at(size_t index, size_t x, size_t y) const {
+        return _data.data()[(x * _cols + y) * _stride + index];
+    }
+
+    template <class Scalar>
+    Scalar& BasicMatrixBatch<Scalar>::operator()(size_t index, size_t x, size_t y) {
+        return _data.data()[(x * _cols + y) * _stride + index];
+    }
+
+    template <class Scalar>
+    const Scalar& BasicMatrixBatch<Scalar>::operator()(size_t index, size_t x, size_t y) const {
+        return _data.data()[(x * _cols + y) * _stride + index];
+    }
+
+    template <class Scalar>
+    Scalar* BasicMatrixBatch<Scalar>::elementData(size_t x, size_t y) {
+        return _data.data() + (x * _cols + y) * _stride;
+    }
+
+    template <class Scalar>
+    const Scalar* BasicMatrixBatch<Scalar>::elementData(size_t x, size_t y) const {
+        return _data.data() + (x * _cols + y) * _stride;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrixBatch<Scalar>::matrix(size_t index) const {
+        BasicMatrix<Scalar> res(_rows, _cols, BasicAlignedBuffer<Scalar>(_rows * _cols));
+        for (size_t x = 0; x < _rows; x++) {
+            for (size_t y = 0; y < _cols; y++) {
+                res.dataHolder()[x * res.stride() + y] = at(index, x, y);
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    void BasicMatrixBatch<Scalar>::setMatrix(size_t index, const BasicMatrix<Scalar>& matrix) {
+        if (matrix.rowCount() != _rows || matrix.colCount() != _cols) {
+            throw IllegalArithmeticsException{"All matrices of a batch must have the same shape."};
+        }
+        for (size_t x = 0; x < _rows; x++) {
+            for (size_t y = 0; y < _cols; y++) {
+                (*this)(index, x, y) = matrix.at(x, y);
+            }
+        }
+    }
+
+    template <class Scalar>
+    std::vector<BasicMatrix<Scalar>> BasicMatrixBatch<Scalar>::toMatrices() const {
+        std::vector<BasicMatrix<Scalar>> res;
+        res.reserve(_count);
+        for (size_t i = 0; i < _count; i++) {
+            res.push_back(matrix(i));
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    Scalar* BasicMatrixBatch<Scalar>::dataHolder() {
+        return _data.data();
+    }
+
+    template <class Scalar>
+    const Scalar* BasicMatrixBatch<Scalar>::dataHolder() const {
+        return _data.data();
+    }
+
+    /*
+     * Call `body(first, lanes)` for consecutive ranges of at most kernels::BATCH_LANES matrices covering [0, count),
+     * on several threads when there is enough work. `work` is the number of elements touched per matrix.
+     * */
+    template <class Body>
+    void for_each_lane_block(size_t count, size_t work, Body body) {
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(work, 1) + 1;
+        parallel::parallel_for(0, count, grain, [&](size_t begin, size_t end) {
+            for (size_t first = begin; first < end; first += kernels::BATCH_LANES) {
+                body(first, std::min(kernels::BATCH_LANES, end - first));
+            }
+        }, kernels::BATCH_LANES);
+    }
+
+    /*
+     * Product of every pair of matrices: matrix i of the result is a[i] * b[i].
+     * */
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> multiply(const BasicMatrixBatch<Scalar>& a, const BasicMatrixBatch<Scalar>& b) {
+        NUMPP_STATS_PROFILE("batch_multiply");
+        if (a.size() != b.size()) {
+            throw IllegalArithmeticsException{"To multiply two batches, they must hold the same number of matrices."};
+        }
+        if (a.colCount() != b.rowCount()) {
+            throw IllegalArithmeticsException{
+                    "The column size of the first matrix must be the same as the row size of the second matrix on "
+                    "the matrix multiplication operation."
+            };
+        }
+
+        const size_t m = a.rowCount();
+        const size_t k = a.colCount();
+        const size_t n = b.colCount();
+        BasicMatrixBatch<Scalar> product(a.size(), m, n);
+        const size_t ld = product.stride();
+        for_each_lane_block(a.size(), m * n * k, [&](size_t first, size_t lanes) {
+            kernels::batch_gemm(m, n, k, a.dataHolder() + first, b.dataHolder() + first, product.dataHolder() + first,
+                                ld, lanes, typename kernels::SimdTraits<Scalar>::vectorized());
+        });
+        return product;
+    }
+
+    /*
+     * The n by (n + k) batch [a | 0], whose right part the caller fills with the right-hand sides.
+     * */
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> augment(const BasicMatrixBatch<Scalar>& a, size_t k) {
+        const size_t n = a.rowCount();
+        BasicMatrixBatch<Scalar> res(a.size(), n, n + k);
+        for (size_t x = 0; x < n; x++) {
+            for (size_t y = 0; y < n; y++) {
+                std::copy(a.elementData(x, y), a.elementData(x, y) + a.size(), res.elementData(x, y));
+            }
+        }
+        return res;
+    }
+
+    /*
+     * Run batch_gauss_solve over every matrix of an augmented batch [A | B] with n rows, flagging the singular ones.
+     * `sign` (one per matrix, or null) is negated on every row swap.
+     * */
+    template <class Scalar>
+    std::vector<unsigned char> gauss_solve(BasicMatrixBatch<Scalar>& ab, Scalar* sign) {
+        const size_t n = ab.rowCount();
+        const size_t k = ab.colCount() - n;
+        std::vector<unsigned char> singular(ab.size(), 0);
+        for_each_lane_block(ab.size(), n * n * (n + k), [&](size_t first, size_t lanes) {
+            kernels::batch_gauss_solve(n, k, ab.dataHolder() + first, ab.stride(), lanes,
+                                       sign ? sign + first : sign, singular.data() + first);
+        });
+        return singular;
+    }
+
+    /*
+     * The right part B of a solved augmented batch [U | X], after checking that no matrix was singular.
+     * */
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> solution(const BasicMatrixBatch<Scalar>& ab, const std::vector<unsigned char>& singular) {
+        const size_t index = static_cast<size_t>(std::find(singular.begin(), singular.end(), 1) - singular.begin());
+        if (index != singular.size()) {
+            throw IllegalArithmeticsException{"Cannot solve a linear system whose matrix is singular (matrix "
+                                              + std::to_string(index) + " of the batch)."};
+        }
+
+        const size_t n = ab.rowCount();
+        const size_t k = ab.colCount() - n;
+        BasicMatrixBatch<Scalar> res(ab.size(), n, k);
+        for (size_t x = 0; x < n; x++) {
+            for (size_t y = 0; y < k; y++) {
+                std::copy(ab.elementData(x, n + y), ab.elementData(x, n + y) + ab.size(), res.elementData(x, y));
+            }
+        }
+        return res;
+    }
+
+    /*
+     * Solution of every system: matrix i of the result is x with a[i] * x = b[i].
+     * Throws IllegalArithmeticsException if any matrix of `a` is singular.
+     * */
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> solve(const BasicMatrixBatch<Scalar>& a, const BasicMatrixBatch<Scalar>& b) {
+        static_assert(is_field<Scalar>::value, "Elimination needs a floating-point or complex element type.");
+        NUMPP_STATS_PROFILE("batch_solve");
+        const size_t n = a.rowCount();
+        if (a.colCount() != n) {
+            throw IllegalArithmeticsException{"Cannot solve a linear system whose matrix is not square."};
+        }
+        if (a.size() != b.size() || b.rowCount() != n) {
+            throw IllegalArithmeticsException{"The right-hand sides must be as many as the matrices and have as many rows."};
+        }
+
+        BasicMatrixBatch<Scalar> ab = augment(a, b.colCount());
+        for (size_t x = 0; x < n; x++) {
+            for (size_t y = 0; y < b.colCount(); y++) {
+                std::copy(b.elementData(x, y), b.elementData(x, y) + b.size(), ab.elementData(x, n + y));
+            }
+        }
+        const std::vector<unsigned char> singular = gauss_solve(ab, static_cast<Scalar*>(nullptr));
+        return solution(ab, singular);
+    }
+
+    /*
+     * Inverse of every matrix. Throws IllegalArithmeticsException if any of them is singular.
+     * */
+    template <class Scalar>
+    BasicMatrixBatch<Scalar> invert(const BasicMatrixBatch<Scalar>& batch) {
+        static_assert(is_field<Scalar>::value, "Elimination needs a floating-point or complex element type.");
+        NUMPP_STATS_PROFILE("batch_invert");
+        const size_t n = batch.rowCount();
+        if (batch.colCount() != n) {
+            throw IllegalArithmeticsException{"Cannot calculate the inverse of a non-square matrix."};
+        }
+
+        BasicMatrixBatch<Scalar> ab = augment(batch, n);
+        for (size_t d = 0; d < n; d++) {
+            std::fill(ab.elementData(d, n + d), ab.elementData(d, n + d) + batch.size(), Scalar(1));
+        }
+        const std::vector<unsigned char> singular = gauss_solve(ab, static_cast<Scalar*>(nullptr));
+        return solution(ab, singular);
+    }
+
+    /*
+     * Determinant of every matrix, in batch order. Up to 4 by 4 they come from closed forms, as for a single matrix;
+     * larger matrices are eliminated, and those found singular give exactly zero.
+     * */
+    template <class Scalar>
+    std::vector<Scalar> determinant(const BasicMatrixBatch<Scalar>& batch) {
+        static_assert(is_field<Scalar>::value, "Elimination needs a floating-point or complex element type.");
+        NUMPP_STATS_PROFILE("batch_determinant");
+        const size_t n = batch.rowCount();
+        if (batch.colCount() != n) {
+            throw IllegalArithmeticsException{"Cannot calculate determinant for a non-square matrix."};
+        }
+
+        std::vector<Scalar> res(batch.size(), Scalar(1));
+        if (n >= 1 && n <= 4) {
+            // Closed forms read the batch directly: no copy, no pivoting.
+            for_each_lane_block(batch.size(), n * n, [&](size_t first, size_t lanes) {
+                kernels::batch_small_determinant(n, batch.dataHolder() + first, batch.stride(), lanes, res.data() + first);
+            });
+            return res;
+        }
+
+        BasicMatrixBatch<Scalar> factors = batch;
+        const std::vector<unsigned char> singular = gauss_solve(factors, res.data());
+        // det = sign * product of the diagonal of U
+        const kernels::BinaryKernel<Scalar> mul = kernels::binary_kernel<Scalar>(kernels::OP_MUL);
+        for (size_t d = 0; d < n; d++) {
+            mul(batch.size(), res.data(), factors.elementData(d, d), res.data());
+        }
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (singular[i]) {
+                res[i] = Scalar();
+            }
+        }
+        return res;
+    }
+}
+
+#endif //NUMPP_BATCH_H
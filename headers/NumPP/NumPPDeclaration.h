@@ -2,14 +2,24 @@
 #define NUMPP_H
 
 #include <vector>
+#include <complex>
 #include <cstdint>
+#include <cstddef>
+#include <iosfwd>
+#include <iterator>
+#include <map>
+#include <string>
+#include <type_traits>
 
 namespace numpp {
     int ED = INT32_MAX;
 
     extern bool show_numpp_exception_details;
 
-    using Vector2D = std::vector<std::vector<double>>;
+    template <class Scalar>
+    using BasicVector2D = std::vector<std::vector<Scalar>>;
+
+    using Vector2D = BasicVector2D<double>;
 
     /*
      * Possible to pass negative indexes like -1 indicating the last element.
@@ -48,67 +58,485 @@ namespace numpp {
         const char* what() const noexcept override;
     };
 
-    class MatrixSection;
+    /*
+     * Reading or writing a file failed, or the file is not in the expected format.
+     * */
+    class IOException : std::exception {
+    private:
+        std::string message;
+    public:
+        explicit IOException(std::string msg);
+        const char* what() const noexcept override;
+    };
+
+    template <class T>
+    struct is_complex : std::false_type {};
+
+    template <class T>
+    struct is_complex<std::complex<T>> : std::true_type {};
+
+    /*
+     * Element types with an exact division, as needed by elimination (LU, determinant, invert, solve, RREF, ...):
+     * floating-point and complex numbers.
+     * */
+    template <class T>
+    struct is_field : std::integral_constant<bool, std::is_floating_point<T>::value || is_complex<T>::value> {};
 
-    class Matrix {
+    /*
+     * Element type of averages: integers are averaged in double, every other type in itself.
+     * */
+    template <class T>
+    struct Promoted {
+        typedef typename std::conditional<std::is_integral<T>::value, double, T>::type type;
+    };
+
+    /*
+     * Type of |x|, as returned by variances and norms: the real type of a complex number, otherwise Promoted<T>.
+     * */
+    template <class T>
+    struct Magnitude {
+        typedef typename Promoted<T>::type type;
+    };
+
+    template <class T>
+    struct Magnitude<std::complex<T>> {
+        typedef T type;
+    };
+
+    /*
+     * Keeps a parameter out of template argument deduction,
+     * so `numpp::multiply(float_matrix, 2.0)` takes the element type from the matrix alone.
+     * */
+    template <class T>
+    struct NonDeduced {
+        typedef T type;
+    };
+
+    /*
+     * Where matrix storage comes from, in the style of std::pmr::memory_resource.
+     * Every buffer remembers the resource it was allocated from and gives its memory back to it,
+     * so matrices from different resources can be mixed freely.
+     * `allocate` returns memory aligned to `alignment` bytes (a power of two) or throws std::bad_alloc;
+     * `deallocate` receives the same size and alignment.
+     * */
+    class MemoryResource {
+    public:
+        virtual ~MemoryResource() = default;
+
+        virtual void* allocate(size_t bytes, size_t alignment) = 0;
+        virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+    };
+
+    /*
+     * The heap (malloc and free); the initial default resource.
+     * */
+    MemoryResource* new_delete_resource();
+
+    /*
+     * Every thread keeps its own lists of free blocks, one per size class (powers of two up to 1 MiB),
+     * so allocating and freeing take no lock and mostly reuse memory instead of calling malloc.
+     * Larger blocks come from the heap. A thread caches a bounded number of blocks per class,
+     * and gives them back to the heap when it exits.
+     * */
+    MemoryResource* pool_resource();
+
+    /*
+     * The resource new matrices on the calling thread allocate from: the innermost live ScopedResource
+     * (or ScopedArena) of this thread, otherwise the process-wide default.
+     * */
+    MemoryResource* get_default_resource();
+
+    /*
+     * Replace the process-wide default (initially new_delete_resource()) and return the previous one.
+     * Existing matrices keep using the resource they were allocated from.
+     * */
+    MemoryResource* set_default_resource(MemoryResource* resource);
+
+    /*
+     * Monotonic arena: hands out memory from a few large chunks taken from `upstream`,
+     * and frees them all at once in release() or the destructor.
+     * Freeing the most recent allocation makes its memory available again, so a temporary created and destroyed
+     * in every iteration of a loop does not make the arena grow; other frees are ignored.
+     * Not thread-safe: use it from one thread at a time.
+     * */
+    class ArenaResource : public MemoryResource {
+    private:
+        struct Chunk {
+            Chunk* next;
+            size_t size;
+        };
+
+        MemoryResource* _upstream;
+        Chunk* _chunks;
+        char* _cursor;
+        char* _end;
+        size_t _initial_size;
+        size_t _next_chunk_size;
+
+        void grow(size_t min_bytes);
+
+    public:
+        explicit ArenaResource(size_t initial_size = 64 * 1024, MemoryResource* upstream = new_delete_resource());
+        ArenaResource(const ArenaResource&) = delete;
+        ArenaResource& operator=(const ArenaResource&) = delete;
+        ~ArenaResource() override;
+
+        void* allocate(size_t bytes, size_t alignment) override;
+        void deallocate(void* p, size_t bytes, size_t alignment) override;
+
+        /*
+         * Free every chunk. Nothing allocated from the arena may be used afterwards.
+         * */
+        void release();
+    };
+
+    /*
+     * Makes `resource` the default resource of the calling thread for the lifetime of this object.
+     * Scopes nest and must end in reverse order, as local variables do.
+     * */
+    class ScopedResource {
+    private:
+        MemoryResource* _previous;
+
+    public:
+        explicit ScopedResource(MemoryResource* resource);
+        ScopedResource(const ScopedResource&) = delete;
+        ScopedResource& operator=(const ScopedResource&) = delete;
+        ~ScopedResource();
+    };
+
+    /*
+     * An ArenaResource installed as the calling thread's default resource for the lifetime of this object:
+     * every matrix created on this thread inside the scope is allocated from the arena,
+     * and all of that memory is released at once when the scope ends.
+     *
+     * Matrices allocated inside must not outlive the scope. To keep a result, assign it to a matrix created
+     * before the scope (assignment keeps the target's own resource) or copy it after constructing a ScopedResource
+     * with another resource.
+     * */
+    class ScopedArena {
+    private:
+        ArenaResource _arena;
+        ScopedResource _scope;
+
+    public:
+        explicit ScopedArena(size_t initial_size = 64 * 1024);
+
+        ArenaResource& resource();
+    };
+
+    /*
+     * Calls of one instrumented operation and the wall time spent in them, nested operations included.
+     * */
+    struct OperationStats {
+        size_t calls = 0;
+        double seconds = 0;
+    };
+
+    /*
+     * Snapshot of the instrumentation counters since the start of the program or the last reset_stats().
+     * `constructions` counts new matrices that own their elements, except copies and moves; views are not counted.
+     * `copies` counts copy constructions and copy assignments, including Matrix(MatrixSection),
+     * `allocations` and `bytes_allocated` every storage buffer taken from a memory resource,
+     * and `operations` the operations that were called at least once, by name (e.g. "multiply", "T", "operator[]").
+     * */
+    struct Stats {
+        size_t constructions = 0;
+        size_t copies = 0;
+        size_t moves = 0;
+        size_t allocations = 0;
+        size_t bytes_allocated = 0;
+        std::map<std::string, OperationStats> operations;
+    };
+
+    /*
+     * Counters shared by all threads. They are only updated when NUMPP_ENABLE_STATS is defined
+     * before including NumPP; otherwise the instrumentation costs nothing and every counter stays zero.
+     * */
+    Stats stats();
+
+    void reset_stats();
+
+    std::ostream& operator<<(std::ostream& os, const Stats& snapshot);
+
+    /*
+     * Owning, contiguous block of `Scalar` aligned to `alignment` bytes.
+     * Every matrix keeps its elements in one of these instead of one heap allocation per row.
+     * Elements are copied as raw memory, so they must be trivially copyable.
+     *
+     * New buffers (including copies) allocate from get_default_resource() unless given a resource.
+     * A buffer keeps its resource for life: assigning to it reuses or reallocates from its own resource,
+     * and moving from a buffer of another resource copies the elements instead of taking over foreign memory.
+     * */
+    template <class Scalar>
+    class BasicAlignedBuffer {
+        static_assert(std::is_trivially_copyable<Scalar>::value, "NumPP elements must be trivially copyable.");
+
+    private:
+        Scalar* _data;
+        size_t _size;
+        MemoryResource* _resource;
+
+        Scalar* allocate(size_t size);
+        void deallocate();
+
+    public:
+        static const size_t alignment = 64;
+
+        BasicAlignedBuffer();
+        explicit BasicAlignedBuffer(size_t size, MemoryResource* resource = get_default_resource());
+
+        /*
+         * Take ownership of `size` elements at `data` that were obtained from `resource`,
+         * which gets them back through `deallocate` when the buffer is destroyed.
+         * */
+        BasicAlignedBuffer(Scalar* data, size_t size, MemoryResource* resource);
+        BasicAlignedBuffer(const BasicAlignedBuffer& other);
+        BasicAlignedBuffer(BasicAlignedBuffer&& other) noexcept;
+        BasicAlignedBuffer& operator=(const BasicAlignedBuffer& other);
+        // Not noexcept: elements from another resource are copied into this buffer's resource.
+        BasicAlignedBuffer& operator=(BasicAlignedBuffer&& other);
+
+        void swap(BasicAlignedBuffer& other) noexcept;
+
+        Scalar* data();
+        const Scalar* data() const;
+        size_t size() const;
+        MemoryResource* resource() const;
+
+        ~BasicAlignedBuffer();
+    };
+
+    typedef BasicAlignedBuffer<double> AlignedBuffer;
+
+    template <class Scalar>
+    class BasicMatrix;
+
+    template <class Scalar>
+    class BasicMatrixSection;
+
+    /*
+     * `Matrix` is the double precision matrix; other element types are spelled e.g. `BasicMatrix<float>`.
+     * */
+    typedef BasicMatrix<double> Matrix;
+    typedef BasicMatrixSection<double> MatrixSection;
+
+    template <class E>
+    class MatrixExpression;
+
+    template <class Scalar>
+    class MatrixReference;
+
+    template <class Scalar>
+    class MatrixValue;
+
+    template <class Scalar>
+    class BasicMaskedView;
+
+    /*
+     * Boolean matrix packed 64 elements per word: element (r, c) is bit i % 64 of word i / 64, with i = r * cols + c.
+     * Comparisons of matrices (`a > 0`, `a == b`, ...) produce masks; `where` selects between two operands with one,
+     * and `matrix[mask]` reads or assigns the selected elements.
+     * Bits past the last element are always zero.
+     * */
+    class Mask {
+    private:
+        BasicAlignedBuffer<uint64_t> _words;
+        size_t _rows;
+        size_t _cols;
+
+        void clearPadding();
+
+    public:
+        Mask();
+
+        /*
+         * `value` has no default so that `matrix[{i, j}]` still means a slice.
+         * */
+        Mask(size_t rows, size_t cols, bool value);
+
+        std::vector<size_t> shape() const;
+
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        bool at(size_t x, size_t y) const;
+
+        void set(size_t x, size_t y, bool value);
+
+        /*
+         * Number of true elements.
+         * */
+        size_t count() const;
+
+        bool any() const;
+
+        bool all() const;
+
+        /*
+         * 1 for true elements and 0 for false ones.
+         * */
+        template <class U>
+        BasicMatrix<U> astype() const;
+
+        uint64_t* dataHolder();
+
+        const uint64_t* dataHolder() const;
+
+        size_t wordCount() const;
+
+        Mask operator~() const;
+
+        Mask& operator&=(const Mask& other);
+
+        Mask& operator|=(const Mask& other);
+
+        Mask& operator^=(const Mask& other);
+    };
+
+    Mask operator&(const Mask& mask1, const Mask& mask2);
+
+    Mask operator|(const Mask& mask1, const Mask& mask2);
+
+    Mask operator^(const Mask& mask1, const Mask& mask2);
+
+    /*
+     * A dense matrix whose elements are of type `Scalar`: a floating-point, integer or std::complex type.
+     * Arithmetic never mixes element types; convert a matrix with `astype<U>()` first.
+     * */
+    template <class Scalar>
+    class BasicMatrix {
     protected:
-        Vector2D _matrix;
+        /*
+         * Elements are stored row-major: element (r, c) lives at `_data[r * _stride + c]`.
+         * An owning matrix points `_data` at its own `_buffer`; a view (MatrixSection) leaves `_buffer` empty
+         * and points `_data` into the storage of its parent matrix.
+         * */
+        BasicAlignedBuffer<Scalar> _buffer;
+        Scalar* _data;
+
+        size_t _rows;
+        size_t _cols;
+
+        /*
+         * Distance (in elements) between the starts of two adjacent rows.
+         * */
+        size_t _stride;
+
+        friend class BasicMatrixSection<Scalar>;
+        friend class MatrixReference<Scalar>;
+        friend class MatrixValue<Scalar>;
+
+        /*
+         * Run an element-wise kernel over `x` and `y` (a matrix or a scalar), writing into `out` of the same shape.
+         * Operands whose rows are adjacent in memory are handed to the kernel as a single span.
+         * */
+        template <class Kernel>
+        static void apply_kernel(Kernel kernel, const BasicMatrix& x, const BasicMatrix& y, BasicMatrix& out);
+
+        template <class Kernel>
+        static void apply_kernel(Kernel kernel, const BasicMatrix& x, Scalar y, BasicMatrix& out);
+
+        /*
+         * Apply `Op` between this matrix and `operand` in place; the operand may broadcast to this matrix's shape.
+         * */
+        template <class Op, class E>
+        BasicMatrix& updateWith(const E& operand);
+
+        /*
+         * Non-owning view of `rows` by `cols` elements starting at `data`, with rows `stride` elements apart.
+         * */
+        BasicMatrix(Scalar* data, size_t rows, size_t cols, size_t stride);
+
+        bool ownsData() const;
+
+        /*
+         * Whether `other` shares storage with this matrix without being laid out exactly on top of it,
+         * in which case element-wise updates reading `other` must go through a temporary copy.
+         * */
+        bool overlaps(const BasicMatrix& other) const;
 
     public:
+        typedef Scalar value_type;
+
         // General Constructor
-        explicit Matrix(Vector2D vector2d);
+        explicit BasicMatrix(const BasicVector2D<Scalar>& vector2d);
 
-        Matrix(std::initializer_list<std::vector<double>> initList);
+        BasicMatrix(std::initializer_list<std::vector<Scalar>> initList);
 
-        Matrix(MatrixSection matrixSection);
+        /*
+         * Copy the elements selected by a section into a new, owning matrix.
+         * */
+        BasicMatrix(const BasicMatrixSection<Scalar>& matrixSection);
 
         // Fill Constructor
-        Matrix(size_t m, size_t n, double number);
-
-        // Copy Constructor
-        Matrix(const Matrix& other);
-
-        // Move Constructor
-        Matrix(Matrix&& other) noexcept;
+        BasicMatrix(size_t m, size_t n, Scalar number = Scalar());
 
-         /*
-         * Element-wise product
+        /*
+         * Adopt `buffer` (holding at least m * n elements, possibly uninitialized) as the storage of an m by n matrix.
          * */
-        Matrix operator*(const Matrix& other) const;
+        BasicMatrix(size_t m, size_t n, BasicAlignedBuffer<Scalar> buffer);
 
-        Matrix operator*(double other) const;
+        // Copy Constructor
+        BasicMatrix(const BasicMatrix& other);
 
-        Matrix operator+(const Matrix& other) const;
+        // Move Constructor. Not noexcept: moving from a view (a section) copies its elements.
+        BasicMatrix(BasicMatrix&& other);
 
-        Matrix operator+(double other) const;
+        /*
+         * Map a .npy file (as written by `numpp::save` or NumPy) and use it as the storage of the matrix
+         * without reading or copying it: the OS loads pages on first access and shares them between processes.
+         * Writes only change this process's copy of a page (copy-on-write), never the file.
+         * The file is unmapped when the matrix is destroyed.
+         *
+         * The file must hold elements of exactly this Scalar type in C (row-major) order; anything else,
+         * including Fortran order, throws IOException (use `numpp::load` to convert).
+         * Files whose elements are not aligned for Scalar, and all files on platforms without mmap, are read into memory instead.
+         * */
+        static BasicMatrix mmap(const std::string& path);
 
-        Matrix operator+() const;
+        /*
+         * Evaluate an element-wise expression (see NumPPExpression.h) in a single pass.
+         * */
+        template <class E>
+        BasicMatrix(const MatrixExpression<E>& expression);
 
-        Matrix operator/(const Matrix& other) const;
+        /*
+         * Binary `+, -, *, /` and unary `-` are free operators building lazy expressions (see NumPPExpression.h).
+         * */
+        BasicMatrix operator+() const;
 
-        Matrix operator/(double other) const;
+        /*
+         * Compound assignments update this matrix in place and allocate nothing.
+         * */
+        BasicMatrix& operator*=(Scalar other);
 
-        Matrix operator-(const Matrix& other) const;
+        BasicMatrix& operator*=(const BasicMatrix& other);
 
-        Matrix operator-(double other) const;
+        BasicMatrix& operator+=(Scalar other);
 
-        Matrix operator-() const;
+        BasicMatrix& operator+=(const BasicMatrix& other);
 
-        Matrix operator*=(double other);
+        BasicMatrix& operator/=(Scalar other);
 
-        Matrix operator*=(const Matrix& other);
+        BasicMatrix& operator/=(const BasicMatrix& other);
 
-        Matrix operator+=(double other);
+        BasicMatrix& operator-=(Scalar other);
 
-        Matrix operator+=(const Matrix& other);
+        BasicMatrix& operator-=(const BasicMatrix& other);
 
-        Matrix operator/=(double other);
+        template <class E>
+        BasicMatrix& operator*=(const MatrixExpression<E>& expression);
 
-        Matrix operator/=(const Matrix& other);
+        template <class E>
+        BasicMatrix& operator+=(const MatrixExpression<E>& expression);
 
-        Matrix operator-=(double other);
+        template <class E>
+        BasicMatrix& operator/=(const MatrixExpression<E>& expression);
 
-        Matrix operator-=(const Matrix& other);
+        template <class E>
+        BasicMatrix& operator-=(const MatrixExpression<E>& expression);
 
         /*
          * Get section of this matrix.
@@ -119,90 +547,202 @@ namespace numpp {
          * Index inversely: You can access the last element with negative indexes.
          * For instance, `mat[-1]` is the last row of the origin matrix; `mat[0][-2]` is the penultimate element of the fist row.
          * */
-        virtual MatrixSection operator[](SignedSlice slice_numpp);
-        virtual MatrixSection operator[](int index_numpp);
+        virtual BasicMatrixSection<Scalar> operator[](SignedSlice slice_numpp);
+        virtual BasicMatrixSection<Scalar> operator[](int index_numpp);
+
+        /*
+         * The elements selected by a mask of the same shape, e.g. `mat[mat < 0] = 0`; see MaskedView.
+         * */
+        BasicMaskedView<Scalar> operator[](Mask mask);
 
-        Matrix& operator=(const Matrix& other);
+        BasicMatrix& operator=(const BasicMatrix& other);
 
-        class Iterator {
-        protected:
-            Vector2D& _vector2d;
+        // Not noexcept: views and matrices from another memory resource are copied.
+        BasicMatrix& operator=(BasicMatrix&& other);
 
-            size_t cur_row;
-            size_t cur_col;
+        template <class E>
+        BasicMatrix& operator=(const MatrixExpression<E>& expression);
 
+        class IteratorBeyondRangeException : std::exception {
+        private:
+            std::string message;
         public:
-            using iterator_category = std::bidirectional_iterator_tag;
-            using value_type = double;
-            using pointer = double*;
-            using reference = double&;
-            using difference_type = std::ptrdiff_t;
+            explicit IteratorBeyondRangeException(std::string msg);
+            const char* what() const noexcept override;
+        };
 
-            class IteratorBeyondRangeException : std::exception {
-            private:
-                std::string message;
-            public:
-                explicit IteratorBeyondRangeException(std::string msg);
-                const char* what() const noexcept override;
-            };
+        /*
+         * Random-access iterator over the elements in row-major order (from top to down, from left to right).
+         *
+         * It walks a pointer along the current row and jumps to the next row at the end of a row,
+         * so it works for owning matrices and sections alike and never allocates.
+         * T is `Scalar` for Iterator and `const Scalar` for ConstIterator.
+         *
+         * Moving beyond the range is only checked (throwing IteratorBeyondRangeException)
+         * when NUMPP_DEBUG is defined.
+         * */
+        template <class T>
+        class BasicIterator {
+        private:
+            template <class U>
+            friend class BasicIterator;
 
-            Iterator(Vector2D& vector2d, size_t row, size_t col);
-            Iterator(const Iterator& iterator);
-            reference operator*();
+            /*
+             * The current element and the end of its row; `_row` is only needed for random access.
+             * */
+            T* _ptr;
+            T* _row_end;
+            size_t _row;
+            size_t _rows;
+            size_t _cols;
+            size_t _stride;
+
+            void check(size_t linear_index) const;
 
-            Iterator& operator++();
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = Scalar;
+            using pointer = T*;
+            using reference = T&;
+            using difference_type = std::ptrdiff_t;
 
-            Iterator operator++(int);
+            typedef typename BasicMatrix::IteratorBeyondRangeException IteratorBeyondRangeException;
 
-            bool operator==(const Iterator& other) const;
+            BasicIterator();
+            BasicIterator(T* data, size_t rows, size_t cols, size_t stride, size_t row, size_t col);
 
-            bool operator!=(const Iterator& other) const;
+            /*
+             * An Iterator converts to a ConstIterator.
+             * */
+            template <class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+            BasicIterator(const BasicIterator<U>& other);
 
-            Iterator& operator--();
+            reference operator*() const;
+            pointer operator->() const;
+            reference operator[](difference_type n) const;
 
-            Iterator operator--(int);
-            pointer operator->();
+            BasicIterator& operator++();
+            BasicIterator operator++(int);
+            BasicIterator& operator--();
+            BasicIterator operator--(int);
+
+            BasicIterator& operator+=(difference_type n);
+            BasicIterator& operator-=(difference_type n);
+            BasicIterator operator+(difference_type n) const;
+            BasicIterator operator-(difference_type n) const;
+            difference_type operator-(const BasicIterator& other) const;
+
+            /*
+             * Position of the element in row-major order.
+             * */
+            size_t index() const;
+
+            bool operator==(const BasicIterator& other) const;
+            bool operator!=(const BasicIterator& other) const;
+            bool operator<(const BasicIterator& other) const;
+            bool operator>(const BasicIterator& other) const;
+            bool operator<=(const BasicIterator& other) const;
+            bool operator>=(const BasicIterator& other) const;
+
+            friend BasicIterator operator+(difference_type n, const BasicIterator& iterator) {
+                return iterator + n;
+            }
         };
 
+        typedef BasicIterator<Scalar> Iterator;
+        typedef BasicIterator<const Scalar> ConstIterator;
+        typedef Iterator iterator;
+        typedef ConstIterator const_iterator;
+
         Iterator begin();
         Iterator end();
+        ConstIterator begin() const;
+        ConstIterator end() const;
+        ConstIterator cbegin() const;
+        ConstIterator cend() const;
 
+        /*
+         * {rows, cols} as a new vector. Prefer rowCount() and colCount() in loops, which allocate nothing.
+         * */
         std::vector<size_t> shape() const;
 
-        double at(size_t x, size_t y) const;
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        Scalar at(size_t x, size_t y) const;
 
-        Matrix row(int row_index) const;
+        BasicMatrix row(int row_index) const;
 
-        Matrix column(int col_index) const;
+        BasicMatrix column(int col_index) const;
 
-        std::vector<Matrix> rows() const;
+        std::vector<BasicMatrix> rows() const;
 
-        std::vector<Matrix> columns() const;
+        std::vector<BasicMatrix> columns() const;
 
         /*
          * Transpose form of this matrix
          * */
-        Matrix T() const;
+        BasicMatrix T() const;
 
-        Vector2D toVector2D() const;
+        /*
+         * Transpose this matrix without allocating when it is square; other shapes get a new buffer.
+         * A non-square matrix section cannot change its shape, so it throws IllegalArithmeticsException.
+         * */
+        BasicMatrix& transposeInPlace();
 
-        Vector2D* dataHolder();
+        /*
+         * Copy of this matrix with every element converted to U (by static_cast), e.g. `counts.astype<double>()`.
+         * */
+        template <class U>
+        BasicMatrix<U> astype() const;
+
+        /*
+         * Copy elements into a newly created `Vector2D`.
+         * */
+        BasicVector2D<Scalar> toVector2D() const;
+
+        /*
+         * Pointer to the first element of the row-major element buffer.
+         * Row r starts at `dataHolder() + r * stride()`.
+         * */
+        Scalar* dataHolder();
+        const Scalar* dataHolder() const;
+
+        /*
+         * Distance (in elements) between the starts of two adjacent rows.
+         * Equal to `shape()[1]` for owning matrices, and to the parent's row length for sections.
+         * */
+        size_t stride() const;
 
         /*
          * Quick way to get number from a 1 by 1 matrix
          * */
-        double num() const;
+        Scalar num() const;
 
-        virtual ~Matrix();
+        virtual ~BasicMatrix();
     };
 
-    class MatrixSection : public Matrix {
+    /*
+     * A non-owning view of a rectangular block of a parent matrix: it points into the parent's storage
+     * and shares its row stride, so slicing never copies elements.
+     * Reading or writing through a section reads or writes the parent matrix;
+     * converting a section to a `Matrix` copies the selected elements into new storage.
+     * A section is only valid while its parent matrix is alive and not reallocated.
+     * */
+    template <class Scalar>
+    class BasicMatrixSection : public BasicMatrix<Scalar> {
     private:
+        using BasicMatrix<Scalar>::_data;
+        using BasicMatrix<Scalar>::_rows;
+        using BasicMatrix<Scalar>::_cols;
+        using BasicMatrix<Scalar>::_stride;
+
         /*
          * operator[] will store the address of the operand matrix (parent matrix),
          * so statements like `mat[i][j] = num` can directly modify the parent matrix;
          * */
-        Matrix *_parentMatrix;
+        BasicMatrix<Scalar> *_parentMatrix;
 
         /*
          * Index combination selecting elements from the parent matrix.
@@ -212,127 +752,456 @@ namespace numpp {
          * */
         Section _indexesOfParentMatrix;
     public:
-        explicit MatrixSection(Vector2D vector2D);
-        MatrixSection(Vector2D vector2D, Matrix *parentMatrix, Section indexesOfParentMatrix);
+        /*
+         * A view of the whole matrix.
+         * */
+        explicit BasicMatrixSection(BasicMatrix<Scalar>& matrix);
+        BasicMatrixSection(BasicMatrix<Scalar> *parentMatrix, Section indexesOfParentMatrix);
+
+        /*
+         * Copying a section yields another view of the same elements.
+         * */
+        BasicMatrixSection(const BasicMatrixSection& other);
 
-        MatrixSection operator[](SignedSlice slice_numpp) override;
+        BasicMatrixSection operator[](SignedSlice slice_numpp) override;
 
-        MatrixSection operator[](int index_numpp) override;
+        BasicMatrixSection operator[](int index_numpp) override;
 
-        Matrix& operator=(double other);
+        using BasicMatrix<Scalar>::operator[];
 
-        Matrix& operator=(const Matrix& other);
+        BasicMatrix<Scalar>& operator=(Scalar other);
 
         /*
-         * Different from Matrix::Iterator,
-         * MatrixSection::Iterator can iterate only sliced elements which point to the origin matrix (parent matrix).
+         * Assignments write the elements of the right-hand side (in row-major order) into the parent matrix.
+         * */
+        BasicMatrix<Scalar>& operator=(const BasicMatrix<Scalar>& other);
+
+        BasicMatrixSection& operator=(const BasicMatrixSection& other);
+
+        /*
+         * Evaluate the expression directly into the selected elements of the parent matrix.
+         * */
+        template <class E>
+        BasicMatrix<Scalar>& operator=(const MatrixExpression<E>& expression);
+
+        /*
+         * Since a section is a view, it is iterated with Matrix::Iterator,
+         * which only visits the sliced elements of the origin matrix (parent matrix).
          *
          * For instance,
          *
          * Matrix mat1{{ 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 }};
-         * Matrix mat2 = mat1[{ 0, 2 }][{ 0, 2 }]
-         * for (double elem : mat2) {
+         * for (double elem : mat1[{ 0, 2 }][{ 0, 2 }]) {
          *      std::cout << elem << std::endl;
          * }
          *
          * Output:
          * 1, 2, 4, 5
          * */
-        class Iterator : public Matrix::Iterator {
-        private:
-            /*
-             * For a slice of a matrix (the section of a matrix), its iterator should only iterate elements in this section.
-             * */
-            Section _section;
+        typedef typename BasicMatrix<Scalar>::Iterator Iterator;
 
-        public:
-            Iterator(Vector2D& vector2d, size_t row, size_t col, Section sect);
-            Iterator(const Iterator& iterator);
-            Iterator& operator++();
-            Iterator operator++(int);
-            Iterator& operator--();
-            Iterator operator--(int);
-        };
+        ~BasicMatrixSection() override;
+    };
 
-        Iterator begin();
-        Iterator end();
+    /*
+     * A lazy transpose of a matrix: it reads the referenced matrix with rows and columns swapped and copies nothing.
+     * `multiply` accepts it directly, e.g. `numpp::multiply(numpp::transpose_view(A), A)` forms A^T A
+     * without materializing A^T. The view is only valid while the referenced matrix is alive.
+     * */
+    template <class Scalar>
+    class BasicTransposedView {
+    private:
+        const BasicMatrix<Scalar>* _matrix;
+
+    public:
+        explicit BasicTransposedView(const BasicMatrix<Scalar>& matrix);
+
+        /*
+         * The matrix being viewed (not transposed).
+         * */
+        const BasicMatrix<Scalar>& base() const;
+
+        std::vector<size_t> shape() const;
+
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        Scalar at(size_t x, size_t y) const;
+
+        /*
+         * Materialize the transpose.
+         * */
+        BasicMatrix<Scalar> eval() const;
+    };
+
+    typedef BasicTransposedView<double> TransposedView;
+
+    /*
+     * The elements of a matrix (or section) selected by a mask, as returned by `matrix[mask]`.
+     * Assigning a scalar, a matrix or an expression of the matrix's shape writes only the selected elements,
+     * taking each value from the same position of the right-hand side, so `mat[mat > 1] = 1` clips
+     * and `mat[mask] = other` copies the selected elements of `other`.
+     * The view keeps its own copy of the mask and is only valid while the matrix is alive.
+     * */
+    template <class Scalar>
+    class BasicMaskedView {
+    private:
+        BasicMatrix<Scalar>* _matrix;
+        Mask _mask;
+
+    public:
+        BasicMaskedView(BasicMatrix<Scalar>* matrix, Mask mask);
+
+        const Mask& mask() const;
+
+        size_t count() const;
+
+        BasicMaskedView& operator=(Scalar value);
 
-        ~MatrixSection() override;
+        BasicMaskedView& operator=(const BasicMatrix<Scalar>& values);
+
+        template <class E>
+        BasicMaskedView& operator=(const MatrixExpression<E>& values);
+
+        /*
+         * The selected elements in row-major order, as a row vector.
+         * */
+        BasicMatrix<Scalar> eval() const;
     };
 
+    typedef BasicMaskedView<double> MaskedView;
+
+    /*
+     * LU factorization with partial pivoting of a square matrix A: P * A = L * U,
+     * with L unit lower triangular and U upper triangular.
+     * Factor once with `numpp::lu(A)`, then reuse the factorization for the determinant, the inverse
+     * and any number of right-hand sides.
+     * */
+    template <class Scalar>
+    class BasicLUDecomposition {
+        static_assert(is_field<Scalar>::value, "LU decomposition needs a floating-point or complex element type.");
+
+    private:
+        /*
+         * L and U packed into one matrix: L below the diagonal (its unit diagonal is not stored), U on and above it.
+         * */
+        BasicMatrix<Scalar> _lu;
+
+        /*
+         * Row i of P * A is row _permutation[i] of A.
+         * */
+        std::vector<size_t> _permutation;
+
+        /*
+         * Parity of the permutation, +1 or -1.
+         * */
+        int _sign;
+
+        bool _singular;
+
+    public:
+        explicit BasicLUDecomposition(const BasicMatrix<Scalar>& matrix);
+
+        /*
+         * Factors and permutation as separate matrices.
+         * */
+        BasicMatrix<Scalar> L() const;
+        BasicMatrix<Scalar> U() const;
+        BasicMatrix<Scalar> P() const;
+
+        const BasicMatrix<Scalar>& packed() const;
+        const std::vector<size_t>& permutation() const;
+
+        bool isSingular() const;
+
+        Scalar determinant() const;
+
+        /*
+         * Solve A * X = B for X, where B has as many rows as A and any number of columns.
+         * Throws IllegalArithmeticsException if A is singular.
+         * */
+        BasicMatrix<Scalar> solve(const BasicMatrix<Scalar>& b) const;
+
+        BasicMatrix<Scalar> invert() const;
+    };
+
+    typedef BasicLUDecomposition<double> LUDecomposition;
+
+    /*
+     * The functions below take the element type from their matrix arguments;
+     * the factories create double matrices unless asked otherwise, e.g. `numpp::zeros<float>(m, n)`.
+     * */
+
     /*
      * Create an m by n zero matrix.
      * */
-    Matrix zeros(size_t m, size_t n);
+    template <class Scalar = double>
+    BasicMatrix<Scalar> zeros(size_t m, size_t n);
 
     /*
      * Create an n by m one matrix.
      * */
-    Matrix ones(size_t m, size_t n);
+    template <class Scalar = double>
+    BasicMatrix<Scalar> ones(size_t m, size_t n);
 
     /*
      * Create an identity matrix with m by m.
      * */
-    Matrix identity(size_t m);
+    template <class Scalar = double>
+    BasicMatrix<Scalar> identity(size_t m);
 
     /*
-     * Create a random matrix with n by m size in range [min, max].
+     * Create a random matrix with n by m size, filled with integers in range [min, max].
      * */
-    Matrix random(size_t m, size_t n, int min, int max);
+    template <class Scalar = double>
+    BasicMatrix<Scalar> random(size_t m, size_t n, int min, int max);
 
     /*
-     * Print matrix in a beautiful way on the console.
+     * How `format`, `write` and `operator<<` turn a matrix into text.
      * */
-    void show(const Matrix &matrix);
+    struct PrintOptions {
+        /*
+         * Significant digits of floating-point elements, as with std::defaultfloat and the stream precision.
+         * */
+        int precision;
+
+        /*
+         * Matrices with more elements than `threshold` are summarized like NumPy does:
+         * only the first and last `edge_items` rows and columns are written, with `...` in between.
+         * */
+        size_t threshold;
+        size_t edge_items;
+
+        PrintOptions(int precision = 6, size_t threshold = 1000, size_t edge_items = 3);
+    };
+
+    /*
+     * Append the text of a matrix to `os` with a single write, without flushing:
+     *
+     * Matrix([
+     *     [1, 2, 3]
+     *     [4, 5, 6]
+     * ])
+     *
+     * (rows are indented with a tab). Sections and expressions are accepted as well.
+     * */
+    template <class Scalar>
+    void write(std::ostream& os, const BasicMatrix<Scalar>& matrix, const PrintOptions& options = PrintOptions());
+
+    template <class Scalar>
+    std::string format(const BasicMatrix<Scalar>& matrix, const PrintOptions& options = PrintOptions());
+
+    template <class Scalar>
+    std::string to_string(const BasicMatrix<Scalar>& matrix);
+
+    template <class E>
+    void write(std::ostream& os, const MatrixExpression<E>& expression, const PrintOptions& options = PrintOptions());
+
+    template <class E>
+    std::string format(const MatrixExpression<E>& expression, const PrintOptions& options = PrintOptions());
+
+    template <class E>
+    std::string to_string(const MatrixExpression<E>& expression);
+
+    /*
+     * Write with the stream's precision, e.g. `std::cout << std::setprecision(3) << mat`.
+     * */
+    template <class Scalar>
+    std::ostream& operator<<(std::ostream& os, const BasicMatrix<Scalar>& matrix);
+
+    template <class E>
+    std::ostream& operator<<(std::ostream& os, const MatrixExpression<E>& expression);
+
+    /*
+     * Print matrix in a beautiful way on the console. Every element is printed, however large the matrix is.
+     * The text is built in memory first and written to std::cout at once, followed by a single flush.
+     * */
+    template <class Scalar>
+    void show(const BasicMatrix<Scalar>& matrix);
+
+    template <class E>
+    void show(const MatrixExpression<E>& expression);
 
     /*
      * Create a matrix of multiplying a matrix into a constant scalar.
      * */
-    Matrix multiply(const Matrix& matrix, double c);
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix, typename NonDeduced<Scalar>::type c);
 
     /*
      * Create dot-product matrix of two matrices.
      * */
-    Matrix multiply(const Matrix& matrix1, const Matrix& matrix2);
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2);
+
+    /*
+     * Products with transposed operands; the GEMM reads the viewed matrices in place.
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicTransposedView<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2);
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix1, const BasicTransposedView<Scalar>& matrix2);
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicTransposedView<Scalar>& matrix1, const BasicTransposedView<Scalar>& matrix2);
 
     /*
      * Create a matrix adding a constant number `c` into every element of `matrix`.
      * */
-    Matrix sum(const Matrix& matrix, double c);
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix, typename NonDeduced<Scalar>::type c);
 
     /*
      * Create the sum matrix of two matrices.
      * */
-    Matrix sum(const Matrix& matrix1, const Matrix& matrix2);
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2);
+
+    /*
+     * The axis a reduction runs along, as in NumPy:
+     * AXIS_0 reduces every column over all rows into a 1 by n matrix,
+     * AXIS_1 reduces every row over all columns into an m by 1 matrix.
+     * It is a type of its own so that `sum(matrix, AXIS_0)` never means `sum(matrix, c)`, which adds `c` to every element.
+     * */
+    enum Axis {
+        AXIS_0 = 0,
+        AXIS_1 = 1
+    };
+
+    /*
+     * Matrix norms: Frobenius (square root of the sum of |x|^2), largest absolute column sum and largest absolute row sum.
+     * */
+    enum NormOrder {
+        NORM_FRO,
+        NORM_1,
+        NORM_INF
+    };
+
+    /*
+     * Sum of all elements, and the sums along an axis.
+     * Large inputs are reduced in parallel; floating-point sums are pairwise and give the same result on any number of threads.
+     * */
+    template <class Scalar>
+    Scalar sum(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix, Axis axis);
+
+    /*
+     * Arithmetic mean of all elements and along an axis; integer matrices are averaged in double.
+     * */
+    template <class Scalar>
+    typename Promoted<Scalar>::type mean(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<typename Promoted<Scalar>::type> mean(const BasicMatrix<Scalar>& matrix, Axis axis);
+
+    /*
+     * Variance, the sum of |x - mean|^2 divided by (count - ddof); ddof = 1 gives the unbiased sample variance.
+     * Computed in two passes, so it stays accurate when the mean is large compared to the spread.
+     * */
+    template <class Scalar>
+    typename Magnitude<Scalar>::type var(const BasicMatrix<Scalar>& matrix, size_t ddof = 0);
+    template <class Scalar>
+    BasicMatrix<typename Magnitude<Scalar>::type> var(const BasicMatrix<Scalar>& matrix, Axis axis, size_t ddof = 0);
+
+    /*
+     * Smallest and largest element, and the extremes along an axis. Empty matrices (or axes) throw.
+     * Real element types only; the result is unspecified when the matrix contains NaN.
+     * */
+    template <class Scalar>
+    Scalar min(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> min(const BasicMatrix<Scalar>& matrix, Axis axis);
+    template <class Scalar>
+    Scalar max(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> max(const BasicMatrix<Scalar>& matrix, Axis axis);
+
+    /*
+     * Position of the first smallest or largest element: a row-major flat index (row * colCount() + column)
+     * for the whole matrix, and the row (AXIS_0) or column (AXIS_1) index along an axis.
+     * */
+    template <class Scalar>
+    size_t argmin(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<size_t> argmin(const BasicMatrix<Scalar>& matrix, Axis axis);
+    template <class Scalar>
+    size_t argmax(const BasicMatrix<Scalar>& matrix);
+    template <class Scalar>
+    BasicMatrix<size_t> argmax(const BasicMatrix<Scalar>& matrix, Axis axis);
+
+    template <class Scalar>
+    typename Magnitude<Scalar>::type norm(const BasicMatrix<Scalar>& matrix, NormOrder order = NORM_FRO);
+
+    /*
+     * Number of true elements of a mask, or of elements of a matrix that are not zero.
+     * */
+    size_t count_nonzero(const Mask& mask);
+
+    template <class Scalar>
+    size_t count_nonzero(const BasicMatrix<Scalar>& matrix);
+
+    /*
+     * Sum of the products of corresponding elements (without conjugation) of two matrices of the same shape,
+     * or of a row and a column vector of the same length.
+     * */
+    template <class Scalar>
+    Scalar dot(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2);
 
     /*
      * Create `matrix`'s transpose.
      * */
-    Matrix transpose(const Matrix& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> transpose(const BasicMatrix<Scalar>& matrix);
+
+    /*
+     * A lazy transpose of `matrix`, see TransposedView.
+     * */
+    template <class Scalar>
+    BasicTransposedView<Scalar> transpose_view(const BasicMatrix<Scalar>& matrix);
 
     /*
      * Create a minor matrix of `matrix` with respect to mth row and nth column (the indices start from 0).
      * */
-    Matrix minor(const Matrix& matrix, size_t m, size_t n);
+    template <class Scalar>
+    BasicMatrix<Scalar> minor(const BasicMatrix<Scalar>& matrix, size_t m, size_t n);
 
     /*
      * Calculate the determinant of `matrix`.
+     * Like everything else built on elimination (invert, lu, solve, adjugate, upper_triangular, rref),
+     * it needs a floating-point or complex element type.
      * */
-    double determinant(const Matrix& matrix);
+    template <class Scalar>
+    Scalar determinant(const BasicMatrix<Scalar>& matrix);
 
     /*
      * Generate `matrix`'s inverse.
      * */
-    Matrix invert(const Matrix& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> invert(const BasicMatrix<Scalar>& matrix);
+
+    /*
+     * Factor a square `matrix` into P * A = L * U (see LUDecomposition).
+     * */
+    template <class Scalar>
+    BasicLUDecomposition<Scalar> lu(const BasicMatrix<Scalar>& matrix);
+
+    /*
+     * Solve the linear system a * x = b, where `b` holds one right-hand side per column.
+     * To solve many systems with the same `a`, factor it once with `lu(a)` and call `solve` on the result.
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> solve(const BasicMatrix<Scalar>& a, const BasicMatrix<Scalar>& b);
 
-    Matrix adjugate(const Matrix& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> adjugate(const BasicMatrix<Scalar>& matrix);
 
     /*
      * Concatenate two matrices into a new matrix along the specified axis (0 or 1).
      * Axis 0: Concatenate two matrices vertically
      * Axis 1: Concatenate two matrices horizontally
      * */
-    Matrix concatenate(const Matrix& matrix1, const Matrix& matrix2, int axis);
+    template <class Scalar>
+    BasicMatrix<Scalar> concatenate(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2, int axis = 0);
 
     /*
      * Following functions implement elementary row operations (ERO)
@@ -340,20 +1209,46 @@ namespace numpp {
      * ero_multiply: Multiplies every element in rth row with constant `c`
      * ero_sum: Adds ero_multiply(r1, c) into r2'th row
      * */
-    Matrix ero_swap(const Matrix& matrix, size_t r1, size_t r2);
-    Matrix ero_multiply(const Matrix& matrix, size_t r, double c);
-    Matrix ero_sum(const Matrix& matrix, size_t r1, double c, size_t r2);
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_swap(const BasicMatrix<Scalar>& matrix, size_t r1, size_t r2);
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_multiply(const BasicMatrix<Scalar>& matrix, size_t r, typename NonDeduced<Scalar>::type c);
+    template <class Scalar>
+    BasicMatrix<Scalar> ero_sum(const BasicMatrix<Scalar>& matrix, size_t r1, typename NonDeduced<Scalar>::type c, size_t r2);
+
+    /*
+     * The same elementary row operations, applied to `matrix` itself instead of a copy.
+     * */
+    template <class Scalar>
+    void ero_swap_inplace(BasicMatrix<Scalar>& matrix, size_t r1, size_t r2);
+    template <class Scalar>
+    void ero_multiply_inplace(BasicMatrix<Scalar>& matrix, size_t r, typename NonDeduced<Scalar>::type c);
+    template <class Scalar>
+    void ero_sum_inplace(BasicMatrix<Scalar>& matrix, size_t r1, typename NonDeduced<Scalar>::type c, size_t r2);
+
+    /*
+     * Calculate upper triangular form (row echelon form, REF) of the given matrix,
+     * by Gaussian elimination with partial pivoting
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> upper_triangular(const BasicMatrix<Scalar>& matrix);
 
     /*
-     * Calculate upper triangular form (row echelon form, REF) of the given matrix
+     * Calculate RREF form (reduced row echelon form, RREF) of the given matrix, by Gauss-Jordan elimination
      * */
-    Matrix upper_triangular(const Matrix& matrix);
+    template <class Scalar>
+    BasicMatrix<Scalar> rref(const BasicMatrix<Scalar>& matrix);
 
     /*
-     * Calculate RREF form (reduced row echelon form, RREF) of the given matrix
+     * Set the number of threads used by the heavy kernels (multiply, element-wise operators, T(), upper_triangular),
+     * counting the calling thread. 0 restores the default: the NUMPP_NUM_THREADS environment variable if set,
+     * otherwise the number of hardware threads. Small inputs always run on the calling thread.
+     * Must not be called while another thread is computing with NumPP.
      * */
-    Matrix rref(const Matrix& matrix);
+    void set_num_threads(size_t num_threads);
+
+    size_t get_num_threads();
 
 }
 
-#endif //NUMPP_H
\ No newline at end of file
+#endif //NUMPP_H
@@ -0,0 +1,810 @@
+#ifndef NUMPP_EXPRESSION_H
+#define NUMPP_EXPRESSION_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPStats.h"
+#include <type_traits>
+#include <utility>
+
+namespace numpp {
+    /*
+     * Expression templates for element-wise arithmetic.
+     *
+     * `a + b`, `a * 2.0`, `-a` and so on do not compute anything: they build a small expression object
+     * that describes the computation. The expression is evaluated in a single pass over the elements
+     * when it is assigned to (or used to construct) a Matrix or a MatrixSection, so `(a + b) * c / 2.0`
+     * creates no intermediate matrices.
+     *
+     * Matrices used as lvalues and matrix sections are referenced by the expression, other temporaries are
+     * moved into it, so an expression stays valid as long as the named matrices it mentions are alive.
+     * Call `eval()` to materialize an expression explicitly, e.g. `(a + b).eval().T()`.
+     *
+     * Every node has the element type of its operands as `value_type` (scalars are converted to it)
+     * and provides `at(r, c)` and `row(r)`. The latter returns a small cursor over one row with `at(c)` and,
+     * on x86, packet accessors `sse2(c)`, `avx2(c)` and `avx512(c)` returning consecutive elements starting at column c
+     * (only used for element types with SIMD kernels, see kernels::SimdTraits).
+     * Nodes also report through `overlaps(...)` whether they read memory the assignment target writes at other
+     * positions (e.g. `m[{1, ED}] = m[{0, -1}] * 2.0`); such assignments are evaluated through a temporary.
+     * A broadcast operand is read at positions other than its own, so for it any shared memory counts (`aligned` false).
+     * Cursors are plain values, so the evaluation loops keep all their pointers in registers.
+     *
+     * Operands broadcast as in NumPy: a 1 x n operand is repeated for every row and an m x 1 operand for every column.
+     * Repeating a row only changes which row a cursor starts at, so `row(r)` cursors stay as fast as without broadcasting.
+     * Repeating a column needs cursors that splat one value per row; nodes provide those through `broadcast_row(r)`,
+     * and the evaluation loops only use them when `broadcasts_columns()` says some node needs them.
+     * */
+    template <class E>
+    class MatrixExpression {
+    public:
+        const E& derived() const {
+            return static_cast<const E&>(*this);
+        }
+
+        size_t rows() const {
+            return derived().rows();
+        }
+
+        size_t cols() const {
+            return derived().cols();
+        }
+
+        std::vector<size_t> shape() const {
+            return std::vector<size_t>{rows(), cols()};
+        }
+
+        /*
+         * The default argument only delays naming E::value_type until E is complete.
+         * */
+        template <class D = E>
+        BasicMatrix<typename D::value_type> eval() const {
+            return BasicMatrix<typename D::value_type>{*this};
+        }
+    };
+
+    /*
+     * Row cursor of a matrix leaf.
+     * */
+    template <class Scalar>
+    class MatrixRowCursor {
+    private:
+        typedef kernels::SimdTraits<Scalar> Simd;
+
+        const Scalar* _row;
+
+    public:
+        explicit MatrixRowCursor(const Scalar* row) : _row(row) {}
+
+        Scalar at(size_t c) const { return _row[c]; }
+
+#if NUMPP_X86_SIMD
+        __attribute__((target("sse2"))) typename Simd::sse2_type sse2(size_t c) const { return Simd::sse2_load(_row + c); }
+        __attribute__((target("avx2"))) typename Simd::avx2_type avx2(size_t c) const { return Simd::avx2_load(_row + c); }
+        __attribute__((target("avx512f"))) typename Simd::avx512_type avx512(size_t c) const {
+            return Simd::avx512_load(_row + c);
+        }
+#endif
+    };
+
+    /*
+     * Leaf referring to a matrix owned by someone else.
+     * */
+    template <class Scalar>
+    class MatrixReference {
+    private:
+        const Scalar* _data;
+        size_t _rows;
+        size_t _cols;
+        size_t _stride;
+
+    public:
+        typedef Scalar value_type;
+        static const bool has_shape = true;
+
+        MatrixReference(const BasicMatrix<Scalar>& matrix) :
+                _data(matrix._data), _rows(matrix._rows), _cols(matrix._cols), _stride(matrix._stride) {}
+
+        size_t rows() const { return _rows; }
+        size_t cols() const { return _cols; }
+
+        Scalar at(size_t r, size_t c) const { return _data[r * _stride + c]; }
+
+        typedef MatrixRowCursor<Scalar> RowCursor;
+
+        RowCursor row(size_t r) const { return RowCursor{_data + r * _stride}; }
+
+        typedef RowCursor BroadcastRowCursor;
+
+        BroadcastRowCursor broadcast_row(size_t r) const { return row(r); }
+
+        bool broadcasts_columns() const { return false; }
+
+        bool overlaps(const Scalar* data, size_t rows, size_t cols, size_t stride, bool aligned = true) const {
+            return aligned ? kernels::blocks_overlap(_data, _rows, _cols, _stride, data, rows, cols, stride)
+                           : kernels::blocks_intersect(_data, _rows, _cols, _stride, data, rows, cols, stride);
+        }
+    };
+
+    /*
+     * Leaf owning a temporary matrix that was moved into the expression.
+     * */
+    template <class Scalar>
+    class MatrixValue {
+    private:
+        BasicMatrix<Scalar> _matrix;
+
+    public:
+        typedef Scalar value_type;
+        static const bool has_shape = true;
+
+        MatrixValue(BasicMatrix<Scalar>&& matrix) : _matrix(std::move(matrix)) {}
+
+        size_t rows() const { return _matrix._rows; }
+        size_t cols() const { return _matrix._cols; }
+
+        Scalar at(size_t r, size_t c) const { return _matrix._data[r * _matrix._stride + c]; }
+
+        typedef MatrixRowCursor<Scalar> RowCursor;
+
+        RowCursor row(size_t r) const { return RowCursor{_matrix._data + r * _matrix._stride}; }
+
+        typedef RowCursor BroadcastRowCursor;
+
+        BroadcastRowCursor broadcast_row(size_t r) const { return row(r); }
+
+        bool broadcasts_columns() const { return false; }
+
+        bool overlaps(const Scalar*, size_t, size_t, size_t, bool = true) const { return false; }
+    };
+
+    /*
+     * Leaf standing for a scalar broadcast to every element, converted to the element type of the matrices.
+     * */
+    template <class Scalar>
+    class ScalarOperand {
+    private:
+        Scalar _value;
+
+    public:
+        typedef Scalar value_type;
+        static const bool has_shape = false;
+
+        template <class U>
+        ScalarOperand(const U& value) : _value(static_cast<Scalar>(value)) {}
+
+        size_t rows() const { return 0; }
+        size_t cols() const { return 0; }
+
+        Scalar at(size_t, size_t) const { return _value; }
+
+        class RowCursor {
+        private:
+            typedef kernels::SimdTraits<Scalar> Simd;
+
+            Scalar _value;
+
+        public:
+            explicit RowCursor(Scalar value) : _value(value) {}
+
+            Scalar at(size_t) const { return _value; }
+
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) typename Simd::sse2_type sse2(size_t) const { return Simd::sse2_set1(_value); }
+            __attribute__((target("avx2"))) typename Simd::avx2_type avx2(size_t) const { return Simd::avx2_set1(_value); }
+            __attribute__((target("avx512f"))) typename Simd::avx512_type avx512(size_t) const {
+                return Simd::avx512_set1(_value);
+            }
+#endif
+        };
+
+        RowCursor row(size_t) const { return RowCursor{_value}; }
+
+        typedef RowCursor BroadcastRowCursor;
+
+        BroadcastRowCursor broadcast_row(size_t r) const { return row(r); }
+
+        bool broadcasts_columns() const { return false; }
+
+        bool overlaps(const Scalar*, size_t, size_t, size_t, bool = true) const { return false; }
+    };
+
+    /*
+     * Extent of a dimension of an element-wise result: equal extents, or the other one where one side is 1.
+     * */
+    size_t broadcast_extent(size_t extent1, size_t extent2) {
+        if (extent1 == extent2 || extent2 == 1) {
+            return extent1;
+        }
+        if (extent1 == 1) {
+            return extent2;
+        }
+        throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same "
+                                          "or one of them must be 1 along every dimension where they differ."};
+    }
+
+    template <class Op, class L, class R>
+    class BinaryExpression : public MatrixExpression<BinaryExpression<Op, L, R>> {
+        static_assert(std::is_same<typename L::value_type, typename R::value_type>::value,
+                      "Element-wise operations need matrices of the same element type; convert one with astype<U>().");
+
+    private:
+        typedef kernels::SimdTraits<typename L::value_type> Simd;
+
+        L _lhs;
+        R _rhs;
+
+        size_t _rows;
+        size_t _cols;
+
+        /*
+         * Row r of the result reads row r * step of an operand: the step is 0 for an operand with a single row
+         * that is repeated for every row, otherwise 1.
+         * */
+        size_t _lhs_row_step;
+        size_t _rhs_row_step;
+
+        /*
+         * Whether an operand has a single column that is repeated for every column.
+         * */
+        bool _lhs_splat;
+        bool _rhs_splat;
+
+    public:
+        typedef typename L::value_type value_type;
+        static const bool has_shape = true;
+
+        BinaryExpression(L lhs, R rhs) : _lhs(std::move(lhs)), _rhs(std::move(rhs)) {
+            if (L::has_shape && R::has_shape) {
+                _rows = broadcast_extent(_lhs.rows(), _rhs.rows());
+                _cols = broadcast_extent(_lhs.cols(), _rhs.cols());
+            }
+            else {
+                _rows = L::has_shape ? _lhs.rows() : _rhs.rows();
+                _cols = L::has_shape ? _lhs.cols() : _rhs.cols();
+            }
+            _lhs_row_step = L::has_shape && _lhs.rows() != _rows ? 0 : 1;
+            _rhs_row_step = R::has_shape && _rhs.rows() != _rows ? 0 : 1;
+            _lhs_splat = L::has_shape && _lhs.cols() != _cols;
+            _rhs_splat = R::has_shape && _rhs.cols() != _cols;
+        }
+
+        size_t rows() const { return _rows; }
+        size_t cols() const { return _cols; }
+
+        value_type at(size_t r, size_t c) const {
+            return Op::scalar(_lhs.at(r * _lhs_row_step, _lhs_splat ? 0 : c), _rhs.at(r * _rhs_row_step, _rhs_splat ? 0 : c));
+        }
+
+        class RowCursor {
+        private:
+            typename L::RowCursor _lhs;
+            typename R::RowCursor _rhs;
+
+        public:
+            RowCursor(typename L::RowCursor lhs, typename R::RowCursor rhs) : _lhs(lhs), _rhs(rhs) {}
+
+            value_type at(size_t c) const { return Op::scalar(_lhs.at(c), _rhs.at(c)); }
+
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) typename Simd::sse2_type sse2(size_t c) const {
+                return Op::sse2(_lhs.sse2(c), _rhs.sse2(c));
+            }
+            __attribute__((target("avx2"))) typename Simd::avx2_type avx2(size_t c) const {
+                return Op::avx2(_lhs.avx2(c), _rhs.avx2(c));
+            }
+            __attribute__((target("avx512f"))) typename Simd::avx512_type avx512(size_t c) const {
+                return Op::avx512(_lhs.avx512(c), _rhs.avx512(c));
+            }
+#endif
+        };
+
+        /*
+         * Only valid when broadcasts_columns() is false.
+         * */
+        RowCursor row(size_t r) const { return RowCursor{_lhs.row(r * _lhs_row_step), _rhs.row(r * _rhs_row_step)}; }
+
+        /*
+         * Like RowCursor, except that an operand with a single column is read once per row and splatted.
+         * */
+        class BroadcastRowCursor {
+        private:
+            typename L::BroadcastRowCursor _lhs;
+            typename R::BroadcastRowCursor _rhs;
+            value_type _lhs_value;
+            value_type _rhs_value;
+            bool _lhs_splat;
+            bool _rhs_splat;
+
+        public:
+            BroadcastRowCursor(typename L::BroadcastRowCursor lhs, typename R::BroadcastRowCursor rhs,
+                               value_type lhs_value, value_type rhs_value, bool lhs_splat, bool rhs_splat) :
+                    _lhs(lhs), _rhs(rhs), _lhs_value(lhs_value), _rhs_value(rhs_value),
+                    _lhs_splat(lhs_splat), _rhs_splat(rhs_splat) {}
+
+            value_type at(size_t c) const {
+                return Op::scalar(_lhs_splat ? _lhs_value : _lhs.at(c), _rhs_splat ? _rhs_value : _rhs.at(c));
+            }
+
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) typename Simd::sse2_type sse2(size_t c) const {
+                return Op::sse2(_lhs_splat ? Simd::sse2_set1(_lhs_value) : _lhs.sse2(c),
+                                _rhs_splat ? Simd::sse2_set1(_rhs_value) : _rhs.sse2(c));
+            }
+            __attribute__((target("avx2"))) typename Simd::avx2_type avx2(size_t c) const {
+                return Op::avx2(_lhs_splat ? Simd::avx2_set1(_lhs_value) : _lhs.avx2(c),
+                                _rhs_splat ? Simd::avx2_set1(_rhs_value) : _rhs.avx2(c));
+            }
+            __attribute__((target("avx512f"))) typename Simd::avx512_type avx512(size_t c) const {
+                return Op::avx512(_lhs_splat ? Simd::avx512_set1(_lhs_value) : _lhs.avx512(c),
+                                  _rhs_splat ? Simd::avx512_set1(_rhs_value) : _rhs.avx512(c));
+            }
+#endif
+        };
+
+        BroadcastRowCursor broadcast_row(size_t r) const {
+            const size_t lhs_row = r * _lhs_row_step;
+            const size_t rhs_row = r * _rhs_row_step;
+            return BroadcastRowCursor{_lhs.broadcast_row(lhs_row), _rhs.broadcast_row(rhs_row),
+                                      _lhs_splat ? _lhs.at(lhs_row, 0) : value_type(),
+                                      _rhs_splat ? _rhs.at(rhs_row, 0) : value_type(),
+                                      _lhs_splat, _rhs_splat};
+        }
+
+        bool broadcasts_columns() const {
+            return _lhs_splat || _rhs_splat || _lhs.broadcasts_columns() || _rhs.broadcasts_columns();
+        }
+
+        bool overlaps(const value_type* data, size_t rows, size_t cols, size_t stride, bool aligned = true) const {
+            return _lhs.overlaps(data, rows, cols, stride, aligned && _lhs_row_step == 1 && !_lhs_splat)
+                   || _rhs.overlaps(data, rows, cols, stride, aligned && _rhs_row_step == 1 && !_rhs_splat);
+        }
+    };
+
+    template <class Op, class E>
+    class UnaryExpression : public MatrixExpression<UnaryExpression<Op, E>> {
+    private:
+        typedef kernels::SimdTraits<typename E::value_type> Simd;
+
+        E _operand;
+
+    public:
+        typedef typename E::value_type value_type;
+        static const bool has_shape = true;
+
+        explicit UnaryExpression(E operand) : _operand(std::move(operand)) {}
+
+        size_t rows() const { return _operand.rows(); }
+        size_t cols() const { return _operand.cols(); }
+
+        value_type at(size_t r, size_t c) const { return Op::scalar(_operand.at(r, c)); }
+
+        template <class C>
+        class Cursor {
+        private:
+            C _operand;
+
+        public:
+            explicit Cursor(C operand) : _operand(operand) {}
+
+            value_type at(size_t c) const { return Op::scalar(_operand.at(c)); }
+
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) typename Simd::sse2_type sse2(size_t c) const {
+                return Op::sse2(_operand.sse2(c));
+            }
+            __attribute__((target("avx2"))) typename Simd::avx2_type avx2(size_t c) const {
+                return Op::avx2(_operand.avx2(c));
+            }
+            __attribute__((target("avx512f"))) typename Simd::avx512_type avx512(size_t c) const {
+                return Op::avx512(_operand.avx512(c));
+            }
+#endif
+        };
+
+        typedef Cursor<typename E::RowCursor> RowCursor;
+        typedef Cursor<typename E::BroadcastRowCursor> BroadcastRowCursor;
+
+        RowCursor row(size_t r) const { return RowCursor{_operand.row(r)}; }
+
+        BroadcastRowCursor broadcast_row(size_t r) const { return BroadcastRowCursor{_operand.broadcast_row(r)}; }
+
+        bool broadcasts_columns() const { return _operand.broadcasts_columns(); }
+
+        bool overlaps(const value_type* data, size_t rows, size_t cols, size_t stride, bool aligned = true) const {
+            return _operand.overlaps(data, rows, cols, stride, aligned);
+        }
+    };
+
+    /*
+     * Whether D is a BasicMatrix of some element type (a section counts as well).
+     * */
+    template <class D>
+    struct IsMatrix {
+    private:
+        template <class Scalar>
+        static std::true_type test(const BasicMatrix<Scalar>*);
+        static std::false_type test(...);
+
+    public:
+        static const bool value = decltype(test(static_cast<D*>(nullptr)))::value;
+    };
+
+    /*
+     * Map an argument type of an arithmetic operator to the node stored in the expression:
+     * lvalue matrices become MatrixReference, matrix temporaries become MatrixValue,
+     * expressions are stored as they are and arithmetic (or complex) values become ScalarOperand.
+     * `value_type` is the element type of a matrix or expression and the type of a scalar;
+     * `node<Scalar>` is the node for an expression whose elements are of type Scalar.
+     * */
+    template <class T,
+              class D = typename std::decay<T>::type,
+              bool IsMatrixType = IsMatrix<D>::value,
+              bool IsExpression = std::is_base_of<MatrixExpression<D>, D>::value,
+              bool IsScalar = std::is_arithmetic<D>::value || is_complex<D>::value>
+    struct OperandTraits {
+        typedef void value_type;
+        static const bool is_operand = false;
+        static const bool is_matrix_like = false;
+    };
+
+    template <class T, class D>
+    struct OperandTraits<T, D, true, false, false> {
+        typedef typename D::value_type value_type;
+
+        template <class Scalar>
+        struct node {
+            typedef typename std::conditional<std::is_lvalue_reference<T>::value
+                                              || std::is_base_of<BasicMatrixSection<value_type>, D>::value,
+                                              MatrixReference<value_type>, MatrixValue<value_type>>::type type;
+        };
+
+        static const bool is_operand = true;
+        static const bool is_matrix_like = true;
+    };
+
+    template <class T, class D>
+    struct OperandTraits<T, D, false, true, false> {
+        typedef typename D::value_type value_type;
+
+        template <class Scalar>
+        struct node {
+            typedef D type;
+        };
+
+        static const bool is_operand = true;
+        static const bool is_matrix_like = true;
+    };
+
+    template <class T, class D>
+    struct OperandTraits<T, D, false, false, true> {
+        typedef D value_type;
+
+        template <class Scalar>
+        struct node {
+            typedef ScalarOperand<Scalar> type;
+        };
+
+        static const bool is_operand = true;
+        static const bool is_matrix_like = false;
+    };
+
+    /*
+     * Result types of the operators; they have no `type` (removing the operator from overload resolution)
+     * unless at least one side is a matrix or an expression, whose element type the other side is converted to.
+     * */
+    template <class Op, class L, class R,
+              bool Valid = OperandTraits<L>::is_operand && OperandTraits<R>::is_operand
+                           && (OperandTraits<L>::is_matrix_like || OperandTraits<R>::is_matrix_like)>
+    struct BinaryResult {};
+
+    template <class Op, class L, class R>
+    struct BinaryResult<Op, L, R, true> {
+        typedef typename std::conditional<OperandTraits<L>::is_matrix_like,
+                                          typename OperandTraits<L>::value_type,
+                                          typename OperandTraits<R>::value_type>::type value_type;
+        typedef BinaryExpression<Op,
+                                 typename OperandTraits<L>::template node<value_type>::type,
+                                 typename OperandTraits<R>::template node<value_type>::type> type;
+    };
+
+    template <class Op, class E, bool Valid = OperandTraits<E>::is_matrix_like>
+    struct UnaryResult {};
+
+    template <class Op, class E>
+    struct UnaryResult<Op, E, true> {
+        typedef UnaryExpression<Op, typename OperandTraits<E>::template node<typename OperandTraits<E>::value_type>::type> type;
+    };
+
+    template <class L, class R>
+    typename BinaryResult<kernels::AddOp, L, R>::type operator+(L&& lhs, R&& rhs) {
+        return typename BinaryResult<kernels::AddOp, L, R>::type(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template <class L, class R>
+    typename BinaryResult<kernels::SubOp, L, R>::type operator-(L&& lhs, R&& rhs) {
+        return typename BinaryResult<kernels::SubOp, L, R>::type(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    /*
+     * Element-wise product
+     * */
+    template <class L, class R>
+    typename BinaryResult<kernels::MulOp, L, R>::type operator*(L&& lhs, R&& rhs) {
+        return typename BinaryResult<kernels::MulOp, L, R>::type(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template <class L, class R>
+    typename BinaryResult<kernels::DivOp, L, R>::type operator/(L&& lhs, R&& rhs) {
+        return typename BinaryResult<kernels::DivOp, L, R>::type(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template <class E>
+    typename UnaryResult<kernels::NegateOp, E>::type operator-(E&& operand) {
+        return typename UnaryResult<kernels::NegateOp, E>::type(std::forward<E>(operand));
+    }
+
+    /*
+     * Picks the cursors the evaluation loops read rows through: the plain ones, or the ones that splat
+     * operands with a single column when `BroadcastColumns` is set.
+     * */
+    template <class E, bool BroadcastColumns>
+    struct RowAccess {
+        typedef typename E::RowCursor cursor_type;
+
+        static cursor_type row(const E& expression, size_t r) { return expression.row(r); }
+    };
+
+    template <class E>
+    struct RowAccess<E, true> {
+        typedef typename E::BroadcastRowCursor cursor_type;
+
+        static cursor_type row(const E& expression, size_t r) { return expression.broadcast_row(r); }
+    };
+
+    /*
+     * Write rows [r_begin, r_end) of `expression` into the row-major buffer `out` with row stride `ld`,
+     * using the widest packets the CPU supports.
+     * */
+    template <class Access, class E>
+    void evaluate_scalar(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end) {
+        const size_t cols = expression.cols();
+        for (size_t r = r_begin; r < r_end; r++) {
+            typename E::value_type* out_row = out + r * ld;
+            const typename Access::cursor_type cursor = Access::row(expression, r);
+            for (size_t c = 0; c < cols; c++) {
+                out_row[c] = cursor.at(c);
+            }
+        }
+    }
+
+#if NUMPP_X86_SIMD
+    template <class Access, class E>
+    __attribute__((target("sse2")))
+    void evaluate_sse2(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end) {
+        typedef kernels::SimdTraits<typename E::value_type> Simd;
+        const size_t cols = expression.cols();
+        for (size_t r = r_begin; r < r_end; r++) {
+            typename E::value_type* out_row = out + r * ld;
+            const typename Access::cursor_type cursor = Access::row(expression, r);
+            size_t c = 0;
+            for (; c + Simd::sse2_width <= cols; c += Simd::sse2_width) {
+                Simd::sse2_store(out_row + c, cursor.sse2(c));
+            }
+            for (; c < cols; c++) {
+                out_row[c] = cursor.at(c);
+            }
+        }
+    }
+
+    template <class Access, class E>
+    __attribute__((target("avx2")))
+    void evaluate_avx2(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end) {
+        typedef kernels::SimdTraits<typename E::value_type> Simd;
+        const size_t cols = expression.cols();
+        for (size_t r = r_begin; r < r_end; r++) {
+            typename E::value_type* out_row = out + r * ld;
+            const typename Access::cursor_type cursor = Access::row(expression, r);
+            size_t c = 0;
+            for (; c + Simd::avx2_width <= cols; c += Simd::avx2_width) {
+                Simd::avx2_store(out_row + c, cursor.avx2(c));
+            }
+            for (; c < cols; c++) {
+                out_row[c] = cursor.at(c);
+            }
+        }
+    }
+
+    template <class Access, class E>
+    __attribute__((target("avx512f")))
+    void evaluate_avx512(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end) {
+        typedef kernels::SimdTraits<typename E::value_type> Simd;
+        const size_t cols = expression.cols();
+        for (size_t r = r_begin; r < r_end; r++) {
+            typename E::value_type* out_row = out + r * ld;
+            const typename Access::cursor_type cursor = Access::row(expression, r);
+            size_t c = 0;
+            for (; c + Simd::avx512_width <= cols; c += Simd::avx512_width) {
+                Simd::avx512_store(out_row + c, cursor.avx512(c));
+            }
+            for (; c < cols; c++) {
+                out_row[c] = cursor.at(c);
+            }
+        }
+    }
+#endif
+
+    /*
+     * The last parameter is kernels::SimdTraits<E::value_type>::vectorized.
+     * */
+    template <class Access, class E>
+    void evaluate_rows(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end,
+                       std::true_type) {
+#if NUMPP_X86_SIMD
+        switch (kernels::simd_level()) {
+            case kernels::SIMD_AVX512:
+                evaluate_avx512<Access>(expression, out, ld, r_begin, r_end);
+                return;
+            case kernels::SIMD_AVX2:
+                evaluate_avx2<Access>(expression, out, ld, r_begin, r_end);
+                return;
+            case kernels::SIMD_SSE2:
+                evaluate_sse2<Access>(expression, out, ld, r_begin, r_end);
+                return;
+            default:
+                break;
+        }
+#endif
+        evaluate_scalar<Access>(expression, out, ld, r_begin, r_end);
+    }
+
+    template <class Access, class E>
+    void evaluate_rows(const E& expression, typename E::value_type* out, size_t ld, size_t r_begin, size_t r_end,
+                       std::false_type) {
+        evaluate_scalar<Access>(expression, out, ld, r_begin, r_end);
+    }
+
+    template <class E, class Scalar>
+    void evaluate(const E& expression, Scalar* out, size_t ld) {
+        static_assert(std::is_same<typename E::value_type, Scalar>::value,
+                      "An expression can only be assigned to a matrix of its own element type; convert with astype<U>().");
+        NUMPP_STATS_PROFILE("evaluate");
+        // Rows are independent, so large expressions are evaluated in blocks of rows on several threads.
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(expression.cols(), 1) + 1;
+        if (expression.broadcasts_columns()) {
+            parallel::parallel_for(0, expression.rows(), grain, [&](size_t r_begin, size_t r_end) {
+                evaluate_rows<RowAccess<E, true>>(expression, out, ld, r_begin, r_end,
+                                                  typename kernels::SimdTraits<Scalar>::vectorized());
+            });
+        }
+        else {
+            parallel::parallel_for(0, expression.rows(), grain, [&](size_t r_begin, size_t r_end) {
+                evaluate_rows<RowAccess<E, false>>(expression, out, ld, r_begin, r_end,
+                                                   typename kernels::SimdTraits<Scalar>::vectorized());
+            });
+        }
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>::BasicMatrix(const MatrixExpression<E>& expression) :
+            BasicMatrix(expression.rows(), expression.cols(), BasicAlignedBuffer<Scalar>(expression.rows() * expression.cols())) {
+        evaluate(expression.derived(), _data, _stride);
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator=(const MatrixExpression<E>& expression) {
+        if (_rows == expression.rows() && _cols == expression.cols()
+            && !expression.derived().overlaps(_data, _rows, _cols, _stride)) {
+            // Every node only reads the element it writes, so evaluating over our own storage is safe.
+            evaluate(expression.derived(), _data, _stride);
+        }
+        else {
+            *this = BasicMatrix{expression};
+        }
+        return *this;
+    }
+
+    template <class Scalar>
+    template <class Op, class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::updateWith(const E& operand) {
+        const BinaryExpression<Op, MatrixReference<Scalar>, E> update(*this, operand);
+        // The operand may broadcast against this matrix, but not the other way round.
+        if (update.rows() != _rows || update.cols() != _cols) {
+            throw IllegalArithmeticsException{"To update a matrix element-wise, the other operand must have its shape "
+                                              "or broadcast to it."};
+        }
+        if (update.overlaps(_data, _rows, _cols, _stride)) {
+            return *this = BasicMatrix{update};
+        }
+        evaluate(update, _data, _stride);
+        return *this;
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator+=(const MatrixExpression<E>& expression) {
+        return updateWith<kernels::AddOp>(expression.derived());
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator-=(const MatrixExpression<E>& expression) {
+        return updateWith<kernels::SubOp>(expression.derived());
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator*=(const MatrixExpression<E>& expression) {
+        return updateWith<kernels::MulOp>(expression.derived());
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMatrix<Scalar>& BasicMatrix<Scalar>::operator/=(const MatrixExpression<E>& expression) {
+        return updateWith<kernels::DivOp>(expression.derived());
+    }
+
+    /*
+     * Whether any of the types is an element-wise expression.
+     * */
+    template <class... Args>
+    struct HasExpression : std::false_type {};
+
+    template <class First, class... Rest>
+    struct HasExpression<First, Rest...> : std::integral_constant<bool,
+            std::is_base_of<MatrixExpression<First>, First>::value || HasExpression<Rest...>::value> {};
+
+    /*
+     * An argument of a free function as the function takes it: expressions are evaluated, everything else is passed on.
+     * */
+    template <class T>
+    typename std::enable_if<!HasExpression<T>::value, const T&>::type evaluated(const T& argument) {
+        return argument;
+    }
+
+    template <class E>
+    BasicMatrix<typename E::value_type> evaluated(const MatrixExpression<E>& expression) {
+        return expression.eval();
+    }
+
+    /*
+     * Free functions accept expressions wherever they accept a matrix, e.g. `numpp::invert(a * 2.0)` or
+     * `numpp::multiply(a + b, c)`: the expressions are evaluated first and the matrix overload is called.
+     * (transpose_view is left out, since a view of the evaluated temporary would dangle.)
+     * */
+#define NUMPP_ACCEPT_EXPRESSIONS(function) \
+    template <class... Args, class = typename std::enable_if<HasExpression<Args...>::value>::type> \
+    auto function(const Args&... args) -> decltype(function(evaluated(args)...)) { \
+        return function(evaluated(args)...); \
+    }
+
+    NUMPP_ACCEPT_EXPRESSIONS(multiply)
+    NUMPP_ACCEPT_EXPRESSIONS(sum)
+    NUMPP_ACCEPT_EXPRESSIONS(mean)
+    NUMPP_ACCEPT_EXPRESSIONS(var)
+    NUMPP_ACCEPT_EXPRESSIONS(min)
+    NUMPP_ACCEPT_EXPRESSIONS(max)
+    NUMPP_ACCEPT_EXPRESSIONS(argmin)
+    NUMPP_ACCEPT_EXPRESSIONS(argmax)
+    NUMPP_ACCEPT_EXPRESSIONS(norm)
+    NUMPP_ACCEPT_EXPRESSIONS(count_nonzero)
+    NUMPP_ACCEPT_EXPRESSIONS(dot)
+    NUMPP_ACCEPT_EXPRESSIONS(transpose)
+    NUMPP_ACCEPT_EXPRESSIONS(minor)
+    NUMPP_ACCEPT_EXPRESSIONS(determinant)
+    NUMPP_ACCEPT_EXPRESSIONS(invert)
+    NUMPP_ACCEPT_EXPRESSIONS(lu)
+    NUMPP_ACCEPT_EXPRESSIONS(solve)
+    NUMPP_ACCEPT_EXPRESSIONS(adjugate)
+    NUMPP_ACCEPT_EXPRESSIONS(concatenate)
+    NUMPP_ACCEPT_EXPRESSIONS(ero_swap)
+    NUMPP_ACCEPT_EXPRESSIONS(ero_multiply)
+    NUMPP_ACCEPT_EXPRESSIONS(ero_sum)
+    NUMPP_ACCEPT_EXPRESSIONS(upper_triangular)
+    NUMPP_ACCEPT_EXPRESSIONS(rref)
+
+#undef NUMPP_ACCEPT_EXPRESSIONS
+}
+
+#endif //NUMPP_EXPRESSION_H
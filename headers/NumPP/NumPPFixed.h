@@ -0,0 +1,469 @@
+#ifndef NUMPP_FIXED_H
+#define NUMPP_FIXED_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include <array>
+#include <initializer_list>
+
+namespace numpp {
+    /*
+     * An M by N matrix whose shape is part of its type, for hot loops over small matrices
+     * (2-D and 3-D transforms, covariance updates, ...).
+     *
+     * The elements live inside the object (row-major, no heap allocation), the shape is a compile-time constant,
+     * and shape mismatches in `+`, `multiply` and friends are compile errors instead of runtime checks.
+     * Operators are evaluated eagerly: for a handful of elements an expression tree costs more than it saves.
+     * `determinant` and `invert` use closed-form expressions up to 4 by 4.
+     *
+     * Convert from a dynamic matrix with `FixedMatrix<T, M, N>{matrix}` (which checks the shape at runtime)
+     * and back with `toMatrix()`.
+     * */
+    template <class Scalar, size_t M, size_t N>
+    class FixedMatrix {
+        static_assert(M > 0 && N > 0, "A FixedMatrix needs at least one row and one column.");
+
+    private:
+        Scalar _data[M * N];
+
+    public:
+        typedef Scalar value_type;
+
+        static const size_t row_count = M;
+        static const size_t col_count = N;
+
+        /*
+         * A zero matrix.
+         * */
+        FixedMatrix();
+
+        // Fill Constructor
+        explicit FixedMatrix(Scalar number);
+
+        /*
+         * Rows of exactly N elements each, M rows in total; other shapes throw IllegalArithmeticsException.
+         * */
+        FixedMatrix(std::initializer_list<std::initializer_list<Scalar>> initList);
+
+        /*
+         * Copy a dynamic matrix (or a section) of shape M by N; other shapes throw IllegalArithmeticsException.
+         * */
+        explicit FixedMatrix(const BasicMatrix<Scalar>& matrix);
+
+        static FixedMatrix zeros();
+        static FixedMatrix ones();
+        static FixedMatrix identity();
+
+        static constexpr std::array<size_t, 2> shape();
+        static constexpr size_t rowCount();
+        static constexpr size_t colCount();
+
+        Scalar& operator()(size_t x, size_t y);
+        const Scalar& operator()(size_t x, size_t y) const;
+
+        Scalar at(size_t x, size_t y) const;
+
+        /*
+         * Element-wise compound assignments, as for Matrix.
+         * */
+        FixedMatrix& operator*=(Scalar other);
+        FixedMatrix& operator*=(const FixedMatrix& other);
+        FixedMatrix& operator+=(Scalar other);
+        FixedMatrix& operator+=(const FixedMatrix& other);
+        FixedMatrix& operator/=(Scalar other);
+        FixedMatrix& operator/=(const FixedMatrix& other);
+        FixedMatrix& operator-=(Scalar other);
+        FixedMatrix& operator-=(const FixedMatrix& other);
+
+        /*
+         * Elements in row-major order; the storage is contiguous, so these are plain pointers.
+         * */
+        Scalar* begin();
+        Scalar* end();
+        const Scalar* begin() const;
+        const Scalar* end() const;
+
+        /*
+         * Transpose form of this matrix
+         * */
+        FixedMatrix<Scalar, N, M> T() const;
+
+        /*
+         * Copy elements into a newly created dynamic matrix.
+         * */
+        BasicMatrix<Scalar> toMatrix() const;
+
+        Scalar* dataHolder();
+        const Scalar* dataHolder() const;
+
+        static constexpr size_t stride();
+    };
+
+    template <class Scalar, size_t M, size_t N>
+    const size_t FixedMatrix<Scalar, M, N>::row_count;
+
+    template <class Scalar, size_t M, size_t N>
+    const size_t FixedMatrix<Scalar, M, N>::col_count;
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>::FixedMatrix() : _data() {}
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>::FixedMatrix(Scalar number) {
+        std::fill(_data, _data + M * N, number);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>::FixedMatrix(std::initializer_list<std::initializer_list<Scalar>> initList) {
+        if (initList.size() != M) {
+            throw IllegalArithmeticsException{"The number of rows does not match the shape of the fixed-size matrix."};
+        }
+        Scalar* row_data = _data;
+        for (const std::initializer_list<Scalar>& rowList : initList) {
+            if (rowList.size() != N) {
+                throw IllegalArithmeticsException{"The number of columns does not match the shape of the fixed-size matrix."};
+            }
+            std::copy(rowList.begin(), rowList.end(), row_data);
+            row_data += N;
+        }
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>::FixedMatrix(const BasicMatrix<Scalar>& matrix) {
+        if (matrix.rowCount() != M || matrix.colCount() != N) {
+            throw IllegalArithmeticsException{"The shape of the matrix does not match the shape of the fixed-size matrix."};
+        }
+        for (size_t r = 0; r < M; r++) {
+            const Scalar* src = matrix.dataHolder() + r * matrix.stride();
+            std::copy(src, src + N, _data + r * N);
+        }
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> FixedMatrix<Scalar, M, N>::zeros() {
+        return FixedMatrix{};
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> FixedMatrix<Scalar, M, N>::ones() {
+        return FixedMatrix(Scalar(1));
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> FixedMatrix<Scalar, M, N>::identity() {
+        static_assert(M == N, "An identity matrix must be square.");
+        FixedMatrix res;
+        for (size_t i = 0; i < M; i++) {
+            res._data[i * N + i] = Scalar(1);
+        }
+        return res;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    constexpr std::array<size_t, 2> FixedMatrix<Scalar, M, N>::shape() {
+        return std::array<size_t, 2>{{M, N}};
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    constexpr size_t FixedMatrix<Scalar, M, N>::rowCount() {
+        return M;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    constexpr size_t FixedMatrix<Scalar, M, N>::colCount() {
+        return N;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    Scalar& FixedMatrix<Scalar, M, N>::operator()(size_t x, size_t y) {
+        return _data[x * N + y];
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    const Scalar& FixedMatrix<Scalar, M, N>::operator()(size_t x, size_t y) const {
+        return _data[x * N + y];
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    Scalar FixedMatrix<Scalar, M, N>::at(size_t x, size_t y) const {
+        return _data[x * N + y];
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator*=(Scalar other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] *= other;
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator*=(const FixedMatrix& other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] *= other._data[i];
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator+=(Scalar other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] += other;
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator+=(const FixedMatrix& other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] += other._data[i];
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator/=(Scalar other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] /= other;
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator/=(const FixedMatrix& other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] /= other._data[i];
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator-=(Scalar other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] -= other;
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N>& FixedMatrix<Scalar, M, N>::operator-=(const FixedMatrix& other) {
+        for (size_t i = 0; i < M * N; i++) {
+            _data[i] -= other._data[i];
+        }
+        return *this;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    Scalar* FixedMatrix<Scalar, M, N>::begin() {
+        return _data;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    Scalar* FixedMatrix<Scalar, M, N>::end() {
+        return _data + M * N;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    const Scalar* FixedMatrix<Scalar, M, N>::begin() const {
+        return _data;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    const Scalar* FixedMatrix<Scalar, M, N>::end() const {
+        return _data + M * N;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, N, M> FixedMatrix<Scalar, M, N>::T() const {
+        FixedMatrix<Scalar, N, M> res;
+        Scalar* dst = res.dataHolder();
+        for (size_t r = 0; r < M; r++) {
+            for (size_t c = 0; c < N; c++) {
+                dst[c * M + r] = _data[r * N + c];
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    BasicMatrix<Scalar> FixedMatrix<Scalar, M, N>::toMatrix() const {
+        BasicAlignedBuffer<Scalar> buffer(M * N);
+        std::copy(_data, _data + M * N, buffer.data());
+        return BasicMatrix<Scalar>(M, N, std::move(buffer));
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    Scalar* FixedMatrix<Scalar, M, N>::dataHolder() {
+        return _data;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    const Scalar* FixedMatrix<Scalar, M, N>::dataHolder() const {
+        return _data;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    constexpr size_t FixedMatrix<Scalar, M, N>::stride() {
+        return N;
+    }
+
+    /*
+     * Element-wise `x op y` for two fixed-size matrices or a fixed-size matrix and a scalar, on either side.
+     * */
+    template <class Op, class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> fixed_elementwise(const FixedMatrix<Scalar, M, N>& x, const FixedMatrix<Scalar, M, N>& y) {
+        FixedMatrix<Scalar, M, N> res;
+        for (size_t i = 0; i < M * N; i++) {
+            res.dataHolder()[i] = Op::scalar(x.dataHolder()[i], y.dataHolder()[i]);
+        }
+        return res;
+    }
+
+    template <class Op, class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> fixed_elementwise(const FixedMatrix<Scalar, M, N>& x, Scalar y) {
+        FixedMatrix<Scalar, M, N> res;
+        for (size_t i = 0; i < M * N; i++) {
+            res.dataHolder()[i] = Op::scalar(x.dataHolder()[i], y);
+        }
+        return res;
+    }
+
+    template <class Op, class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> fixed_elementwise(Scalar x, const FixedMatrix<Scalar, M, N>& y) {
+        FixedMatrix<Scalar, M, N> res;
+        for (size_t i = 0; i < M * N; i++) {
+            res.dataHolder()[i] = Op::scalar(x, y.dataHolder()[i]);
+        }
+        return res;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator+(const FixedMatrix<Scalar, M, N>& x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::AddOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator+(const FixedMatrix<Scalar, M, N>& x, typename NonDeduced<Scalar>::type y) {
+        return fixed_elementwise<kernels::AddOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator+(typename NonDeduced<Scalar>::type x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::AddOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator-(const FixedMatrix<Scalar, M, N>& x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::SubOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator-(const FixedMatrix<Scalar, M, N>& x, typename NonDeduced<Scalar>::type y) {
+        return fixed_elementwise<kernels::SubOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator-(typename NonDeduced<Scalar>::type x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::SubOp>(x, y);
+    }
+
+    /*
+     * Element-wise product; the matrix product is `multiply`.
+     * */
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator*(const FixedMatrix<Scalar, M, N>& x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::MulOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator*(const FixedMatrix<Scalar, M, N>& x, typename NonDeduced<Scalar>::type y) {
+        return fixed_elementwise<kernels::MulOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator*(typename NonDeduced<Scalar>::type x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::MulOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator/(const FixedMatrix<Scalar, M, N>& x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::DivOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator/(const FixedMatrix<Scalar, M, N>& x, typename NonDeduced<Scalar>::type y) {
+        return fixed_elementwise<kernels::DivOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator/(typename NonDeduced<Scalar>::type x, const FixedMatrix<Scalar, M, N>& y) {
+        return fixed_elementwise<kernels::DivOp>(x, y);
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> operator-(const FixedMatrix<Scalar, M, N>& x) {
+        FixedMatrix<Scalar, M, N> res;
+        for (size_t i = 0; i < M * N; i++) {
+            res.dataHolder()[i] = -x.dataHolder()[i];
+        }
+        return res;
+    }
+
+    /*
+     * Matrix product; the inner dimensions are checked by the compiler.
+     * All trip counts are constants, so the loops are unrolled and vectorized for small shapes.
+     * */
+    template <class Scalar, size_t M, size_t K, size_t N>
+    FixedMatrix<Scalar, M, N> multiply(const FixedMatrix<Scalar, M, K>& matrix1, const FixedMatrix<Scalar, K, N>& matrix2) {
+        FixedMatrix<Scalar, M, N> res;
+        const Scalar* a = matrix1.dataHolder();
+        const Scalar* b = matrix2.dataHolder();
+        Scalar* c = res.dataHolder();
+        for (size_t i = 0; i < M; i++) {
+            for (size_t p = 0; p < K; p++) {
+                const Scalar a_ip = a[i * K + p];
+                for (size_t j = 0; j < N; j++) {
+                    c[i * N + j] += a_ip * b[p * N + j];
+                }
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, M, N> multiply(const FixedMatrix<Scalar, M, N>& matrix, typename NonDeduced<Scalar>::type c) {
+        return matrix * c;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    FixedMatrix<Scalar, N, M> transpose(const FixedMatrix<Scalar, M, N>& matrix) {
+        return matrix.T();
+    }
+
+    /*
+     * Closed form up to 4 by 4 (exact for integer elements as well), LU decomposition beyond.
+     * */
+    template <class Scalar, size_t N>
+    Scalar determinant(const FixedMatrix<Scalar, N, N>& matrix) {
+        static_assert(N <= 4 || is_field<Scalar>::value,
+                      "Determinants beyond 4 by 4 need a floating-point or complex element type.");
+        return kernels::SmallSquare<Scalar, N>::determinant(matrix.dataHolder(), N);
+    }
+
+    template <class Scalar, size_t N>
+    FixedMatrix<Scalar, N, N> invert(const FixedMatrix<Scalar, N, N>& matrix) {
+        static_assert(is_field<Scalar>::value, "Inverting a matrix needs a floating-point or complex element type.");
+        FixedMatrix<Scalar, N, N> res;
+        if (!kernels::SmallSquare<Scalar, N>::invert(matrix.dataHolder(), N, res.dataHolder(), N)) {
+            throw IllegalArithmeticsException{"The given matrix has no invert since its determinant is zero."};
+        }
+        return res;
+    }
+
+    template <class Scalar, size_t M, size_t N>
+    void show(const FixedMatrix<Scalar, M, N>& matrix) {
+        show(matrix.toMatrix());
+    }
+}
+
+#endif //NUMPP_FIXED_H
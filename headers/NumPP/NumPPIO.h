@@ -0,0 +1,949 @@
+#ifndef NUMPP_IO_H
+#define NUMPP_IO_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPParallel.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NUMPP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define NUMPP_HAS_MMAP 0
+#endif
+
+namespace numpp {
+    /*
+     * Matrices are stored in NumPy's .npy format (version 1.0): a short text header describing
+     * the element type and the shape, padded so that the raw row-major elements start at a multiple of 64 bytes,
+     * followed by the elements themselves. The files load with `numpy.load` and can be mapped without copying.
+     * */
+    namespace npy {
+        const char MAGIC[] = "\x93NUMPY";
+        const size_t MAGIC_SIZE = 6;
+        const size_t DATA_ALIGNMENT = 64;
+
+        /*
+         * Longest fixed part before the header dictionary (versions 2.0 and 3.0 store a 4-byte length).
+         * */
+        const size_t PREAMBLE_MAX_SIZE = MAGIC_SIZE + 6;
+
+        struct Header {
+            std::string descr;
+            bool fortran_order;
+            size_t rows;
+            size_t cols;
+
+            /*
+             * Offset of the first element from the start of the file.
+             * */
+            size_t data_offset;
+        };
+
+        bool little_endian() {
+            const uint16_t probe = 1;
+            return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+        }
+
+        /*
+         * NumPy's type string of Scalar, e.g. "<f8" for double on a little-endian machine.
+         * */
+        template <class Scalar>
+        std::string descr() {
+            static_assert(std::is_arithmetic<Scalar>::value || is_complex<Scalar>::value,
+                          "Only arithmetic and complex matrices can be saved.");
+            char kind = is_complex<Scalar>::value ? 'c'
+                        : std::is_floating_point<Scalar>::value ? 'f'
+                        : std::is_same<Scalar, bool>::value ? 'b'
+                        : std::is_signed<Scalar>::value ? 'i' : 'u';
+            char order = sizeof(Scalar) == 1 ? '|' : little_endian() ? '<' : '>';
+            return std::string{order, kind} + std::to_string(sizeof(Scalar));
+        }
+
+        std::string format_header(const std::string& descr, size_t rows, size_t cols) {
+            std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': ("
+                               + std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+            // Magic, version and the 2-byte length take 10 bytes; the dictionary ends with a newline.
+            const size_t unpadded = MAGIC_SIZE + 4 + dict.size() + 1;
+            dict.append((DATA_ALIGNMENT - unpadded % DATA_ALIGNMENT) % DATA_ALIGNMENT, ' ');
+            dict.push_back('\n');
+
+            std::string header(MAGIC, MAGIC_SIZE);
+            header.push_back('\x01');
+            header.push_back('\x00');
+            header.push_back(static_cast<char>(dict.size() & 0xff));
+            header.push_back(static_cast<char>(dict.size() >> 8));
+            return header + dict;
+        }
+
+        /*
+         * The value of `key` in the header dictionary, up to the next comma outside parentheses.
+         * */
+        std::string dict_value(const std::string& dict, const std::string& key) {
+            size_t pos = dict.find("'" + key + "'");
+            if (pos == std::string::npos) {
+                throw IOException{"The .npy header has no '" + key + "' entry."};
+            }
+            pos = dict.find(':', pos);
+            if (pos == std::string::npos) {
+                throw IOException{"The .npy header is malformed."};
+            }
+            size_t end = pos + 1;
+            int depth = 0;
+            while (end < dict.size() && (depth > 0 || (dict[end] != ',' && dict[end] != '}'))) {
+                if (dict[end] == '(') {
+                    depth++;
+                }
+                else if (dict[end] == ')') {
+                    depth--;
+                }
+                end++;
+            }
+            const size_t first = dict.find_first_not_of(" '", pos + 1);
+            const size_t last = dict.find_last_not_of(" '", end - 1);
+            return first == std::string::npos || first > last ? std::string() : dict.substr(first, last - first + 1);
+        }
+
+        /*
+         * Size of the fixed part before the header dictionary: magic, version and the length of the dictionary.
+         * */
+        size_t preamble_size(unsigned char major) {
+            if (major == 1) {
+                return MAGIC_SIZE + 4;
+            }
+            if (major == 2 || major == 3) {
+                return MAGIC_SIZE + 6;
+            }
+            throw IOException{"Unsupported .npy format version " + std::to_string(major) + "."};
+        }
+
+        /*
+         * Offset of the first element, read from the first `size` bytes of a file
+         * (PREAMBLE_MAX_SIZE bytes are always enough).
+         * */
+        size_t data_offset(const char* bytes, size_t size) {
+            if (size < MAGIC_SIZE + 4 || std::memcmp(bytes, MAGIC, MAGIC_SIZE) != 0) {
+                throw IOException{"The file is not in the .npy format."};
+            }
+            const size_t preamble = preamble_size(static_cast<unsigned char>(bytes[MAGIC_SIZE]));
+            if (size < preamble) {
+                throw IOException{"The .npy header is truncated."};
+            }
+            size_t dict_size = 0;
+            for (size_t i = MAGIC_SIZE + 2; i < preamble; i++) {
+                dict_size |= static_cast<size_t>(static_cast<unsigned char>(bytes[i])) << (8 * (i - MAGIC_SIZE - 2));
+            }
+            return preamble + dict_size;
+        }
+
+        /*
+         * Parse the header at the start of `bytes` (at least `size` bytes are available).
+         * Zero- and one-dimensional arrays become 1 by 1 and 1 by n matrices.
+         * */
+        Header parse_header(const char* bytes, size_t size) {
+            const size_t dict_end = data_offset(bytes, size);
+            if (dict_end > size) {
+                throw IOException{"The .npy header is truncated."};
+            }
+            const size_t dict_offset = preamble_size(static_cast<unsigned char>(bytes[MAGIC_SIZE]));
+            const size_t dict_size = dict_end - dict_offset;
+
+            const std::string dict(bytes + dict_offset, dict_size);
+            Header header;
+            header.descr = dict_value(dict, "descr");
+            header.fortran_order = dict_value(dict, "fortran_order") == "True";
+            header.data_offset = dict_offset + dict_size;
+
+            const std::string shape = dict_value(dict, "shape");
+            std::vector<size_t> dims;
+            size_t pos = shape.find_first_of("0123456789");
+            while (pos != std::string::npos) {
+                size_t end = shape.find_first_not_of("0123456789", pos);
+                dims.push_back(std::stoull(shape.substr(pos, end - pos)));
+                pos = end == std::string::npos ? end : shape.find_first_of("0123456789", end);
+            }
+            if (dims.size() > 2) {
+                throw IOException{"Only arrays with at most two dimensions can be loaded as a matrix."};
+            }
+            header.rows = dims.size() == 2 ? dims[0] : 1;
+            header.cols = dims.empty() ? 1 : dims.back();
+            return header;
+        }
+
+        template <class Scalar>
+        void check_descr(const Header& header) {
+            if (header.descr != descr<Scalar>()) {
+                throw IOException{"The file holds elements of type '" + header.descr + "' but the matrix expects '"
+                                  + descr<Scalar>() + "'."};
+            }
+        }
+
+#if NUMPP_HAS_MMAP
+        /*
+         * Resource of every matrix created by BasicMatrix::mmap. Releasing the elements of a mapped file unmaps it;
+         * anything else (a mapped matrix reallocated by assigning a matrix of another shape to it) goes to the heap.
+         * It is never destroyed, so matrices may keep pointing at it for as long as they live.
+         * */
+        class MappedFileResource : public MemoryResource {
+        private:
+            struct Mapping {
+                void* base;
+                size_t length;
+            };
+
+            std::mutex _mutex;
+
+            /*
+             * Live mappings by the address of their first element.
+             * */
+            std::map<void*, Mapping> _mappings;
+
+        public:
+            void add(void* data, void* base, size_t length) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _mappings[data] = Mapping{base, length};
+            }
+
+            void* allocate(size_t bytes, size_t alignment) override {
+                return new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void deallocate(void* p, size_t bytes, size_t alignment) override {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    std::map<void*, Mapping>::iterator found = _mappings.find(p);
+                    if (found != _mappings.end()) {
+                        munmap(found->second.base, found->second.length);
+                        _mappings.erase(found);
+                        return;
+                    }
+                }
+                new_delete_resource()->deallocate(p, bytes, alignment);
+            }
+        };
+
+        MappedFileResource* mapped_file_resource() {
+            static MappedFileResource* resource = new MappedFileResource();
+            return resource;
+        }
+#endif
+    }
+
+    /*
+     * Write a matrix (or a section) to `path` in the .npy format. Throws IOException if the file cannot be written.
+     * */
+    template <class Scalar>
+    void save(const std::string& path, const BasicMatrix<Scalar>& matrix) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw IOException{"Cannot open '" + path + "' for writing."};
+        }
+
+        const std::string header = npy::format_header(npy::descr<Scalar>(), matrix.rowCount(), matrix.colCount());
+        file.write(header.data(), header.size());
+        for (size_t r = 0; r < matrix.rowCount(); r++) {
+            file.write(reinterpret_cast<const char*>(matrix.dataHolder() + r * matrix.stride()),
+                       matrix.colCount() * sizeof(Scalar));
+        }
+        if (!file.flush()) {
+            throw IOException{"Failed to write '" + path + "'."};
+        }
+    }
+
+    /*
+     * Read a .npy file written by `numpp::save` or NumPy into a new matrix, e.g. `numpp::load("w.npy")`
+     * or `numpp::load<float>("w.npy")`. Fortran-order files are transposed into row-major storage.
+     * The element type of the file must match Scalar; otherwise IOException is thrown.
+     * */
+    template <class Scalar = double>
+    BasicMatrix<Scalar> load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw IOException{"Cannot open '" + path + "' for reading."};
+        }
+
+        // Read the fixed preamble first to learn how long the whole header is.
+        std::string header_bytes(npy::PREAMBLE_MAX_SIZE, '\0');
+        file.read(&header_bytes[0], header_bytes.size());
+        header_bytes.resize(static_cast<size_t>(file.gcount()));
+        const size_t header_size = npy::data_offset(header_bytes.data(), header_bytes.size());
+        if (header_size > header_bytes.size()) {
+            const size_t have = header_bytes.size();
+            header_bytes.resize(header_size);
+            file.read(&header_bytes[have], header_size - have);
+            header_bytes.resize(have + static_cast<size_t>(file.gcount()));
+        }
+
+        const npy::Header header = npy::parse_header(header_bytes.data(), header_bytes.size());
+        npy::check_descr<Scalar>(header);
+        file.seekg(static_cast<std::streamoff>(header.data_offset));
+
+        const size_t count = header.rows * header.cols;
+        BasicAlignedBuffer<Scalar> buffer(count);
+        file.read(reinterpret_cast<char*>(buffer.data()), count * sizeof(Scalar));
+        if (static_cast<size_t>(file.gcount()) != count * sizeof(Scalar)) {
+            throw IOException{"The file '" + path + "' is shorter than its header says."};
+        }
+
+        if (!header.fortran_order) {
+            return BasicMatrix<Scalar>(header.rows, header.cols, std::move(buffer));
+        }
+        // Column-major elements are the row-major elements of the transpose.
+        BasicMatrix<Scalar> res{header.rows, header.cols};
+        kernels::transpose(header.cols, header.rows, buffer.data(), header.rows, res.dataHolder(), res.stride());
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMatrix<Scalar>::mmap(const std::string& path) {
+#if NUMPP_HAS_MMAP
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw IOException{"Cannot open '" + path + "' for reading."};
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            throw IOException{"Cannot map '" + path + "': the file is empty or cannot be inspected."};
+        }
+
+        // MAP_PRIVATE: writes go to private copies of the touched pages, so the matrix is as writable as any other.
+        const size_t length = static_cast<size_t>(info.st_size);
+        void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            throw IOException{"Cannot map '" + path + "'."};
+        }
+
+        npy::Header header;
+        try {
+            header = npy::parse_header(static_cast<const char*>(base), length);
+            npy::check_descr<Scalar>(header);
+            if (header.fortran_order) {
+                throw IOException{"Cannot map '" + path + "': it is stored in Fortran order."};
+            }
+            if (header.data_offset + header.rows * header.cols * sizeof(Scalar) > length) {
+                throw IOException{"The file '" + path + "' is shorter than its header says."};
+            }
+        }
+        catch (...) {
+            munmap(base, length);
+            throw;
+        }
+        if (header.data_offset % alignof(Scalar) != 0) {
+            // NumPy pads headers to 64 bytes; elements of hand-made files may sit at an unusable address.
+            munmap(base, length);
+            return load<Scalar>(path);
+        }
+
+        Scalar* data = reinterpret_cast<Scalar*>(static_cast<char*>(base) + header.data_offset);
+        npy::mapped_file_resource()->add(data, base, length);
+        BasicAlignedBuffer<Scalar> buffer(data, header.rows * header.cols, npy::mapped_file_resource());
+        return BasicMatrix<Scalar>(header.rows, header.cols, std::move(buffer));
+#else
+        return load<Scalar>(path);
+#endif
+    }
+
+    /*
+     * Parsing of delimited text (CSV and whitespace-separated files) straight into matrix storage.
+     * */
+    namespace text {
+        /*
+         * Bytes read from the file at a time when streaming.
+         * */
+        const size_t CHUNK_BYTES = 1 << 20;
+
+        /*
+         * Delimiter value meaning "any run of spaces and tabs", as in numpy.loadtxt.
+         * */
+        const char WHITESPACE = ' ';
+
+        const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        bool is_blank(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        /*
+         * Blanks around a field that are not themselves the delimiter.
+         * */
+        bool is_padding(char c, char delimiter) {
+            return is_blank(c) && (delimiter == WHITESPACE || c != delimiter);
+        }
+
+        bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        /*
+         * Parse a floating-point number at [p, end) and return the first character after it, or nullptr.
+         *
+         * Numbers with at most 19 significant digits and a decimal exponent within +-22 (nearly everything
+         * found in CSV exports) are exact in one multiplication or division, since both operands are exact doubles;
+         * anything else (long mantissas, huge exponents, inf, nan, hexadecimal) goes through strtod.
+         * */
+        const char* parse_number(const char* p, const char* end, double& out) {
+            const char* start = p;
+            bool negative = false;
+            if (p != end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+
+            uint64_t mantissa = 0;
+            int digits = 0;
+            int exponent = 0;
+            bool any_digit = false;
+            for (; p != end && is_digit(*p); p++) {
+                any_digit = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    digits += mantissa != 0;
+                }
+                else {
+                    exponent++;
+                    digits++;
+                }
+            }
+            if (p != end && *p == '.') {
+                for (p++; p != end && is_digit(*p); p++) {
+                    any_digit = true;
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                        digits += mantissa != 0;
+                        exponent--;
+                    }
+                    else {
+                        digits++;
+                    }
+                }
+            }
+            if (any_digit && p != end && (*p == 'e' || *p == 'E')) {
+                const char* q = p + 1;
+                bool negative_exponent = false;
+                if (q != end && (*q == '-' || *q == '+')) {
+                    negative_exponent = *q == '-';
+                    q++;
+                }
+                if (q != end && is_digit(*q)) {
+                    int value = 0;
+                    for (; q != end && is_digit(*q); q++) {
+                        value = std::min(value * 10 + (*q - '0'), 100000);
+                    }
+                    exponent += negative_exponent ? -value : value;
+                    p = q;
+                }
+            }
+
+            // A letter right after the digits means a form the fast path does not know, such as "0x10".
+            const bool letter_follows = p != end && ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z');
+            if (any_digit && !letter_follows && digits <= 19 && mantissa < (uint64_t(1) << 53)
+                && exponent >= -22 && exponent <= 22) {
+                double value = static_cast<double>(mantissa);
+                value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+                out = negative ? -value : value;
+                return p;
+            }
+
+            // Slow path: strtod needs a terminated copy of the token.
+            const char* token_end = start;
+            while (token_end != end && !is_blank(*token_end) && *token_end != '\n' && *token_end != ','
+                   && *token_end != ';' && *token_end != '|') {
+                token_end++;
+            }
+            const std::string token(start, token_end);
+            char* parsed_end = nullptr;
+            out = std::strtod(token.c_str(), &parsed_end);
+            if (parsed_end == token.c_str()) {
+                return nullptr;
+            }
+            return start + (parsed_end - token.c_str());
+        }
+
+        const char* parse_number(const char* p, const char* end, float& out) {
+            double value;
+            p = parse_number(p, end, value);
+            out = static_cast<float>(value);
+            return p;
+        }
+
+        /*
+         * Integers reject fractions and exponents instead of truncating them.
+         * */
+        template <class T>
+        const char* parse_number(const char* p, const char* end, T& out) {
+            static_assert(std::is_integral<T>::value, "Text files can only be read into real-valued matrices.");
+            bool negative = false;
+            if (p != end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+            if (p == end || !is_digit(*p)) {
+                return nullptr;
+            }
+            T value = 0;
+            for (; p != end && is_digit(*p); p++) {
+                value = static_cast<T>(value * 10 + (*p - '0'));
+            }
+            if (p != end && (*p == '.' || *p == 'e' || *p == 'E')) {
+                return nullptr;
+            }
+            out = negative ? static_cast<T>(-value) : value;
+            return p;
+        }
+
+        /*
+         * Start of the next field after position `p`, which ends the previous field,
+         * or nullptr at the end of the line (or if the field is followed by something else than a delimiter).
+         * */
+        const char* next_field(const char* p, const char* end, char delimiter) {
+            while (p != end && is_padding(*p, delimiter)) {
+                p++;
+            }
+            if (p == end || *p == '\n' || (delimiter != WHITESPACE && *p != delimiter)) {
+                return nullptr;
+            }
+            if (delimiter != WHITESPACE) {
+                p++;
+            }
+            while (p != end && is_padding(*p, delimiter)) {
+                p++;
+            }
+            return p;
+        }
+
+        /*
+         * Whether `p` is where a field ends: at a delimiter, padding or the end of the line.
+         * */
+        bool ends_field(const char* p, const char* end, char delimiter) {
+            return p == end || *p == '\n' || *p == delimiter || is_blank(*p);
+        }
+
+        /*
+         * Skip one field that is not selected.
+         * */
+        const char* skip_field(const char* p, const char* end, char delimiter) {
+            while (p != end && *p != '\n' && *p != delimiter && !(delimiter == WHITESPACE && is_blank(*p))) {
+                p++;
+            }
+            return p;
+        }
+
+        /*
+         * Number of fields in the line starting at `p`.
+         * */
+        size_t count_fields(const char* p, const char* end, char delimiter) {
+            while (p != end && is_padding(*p, delimiter)) {
+                p++;
+            }
+            size_t count = 0;
+            while (p != nullptr && p != end && *p != '\n') {
+                count++;
+                p = next_field(skip_field(p, end, delimiter), end, delimiter);
+            }
+            return count;
+        }
+
+        /*
+         * Whether the line starting at `p` holds no data: it is empty, blank or a '#' comment.
+         * */
+        bool is_data_line(const char* p, const char* end) {
+            while (p != end && is_blank(*p)) {
+                p++;
+            }
+            return p != end && *p != '\n' && *p != '#';
+        }
+    }
+
+    /*
+     * Reads a delimited text file in blocks of rows, so files larger than memory can be processed piece by piece:
+     *
+     * numpp::CsvReader reader("data.csv");
+     * numpp::Matrix block(0, 0);
+     * while (reader.next(block, 100000)) { ... }
+     *
+     * Every block is parsed in parallel directly into the storage of the matrix, without intermediate rows.
+     * `delimiter` separates fields (text::WHITESPACE, a space, accepts any run of spaces and tabs);
+     * the first `skip_rows` lines are skipped, as are empty lines and lines starting with '#'.
+     * `columns` selects and orders the fields to keep (all when empty); selecting a field twice throws IOException.
+     * Malformed lines throw IOException with their line number.
+     * */
+    template <class Scalar>
+    class BasicCsvReader {
+    private:
+        std::ifstream _file;
+        std::string _path;
+        char _delimiter;
+        std::vector<size_t> _columns;
+
+        /*
+         * Field count of the first data line; every other line must match it.
+         * */
+        size_t _fields;
+
+        /*
+         * Bytes read but not parsed yet start at `_buffer[_begin]`; `_line` is the line number of that position.
+         * */
+        std::string _buffer;
+        size_t _begin;
+        size_t _line;
+        bool _eof;
+
+        bool fill(size_t bytes);
+
+        void parse(const std::vector<const char*>& lines, const char* end, BasicMatrix<Scalar>& block);
+
+        [[noreturn]] void fail(const char* line_start, const std::string& reason) const;
+
+    public:
+        explicit BasicCsvReader(const std::string& path, char delimiter = ',', size_t skip_rows = 0,
+                                std::vector<size_t> columns = std::vector<size_t>());
+
+        /*
+         * Parse up to `max_rows` rows into `block` (resizing it); returns false once the file is exhausted.
+         * */
+        bool next(BasicMatrix<Scalar>& block, size_t max_rows);
+
+        /*
+         * Parse all remaining rows.
+         * */
+        BasicMatrix<Scalar> readAll();
+    };
+
+    typedef BasicCsvReader<double> CsvReader;
+
+    template <class Scalar>
+    BasicCsvReader<Scalar>::BasicCsvReader(const std::string& path, char delimiter, size_t skip_rows, std::vector<size_t> columns) :
+            _file(path, std::ios::binary), _path(path), _delimiter(delimiter), _columns(std::move(columns)),
+            _fields(0), _begin(0), _line(1), _eof(false) {
+        if (!_file) {
+            throw IOException{"Cannot open '" + path + "' for reading."};
+        }
+        std::vector<size_t> sorted = _columns;
+        std::sort(sorted.begin(), sorted.end());
+        const std::vector<size_t>::iterator repeated = std::adjacent_find(sorted.begin(), sorted.end());
+        if (repeated != sorted.end()) {
+            throw IOException{"Column " + std::to_string(*repeated) + " of '" + path + "' is selected more than once."};
+        }
+        for (size_t skipped = 0; skipped < skip_rows;) {
+            const size_t newline = _buffer.find('\n', _begin);
+            if (newline != std::string::npos) {
+                _begin = newline + 1;
+                _line++;
+                skipped++;
+            }
+            else if (!fill(text::CHUNK_BYTES)) {
+                _begin = _buffer.size();
+                break;
+            }
+        }
+    }
+
+    template <class Scalar>
+    bool BasicCsvReader<Scalar>::fill(size_t bytes) {
+        if (_eof) {
+            return false;
+        }
+        _buffer.erase(0, _begin);
+        _begin = 0;
+        const size_t have = _buffer.size();
+        _buffer.resize(have + bytes);
+        _file.read(&_buffer[have], static_cast<std::streamsize>(bytes));
+        const size_t got = static_cast<size_t>(_file.gcount());
+        _buffer.resize(have + got);
+        _eof = got < bytes;
+        return got > 0;
+    }
+
+    template <class Scalar>
+    void BasicCsvReader<Scalar>::fail(const char* line_start, const std::string& reason) const {
+        const size_t line = _line + static_cast<size_t>(std::count(_buffer.data() + _begin, line_start, '\n'));
+        throw IOException{"'" + _path + "', line " + std::to_string(line) + ": " + reason};
+    }
+
+    template <class Scalar>
+    void BasicCsvReader<Scalar>::parse(const std::vector<const char*>& lines, const char* end, BasicMatrix<Scalar>& block) {
+        if (_fields == 0) {
+            _fields = text::count_fields(lines[0], end, _delimiter);
+            for (size_t column : _columns) {
+                if (column >= _fields) {
+                    fail(lines[0], "column " + std::to_string(column) + " is selected but the line has "
+                                   + std::to_string(_fields) + " fields.");
+                }
+            }
+        }
+
+        // Output column of every field, or -1 for fields that are not kept.
+        std::vector<long> target(_fields, -1);
+        if (_columns.empty()) {
+            for (size_t f = 0; f < _fields; f++) {
+                target[f] = static_cast<long>(f);
+            }
+        }
+        else {
+            for (size_t c = 0; c < _columns.size(); c++) {
+                target[_columns[c]] = static_cast<long>(c);
+            }
+        }
+        const size_t cols = _columns.empty() ? _fields : _columns.size();
+
+        BasicAlignedBuffer<Scalar> buffer(lines.size() * cols);
+        Scalar* data = buffer.data();
+        const size_t fields = _fields;
+        const char delimiter = _delimiter;
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / (fields + 1) + 1;
+        parallel::parallel_for(0, lines.size(), grain, [&](size_t begin, size_t stop) {
+            for (size_t r = begin; r < stop; r++) {
+                const char* p = lines[r];
+                while (p != end && text::is_padding(*p, delimiter)) {
+                    p++;
+                }
+                for (size_t f = 0; f < fields; f++) {
+                    if (p == nullptr || p == end || *p == '\n') {
+                        fail(lines[r], "expected " + std::to_string(fields) + " fields but found " + std::to_string(f) + ".");
+                    }
+                    if (target[f] < 0) {
+                        p = text::skip_field(p, end, delimiter);
+                    }
+                    else {
+                        p = text::parse_number(p, end, data[r * cols + target[f]]);
+                        if (p == nullptr || !text::ends_field(p, end, delimiter)) {
+                            fail(lines[r], "field " + std::to_string(f) + " is not a number.");
+                        }
+                    }
+                    if (f + 1 < fields) {
+                        p = text::next_field(p, end, delimiter);
+                    }
+                }
+                while (p != end && text::is_blank(*p)) {
+                    p++;
+                }
+                if (p != end && *p != '\n') {
+                    fail(lines[r], "expected " + std::to_string(fields) + " numeric fields.");
+                }
+            }
+        });
+        block = BasicMatrix<Scalar>(lines.size(), cols, std::move(buffer));
+    }
+
+    template <class Scalar>
+    bool BasicCsvReader<Scalar>::next(BasicMatrix<Scalar>& block, size_t max_rows) {
+        // Find up to max_rows complete data lines, reading more of the file as needed.
+        // Offsets are relative to `_begin`, which reading more does not invalidate.
+        std::vector<size_t> offsets;
+        size_t consumed = 0;
+        size_t consumed_lines = 0;
+        while (offsets.size() < max_rows) {
+            const size_t newline = _buffer.find('\n', _begin + consumed);
+            if (newline == std::string::npos) {
+                if (fill(std::max(text::CHUNK_BYTES, _buffer.size() - _begin))) {
+                    continue;
+                }
+                // The last line may end without a newline.
+                if (_begin + consumed < _buffer.size()
+                        && text::is_data_line(_buffer.data() + _begin + consumed, _buffer.data() + _buffer.size())) {
+                    offsets.push_back(consumed);
+                }
+                consumed = _buffer.size() - _begin;
+                break;
+            }
+            if (text::is_data_line(_buffer.data() + _begin + consumed, _buffer.data() + newline)) {
+                offsets.push_back(consumed);
+            }
+            consumed = newline + 1 - _begin;
+            consumed_lines++;
+        }
+
+        if (!offsets.empty()) {
+            std::vector<const char*> lines(offsets.size());
+            for (size_t i = 0; i < offsets.size(); i++) {
+                lines[i] = _buffer.data() + _begin + offsets[i];
+            }
+            parse(lines, _buffer.data() + _begin + consumed, block);
+        }
+        _begin += consumed;
+        _line += consumed_lines;
+        return !offsets.empty();
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicCsvReader<Scalar>::readAll() {
+        // Read the rest of the file at once, so all rows are parsed in one parallel pass into one matrix.
+        const std::streamoff position = _file.tellg();
+        _file.seekg(0, std::ios::end);
+        const std::streamoff size = _file.tellg();
+        _file.seekg(position);
+        if (position >= 0 && size > position) {
+            fill(static_cast<size_t>(size - position) + 1);
+        }
+
+        BasicMatrix<Scalar> res(0, 0);
+        next(res, static_cast<size_t>(-1));
+        return res;
+    }
+
+    /*
+     * Read a whole delimited text file into a matrix; see BasicCsvReader for the parameters.
+     * `numpp::load_csv("data.csv")`, `numpp::load_csv<float>("data.csv", ';', 1, {0, 3})`.
+     * */
+    template <class Scalar = double>
+    BasicMatrix<Scalar> load_csv(const std::string& path, char delimiter = ',', size_t skip_rows = 0,
+                                 std::vector<size_t> columns = std::vector<size_t>()) {
+        return BasicCsvReader<Scalar>(path, delimiter, skip_rows, std::move(columns)).readAll();
+    }
+
+    /*
+     * Like numpy.loadtxt: fields are separated by any run of spaces and tabs unless `delimiter` says otherwise.
+     * */
+    template <class Scalar = double>
+    BasicMatrix<Scalar> loadtxt(const std::string& path, char delimiter = text::WHITESPACE, size_t skip_rows = 0,
+                                std::vector<size_t> columns = std::vector<size_t>()) {
+        return load_csv<Scalar>(path, delimiter, skip_rows, std::move(columns));
+    }
+
+    namespace text {
+        /*
+         * Append one element as `std::cout << std::defaultfloat << value` with the given precision would,
+         * through snprintf instead of a stream.
+         * */
+        template <class T>
+        void append_float(std::string& out, const char* format, int precision, T value) {
+            char buffer[64];
+            const int length = std::snprintf(buffer, sizeof(buffer), format, precision, value);
+            if (length < static_cast<int>(sizeof(buffer))) {
+                out.append(buffer, static_cast<size_t>(length));
+                return;
+            }
+            std::vector<char> large(static_cast<size_t>(length) + 1);
+            std::snprintf(large.data(), large.size(), format, precision, value);
+            out.append(large.data(), static_cast<size_t>(length));
+        }
+
+        void append_element(std::string& out, double value, int precision) {
+            append_float(out, "%.*g", precision, value);
+        }
+
+        void append_element(std::string& out, float value, int precision) {
+            append_float(out, "%.*g", precision, static_cast<double>(value));
+        }
+
+        void append_element(std::string& out, long double value, int precision) {
+            append_float(out, "%.*Lg", precision, value);
+        }
+
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value>::type append_element(std::string& out, T value, int) {
+            out += std::to_string(value);
+        }
+
+        template <class T>
+        void append_element(std::string& out, const std::complex<T>& value, int precision) {
+            out += '(';
+            append_element(out, value.real(), precision);
+            out += ',';
+            append_element(out, value.imag(), precision);
+            out += ')';
+        }
+
+        template <class Scalar>
+        void append_matrix(std::string& out, const BasicMatrix<Scalar>& matrix, const PrintOptions& options) {
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            const size_t edge = options.edge_items;
+            const bool summarize = rows * cols > options.threshold;
+            const bool elide_rows = summarize && rows > 2 * edge;
+            const bool elide_cols = summarize && cols > 2 * edge;
+
+            out.reserve(out.size() + 16 + (elide_rows ? 2 * edge + 1 : rows) * ((elide_cols ? 2 * edge + 1 : cols) * 10 + 4));
+            out += "Matrix([\n";
+            for (size_t r = 0; r < rows && cols > 0; r++) {
+                if (elide_rows && r == edge) {
+                    out += "\t...\n";
+                    r = rows - edge;
+                    // Without edge items only the ellipsis is written (rows are always elided then).
+                    if (r == rows) {
+                        break;
+                    }
+                }
+                const Scalar* row = matrix.dataHolder() + r * matrix.stride();
+                out += "\t[";
+                for (size_t c = 0; c < cols; c++) {
+                    if (elide_cols && c == edge) {
+                        out += "..., ";
+                        c = cols - edge;
+                    }
+                    append_element(out, row[c], options.precision);
+                    if (c + 1 < cols) {
+                        out += ", ";
+                    }
+                }
+                out += "]\n";
+            }
+            out += "])\n";
+        }
+    }
+
+    PrintOptions::PrintOptions(int precision_, size_t threshold_, size_t edge_items_) :
+            precision(precision_), threshold(threshold_), edge_items(edge_items_) {}
+
+    template <class Scalar>
+    void write(std::ostream& os, const BasicMatrix<Scalar>& matrix, const PrintOptions& options) {
+        std::string out;
+        text::append_matrix(out, matrix, options);
+        os.write(out.data(), static_cast<std::streamsize>(out.size()));
+    }
+
+    template <class Scalar>
+    std::string format(const BasicMatrix<Scalar>& matrix, const PrintOptions& options) {
+        std::string out;
+        text::append_matrix(out, matrix, options);
+        return out;
+    }
+
+    template <class Scalar>
+    std::string to_string(const BasicMatrix<Scalar>& matrix) {
+        return format(matrix);
+    }
+
+    template <class E>
+    void write(std::ostream& os, const MatrixExpression<E>& expression, const PrintOptions& options) {
+        write(os, expression.eval(), options);
+    }
+
+    template <class E>
+    std::string format(const MatrixExpression<E>& expression, const PrintOptions& options) {
+        return format(expression.eval(), options);
+    }
+
+    template <class E>
+    std::string to_string(const MatrixExpression<E>& expression) {
+        return format(expression.eval());
+    }
+
+    template <class Scalar>
+    std::ostream& operator<<(std::ostream& os, const BasicMatrix<Scalar>& matrix) {
+        write(os, matrix, PrintOptions(static_cast<int>(os.precision())));
+        return os;
+    }
+
+    template <class E>
+    std::ostream& operator<<(std::ostream& os, const MatrixExpression<E>& expression) {
+        return os << expression.eval();
+    }
+}
+
+#endif //NUMPP_IO_H
@@ -0,0 +1,2468 @@
+#ifndef NUMPP_KERNELS_H
+#define NUMPP_KERNELS_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPParallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/*
+ * SIMD code paths are compiled with per-function target attributes and selected at runtime,
+ * so the library still builds and runs without any -m flags. Define NUMPP_NO_SIMD to force the portable kernels.
+ * */
+#if !defined(NUMPP_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NUMPP_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define NUMPP_X86_SIMD 0
+#endif
+
+namespace numpp {
+    /*
+     * Low-level kernels working on raw row-major buffers.
+     *
+     * An operand is described by a pointer to its first element plus a row stride and a column stride (in elements),
+     * so the same kernel serves owning matrices, sections and transposed operands.
+     * Kernels are templates on the element type; double and float get SIMD code paths,
+     * every other element type (integers, std::complex) runs the portable loops.
+     * */
+    namespace kernels {
+        /*
+         * Blocking parameters of the GEMM:
+         * a MR by NR tile of C is kept in registers by the micro-kernel (see GemmTile),
+         * a MC by KC block of A is packed to stay in L2 and a KC by NC panel of B is packed to stay in L3.
+         * */
+        const size_t GEMM_MC = 72;
+        const size_t GEMM_KC = 256;
+        const size_t GEMM_NC = 3072;
+
+        /*
+         * Register tile of the GEMM micro-kernel: two AVX2 registers per row of C,
+         * i.e. 8 columns of double or 16 columns of float.
+         * */
+        template <class T>
+        struct GemmTile {
+            static const size_t MR = 6;
+            static const size_t NR = 8;
+        };
+
+        template <>
+        struct GemmTile<float> {
+            static const size_t MR = 6;
+            static const size_t NR = 16;
+        };
+
+        /*
+         * Products with fewer multiply-adds than this skip packing and use a plain loop.
+         * */
+        const size_t GEMM_SMALL_FLOPS = 48 * 48 * 48;
+
+        /*
+         * Instruction set levels a kernel can be dispatched to, in increasing order.
+         * SIMD_AVX2 implies FMA support as well.
+         * */
+        enum SimdLevel {
+            SIMD_SCALAR = 0,
+            SIMD_SSE2 = 1,
+            SIMD_AVX2 = 2,
+            SIMD_AVX512 = 3
+        };
+
+        SimdLevel detect_simd_level() {
+#if NUMPP_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return SIMD_AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return SIMD_AVX2;
+            }
+            if (__builtin_cpu_supports("sse2")) {
+                return SIMD_SSE2;
+            }
+#endif
+            return SIMD_SCALAR;
+        }
+
+        /*
+         * Highest instruction set level supported by the running CPU (detected once).
+         * */
+        SimdLevel simd_level() {
+            static const SimdLevel level = detect_simd_level();
+            return level;
+        }
+
+        /*
+         * Register types and memory accesses of one element type at every SIMD level.
+         * `vectorized` is std::true_type for the element types with SIMD kernels (double and float);
+         * kernels dispatch on it, so the packet members are only ever used for those two.
+         * */
+        template <class T>
+        struct SimdTraits {
+            typedef std::false_type vectorized;
+            typedef T sse2_type;
+            typedef T avx2_type;
+            typedef T avx512_type;
+        };
+
+#if NUMPP_X86_SIMD
+        template <>
+        struct SimdTraits<double> {
+            typedef std::true_type vectorized;
+            typedef __m128d sse2_type;
+            typedef __m256d avx2_type;
+            typedef __m512d avx512_type;
+            typedef __mmask8 avx512_mask;
+
+            /*
+             * Elements per register.
+             * */
+            static const size_t sse2_width = 2;
+            static const size_t avx2_width = 4;
+            static const size_t avx512_width = 8;
+
+            __attribute__((target("sse2"))) static __m128d sse2_load(const double* p) { return _mm_loadu_pd(p); }
+            __attribute__((target("sse2"))) static void sse2_store(double* p, __m128d v) { _mm_storeu_pd(p, v); }
+            __attribute__((target("sse2"))) static __m128d sse2_set1(double v) { return _mm_set1_pd(v); }
+
+            __attribute__((target("avx2"))) static __m256d avx2_load(const double* p) { return _mm256_loadu_pd(p); }
+            __attribute__((target("avx2"))) static void avx2_store(double* p, __m256d v) { _mm256_storeu_pd(p, v); }
+            __attribute__((target("avx2"))) static __m256d avx2_set1(double v) { return _mm256_set1_pd(v); }
+            __attribute__((target("avx2,fma"))) static __m256d avx2_fmadd(__m256d a, __m256d b, __m256d c) {
+                return _mm256_fmadd_pd(a, b, c);
+            }
+            __attribute__((target("avx2,fma"))) static __m256d avx2_fnmadd(__m256d a, __m256d b, __m256d c) {
+                return _mm256_fnmadd_pd(a, b, c);
+            }
+
+            __attribute__((target("avx512f"))) static __m512d avx512_load(const double* p) { return _mm512_loadu_pd(p); }
+            __attribute__((target("avx512f"))) static void avx512_store(double* p, __m512d v) { _mm512_storeu_pd(p, v); }
+            __attribute__((target("avx512f"))) static __m512d avx512_set1(double v) { return _mm512_set1_pd(v); }
+            __attribute__((target("avx512f"))) static __m512d avx512_fmadd(__m512d a, __m512d b, __m512d c) {
+                return _mm512_fmadd_pd(a, b, c);
+            }
+            __attribute__((target("avx512f"))) static __m512d avx512_fnmadd(__m512d a, __m512d b, __m512d c) {
+                return _mm512_fnmadd_pd(a, b, c);
+            }
+
+            /*
+             * The first n (< avx512_width) lanes; masked loads and stores finish a tail without a scalar loop.
+             * */
+            static __mmask8 avx512_tail_mask(size_t n) { return static_cast<__mmask8>((1u << n) - 1); }
+            __attribute__((target("avx512f"))) static __m512d avx512_mask_load(__mmask8 mask, const double* p) {
+                return _mm512_maskz_loadu_pd(mask, p);
+            }
+            __attribute__((target("avx512f"))) static void avx512_mask_store(double* p, __mmask8 mask, __m512d v) {
+                _mm512_mask_storeu_pd(p, mask, v);
+            }
+
+            /*
+             * Lanes of `a` where the corresponding bit of the mask is set and lanes of `b` elsewhere.
+             * AVX2 has no mask registers: avx2_lanes turns the low bits of `bits` into a lane mask for blends and masked stores.
+             * */
+            __attribute__((target("avx512f"))) static __m512d avx512_select(__mmask8 mask, __m512d a, __m512d b) {
+                return _mm512_mask_blend_pd(mask, b, a);
+            }
+            __attribute__((target("avx2"))) static __m256i avx2_lanes(unsigned bits) {
+                const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+                return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), lane_bits), lane_bits);
+            }
+            __attribute__((target("avx2"))) static __m256d avx2_select(__m256i lanes, __m256d a, __m256d b) {
+                return _mm256_blendv_pd(b, a, _mm256_castsi256_pd(lanes));
+            }
+            __attribute__((target("avx2"))) static void avx2_mask_store(double* p, __m256i lanes, __m256d v) {
+                _mm256_maskstore_pd(p, lanes, v);
+            }
+        };
+
+        template <>
+        struct SimdTraits<float> {
+            typedef std::true_type vectorized;
+            typedef __m128 sse2_type;
+            typedef __m256 avx2_type;
+            typedef __m512 avx512_type;
+            typedef __mmask16 avx512_mask;
+
+            static const size_t sse2_width = 4;
+            static const size_t avx2_width = 8;
+            static const size_t avx512_width = 16;
+
+            __attribute__((target("sse2"))) static __m128 sse2_load(const float* p) { return _mm_loadu_ps(p); }
+            __attribute__((target("sse2"))) static void sse2_store(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+            __attribute__((target("sse2"))) static __m128 sse2_set1(float v) { return _mm_set1_ps(v); }
+
+            __attribute__((target("avx2"))) static __m256 avx2_load(const float* p) { return _mm256_loadu_ps(p); }
+            __attribute__((target("avx2"))) static void avx2_store(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+            __attribute__((target("avx2"))) static __m256 avx2_set1(float v) { return _mm256_set1_ps(v); }
+            __attribute__((target("avx2,fma"))) static __m256 avx2_fmadd(__m256 a, __m256 b, __m256 c) {
+                return _mm256_fmadd_ps(a, b, c);
+            }
+            __attribute__((target("avx2,fma"))) static __m256 avx2_fnmadd(__m256 a, __m256 b, __m256 c) {
+                return _mm256_fnmadd_ps(a, b, c);
+            }
+
+            __attribute__((target("avx512f"))) static __m512 avx512_load(const float* p) { return _mm512_loadu_ps(p); }
+            __attribute__((target("avx512f"))) static void avx512_store(float* p, __m512 v) { _mm512_storeu_ps(p, v); }
+            __attribute__((target("avx512f"))) static __m512 avx512_set1(float v) { return _mm512_set1_ps(v); }
+            __attribute__((target("avx512f"))) static __m512 avx512_fmadd(__m512 a, __m512 b, __m512 c) {
+                return _mm512_fmadd_ps(a, b, c);
+            }
+            __attribute__((target("avx512f"))) static __m512 avx512_fnmadd(__m512 a, __m512 b, __m512 c) {
+                return _mm512_fnmadd_ps(a, b, c);
+            }
+
+            static __mmask16 avx512_tail_mask(size_t n) { return static_cast<__mmask16>((1u << n) - 1); }
+            __attribute__((target("avx512f"))) static __m512 avx512_mask_load(__mmask16 mask, const float* p) {
+                return _mm512_maskz_loadu_ps(mask, p);
+            }
+            __attribute__((target("avx512f"))) static void avx512_mask_store(float* p, __mmask16 mask, __m512 v) {
+                _mm512_mask_storeu_ps(p, mask, v);
+            }
+
+            __attribute__((target("avx512f"))) static __m512 avx512_select(__mmask16 mask, __m512 a, __m512 b) {
+                return _mm512_mask_blend_ps(mask, b, a);
+            }
+            __attribute__((target("avx2"))) static __m256i avx2_lanes(unsigned bits) {
+                const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+                return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), lane_bits), lane_bits);
+            }
+            __attribute__((target("avx2"))) static __m256 avx2_select(__m256i lanes, __m256 a, __m256 b) {
+                return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(lanes));
+            }
+            __attribute__((target("avx2"))) static void avx2_mask_store(float* p, __m256i lanes, __m256 v) {
+                _mm256_maskstore_ps(p, lanes, v);
+            }
+        };
+#endif
+
+        /*
+         * Element-wise binary operations. Each one provides a scalar form and one form per SIMD level and packet type,
+         * so a single loop template can be instantiated for every instruction set and element type.
+         * */
+        struct AddOp {
+            template <class T>
+            static T scalar(T a, T b) { return a + b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_add_pd(a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_add_ps(a, b); }
+#endif
+        };
+
+        struct SubOp {
+            template <class T>
+            static T scalar(T a, T b) { return a - b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_sub_pd(a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_sub_ps(a, b); }
+#endif
+        };
+
+        struct MulOp {
+            template <class T>
+            static T scalar(T a, T b) { return a * b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_mul_pd(a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_mul_ps(a, b); }
+#endif
+        };
+
+        struct DivOp {
+            template <class T>
+            static T scalar(T a, T b) { return a / b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_div_pd(a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_div_ps(a, b); }
+#endif
+        };
+
+        struct NegateOp {
+            template <class T>
+            static T scalar(T a) { return -a; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a) { return _mm_mul_pd(a, _mm_set1_pd(-1.0)); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a) { return _mm256_mul_pd(a, _mm256_set1_pd(-1.0)); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a) { return _mm512_mul_pd(a, _mm512_set1_pd(-1.0)); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a) { return _mm_mul_ps(a, _mm_set1_ps(-1.0f)); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a) { return _mm256_mul_ps(a, _mm256_set1_ps(-1.0f)); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a) { return _mm512_mul_ps(a, _mm512_set1_ps(-1.0f)); }
+#endif
+        };
+
+        /*
+         * The smaller and the larger of two elements, for the reductions. `prefers(a, b)` tells whether `b` replaces `a`;
+         * ties keep `a`, so the first of several equal extremes wins. Results are unspecified when NaN is involved.
+         * The AVX-512 forms use the zero-masking intrinsics with a full mask, which GCC does not flag as reading undefined lanes.
+         * */
+        struct MinOp {
+            template <class T>
+            static bool prefers(T a, T b) { return b < a; }
+            template <class T>
+            static T scalar(T a, T b) { return prefers(a, b) ? b : a; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_min_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_min_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_maskz_min_ps(0xFFFF, a, b); }
+#endif
+        };
+
+        struct MaxOp {
+            template <class T>
+            static bool prefers(T a, T b) { return a < b; }
+            template <class T>
+            static T scalar(T a, T b) { return prefers(a, b) ? b : a; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static __m128d sse2(__m128d a, __m128d b) { return _mm_max_pd(a, b); }
+            __attribute__((target("avx2"))) static __m256d avx2(__m256d a, __m256d b) { return _mm256_max_pd(a, b); }
+            __attribute__((target("avx512f"))) static __m512d avx512(__m512d a, __m512d b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+            __attribute__((target("sse2"))) static __m128 sse2(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+            __attribute__((target("avx2"))) static __m256 avx2(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+            __attribute__((target("avx512f"))) static __m512 avx512(__m512 a, __m512 b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+#endif
+        };
+
+        /*
+         * Element-wise comparisons, for the masks. The SIMD forms return one bit per lane (bit l for lane l).
+         * As with the scalar operators, every comparison involving NaN is false except NotEqualOp.
+         * */
+        struct LessOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a < b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+#endif
+        };
+
+        struct LessEqualOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a <= b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmple_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+#endif
+        };
+
+        struct GreaterOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a > b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+#endif
+        };
+
+        struct GreaterEqualOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a >= b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpge_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+#endif
+        };
+
+        struct EqualOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a == b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+#endif
+        };
+
+        struct NotEqualOp {
+            template <class T>
+            static bool scalar(T a, T b) { return a != b; }
+#if NUMPP_X86_SIMD
+            __attribute__((target("sse2"))) static unsigned sse2(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpneq_pd(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ); }
+            __attribute__((target("sse2"))) static unsigned sse2(__m128 a, __m128 b) { return _mm_movemask_ps(_mm_cmpneq_ps(a, b)); }
+            __attribute__((target("avx2"))) static unsigned avx2(__m256 a, __m256 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ)); }
+            __attribute__((target("avx512f"))) static unsigned avx512(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+#endif
+        };
+
+        /*
+         * Masks store 64 elements per word, element i at bit i % MASK_WORD_BITS of word i / MASK_WORD_BITS.
+         * */
+        const size_t MASK_WORD_BITS = 64;
+
+        size_t mask_word_count(size_t n) {
+            return (n + MASK_WORD_BITS - 1) / MASK_WORD_BITS;
+        }
+
+        /*
+         * The `n` (1 to 64) bits starting at bit i, in the low bits of the result.
+         * */
+        uint64_t mask_bits(const uint64_t* words, size_t i, size_t n) {
+            const size_t word = i / MASK_WORD_BITS;
+            const size_t shift = i % MASK_WORD_BITS;
+            uint64_t bits = words[word] >> shift;
+            if (shift + n > MASK_WORD_BITS) {
+                bits |= words[word + 1] << (MASK_WORD_BITS - shift);
+            }
+            return n == MASK_WORD_BITS ? bits : bits & ((uint64_t(1) << n) - 1);
+        }
+
+        /*
+         * Set the `n` bits starting at bit i to the low bits of `bits` (whose other bits are zero).
+         * The target bits must be zero.
+         * */
+        void put_mask_bits(uint64_t* words, size_t i, uint64_t bits, size_t n) {
+            const size_t word = i / MASK_WORD_BITS;
+            const size_t shift = i % MASK_WORD_BITS;
+            words[word] |= bits << shift;
+            if (shift + n > MASK_WORD_BITS) {
+                words[word + 1] |= bits >> (MASK_WORD_BITS - shift);
+            }
+        }
+
+        /*
+         * Index of the lowest set bit of a non-zero word.
+         * */
+        size_t lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+            return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+            size_t index = 0;
+            while ((bits & 1) == 0) {
+                bits >>= 1;
+                index++;
+            }
+            return index;
+#endif
+        }
+
+        size_t popcount_portable(uint64_t bits) {
+            bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+            bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+            bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return static_cast<size_t>((bits * 0x0101010101010101ULL) >> 56);
+        }
+
+        size_t count_bits_scalar(size_t n, const uint64_t* words) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++) {
+                count += popcount_portable(words[i]);
+            }
+            return count;
+        }
+
+#if NUMPP_X86_SIMD
+        __attribute__((target("popcnt")))
+        size_t count_bits_popcnt(size_t n, const uint64_t* words) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++) {
+                count += static_cast<size_t>(__builtin_popcountll(words[i]));
+            }
+            return count;
+        }
+#endif
+
+        /*
+         * Number of set bits in `n` words, with the POPCNT instruction when the CPU has it.
+         * */
+        size_t count_bits(size_t n, const uint64_t* words) {
+#if NUMPP_X86_SIMD
+            static const bool has_popcnt = (__builtin_cpu_init(), __builtin_cpu_supports("popcnt"));
+            if (has_popcnt) {
+                return count_bits_popcnt(n, words);
+            }
+#endif
+            return count_bits_scalar(n, words);
+        }
+
+        enum ElementwiseOp {
+            OP_ADD,
+            OP_SUB,
+            OP_MUL,
+            OP_DIV
+        };
+
+        /*
+         * out[i] = x[i] op y[i] and out[i] = x[i] op y over contiguous spans of `n` elements.
+         * `out` may alias `x` or `y`.
+         * */
+        template <class Op, class T>
+        void binary_scalar(size_t n, const T* x, const T* y, T* out) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = Op::scalar(x[i], y[i]);
+            }
+        }
+
+        template <class Op, class T>
+        void binary_with_scalar_scalar(size_t n, const T* x, T y, T* out) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = Op::scalar(x[i], y);
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        template <class Op, class T>
+        __attribute__((target("sse2")))
+        void binary_sse2(size_t n, const T* x, const T* y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::sse2_width;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                S::sse2_store(out + i, Op::sse2(S::sse2_load(x + i), S::sse2_load(y + i)));
+                S::sse2_store(out + i + w, Op::sse2(S::sse2_load(x + i + w), S::sse2_load(y + i + w)));
+            }
+            for (; i < n; i++) {
+                out[i] = Op::scalar(x[i], y[i]);
+            }
+        }
+
+        template <class Op, class T>
+        __attribute__((target("sse2")))
+        void binary_with_scalar_sse2(size_t n, const T* x, T y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::sse2_width;
+            const typename S::sse2_type y_vec = S::sse2_set1(y);
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                S::sse2_store(out + i, Op::sse2(S::sse2_load(x + i), y_vec));
+                S::sse2_store(out + i + w, Op::sse2(S::sse2_load(x + i + w), y_vec));
+            }
+            for (; i < n; i++) {
+                out[i] = Op::scalar(x[i], y);
+            }
+        }
+
+        template <class Op, class T>
+        __attribute__((target("avx2")))
+        void binary_avx2(size_t n, const T* x, const T* y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                S::avx2_store(out + i, Op::avx2(S::avx2_load(x + i), S::avx2_load(y + i)));
+                S::avx2_store(out + i + w, Op::avx2(S::avx2_load(x + i + w), S::avx2_load(y + i + w)));
+            }
+            for (; i < n; i++) {
+                out[i] = Op::scalar(x[i], y[i]);
+            }
+        }
+
+        template <class Op, class T>
+        __attribute__((target("avx2")))
+        void binary_with_scalar_avx2(size_t n, const T* x, T y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            const typename S::avx2_type y_vec = S::avx2_set1(y);
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                S::avx2_store(out + i, Op::avx2(S::avx2_load(x + i), y_vec));
+                S::avx2_store(out + i + w, Op::avx2(S::avx2_load(x + i + w), y_vec));
+            }
+            for (; i < n; i++) {
+                out[i] = Op::scalar(x[i], y);
+            }
+        }
+
+        template <class Op, class T>
+        __attribute__((target("avx512f")))
+        void binary_avx512(size_t n, const T* x, const T* y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                S::avx512_store(out + i, Op::avx512(S::avx512_load(x + i), S::avx512_load(y + i)));
+            }
+            if (i < n) {
+                const typename S::avx512_mask mask = S::avx512_tail_mask(n - i);
+                S::avx512_mask_store(out + i, mask, Op::avx512(S::avx512_mask_load(mask, x + i),
+                                                               S::avx512_mask_load(mask, y + i)));
+            }
+        }
+
+        template <class Op, class T>
+        __attribute__((target("avx512f")))
+        void binary_with_scalar_avx512(size_t n, const T* x, T y, T* out) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            const typename S::avx512_type y_vec = S::avx512_set1(y);
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                S::avx512_store(out + i, Op::avx512(S::avx512_load(x + i), y_vec));
+            }
+            if (i < n) {
+                const typename S::avx512_mask mask = S::avx512_tail_mask(n - i);
+                S::avx512_mask_store(out + i, mask, Op::avx512(S::avx512_mask_load(mask, x + i), y_vec));
+            }
+        }
+#endif
+
+        template <class T>
+        using BinaryKernel = void (*)(size_t n, const T* x, const T* y, T* out);
+
+        template <class T>
+        using BinaryWithScalarKernel = void (*)(size_t n, const T* x, T y, T* out);
+
+        /*
+         * The last parameter is SimdTraits<T>::vectorized.
+         * */
+        template <class Op, class T>
+        BinaryKernel<T> select_binary_kernel(SimdLevel level, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (level) {
+                case SIMD_AVX512:
+                    return binary_avx512<Op, T>;
+                case SIMD_AVX2:
+                    return binary_avx2<Op, T>;
+                case SIMD_SSE2:
+                    return binary_sse2<Op, T>;
+                default:
+                    break;
+            }
+#endif
+            return binary_scalar<Op, T>;
+        }
+
+        template <class Op, class T>
+        BinaryKernel<T> select_binary_kernel(SimdLevel, std::false_type) {
+            return binary_scalar<Op, T>;
+        }
+
+        template <class Op, class T>
+        BinaryWithScalarKernel<T> select_binary_with_scalar_kernel(SimdLevel level, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (level) {
+                case SIMD_AVX512:
+                    return binary_with_scalar_avx512<Op, T>;
+                case SIMD_AVX2:
+                    return binary_with_scalar_avx2<Op, T>;
+                case SIMD_SSE2:
+                    return binary_with_scalar_sse2<Op, T>;
+                default:
+                    break;
+            }
+#endif
+            return binary_with_scalar_scalar<Op, T>;
+        }
+
+        template <class Op, class T>
+        BinaryWithScalarKernel<T> select_binary_with_scalar_kernel(SimdLevel, std::false_type) {
+            return binary_with_scalar_scalar<Op, T>;
+        }
+
+        template <class T>
+        BinaryKernel<T> binary_kernel(ElementwiseOp op, SimdLevel level = simd_level()) {
+            typedef typename SimdTraits<T>::vectorized vectorized;
+            switch (op) {
+                case OP_ADD:
+                    return select_binary_kernel<AddOp, T>(level, vectorized());
+                case OP_SUB:
+                    return select_binary_kernel<SubOp, T>(level, vectorized());
+                case OP_MUL:
+                    return select_binary_kernel<MulOp, T>(level, vectorized());
+                default:
+                    return select_binary_kernel<DivOp, T>(level, vectorized());
+            }
+        }
+
+        template <class T>
+        BinaryWithScalarKernel<T> binary_with_scalar_kernel(ElementwiseOp op, SimdLevel level = simd_level()) {
+            typedef typename SimdTraits<T>::vectorized vectorized;
+            switch (op) {
+                case OP_ADD:
+                    return select_binary_with_scalar_kernel<AddOp, T>(level, vectorized());
+                case OP_SUB:
+                    return select_binary_with_scalar_kernel<SubOp, T>(level, vectorized());
+                case OP_MUL:
+                    return select_binary_with_scalar_kernel<MulOp, T>(level, vectorized());
+                default:
+                    return select_binary_with_scalar_kernel<DivOp, T>(level, vectorized());
+            }
+        }
+
+        /*
+         * Whether the address ranges spanned by two strided blocks of memory intersect.
+         * */
+        template <class T>
+        bool blocks_intersect(const T* a, size_t a_rows, size_t a_cols, size_t a_stride,
+                              const T* b, size_t b_rows, size_t b_cols, size_t b_stride) {
+            if (a_rows == 0 || a_cols == 0 || b_rows == 0 || b_cols == 0) {
+                return false;
+            }
+            const uintptr_t a_begin = reinterpret_cast<uintptr_t>(a);
+            const uintptr_t a_end = reinterpret_cast<uintptr_t>(a + (a_rows - 1) * a_stride + a_cols);
+            const uintptr_t b_begin = reinterpret_cast<uintptr_t>(b);
+            const uintptr_t b_end = reinterpret_cast<uintptr_t>(b + (b_rows - 1) * b_stride + b_cols);
+            return a_begin < b_end && b_begin < a_end;
+        }
+
+        /*
+         * Whether two strided blocks of memory share elements without being laid out exactly on top of each other.
+         * Element-wise updates from one block into the other are only safe without a temporary when this is false.
+         * */
+        template <class T>
+        bool blocks_overlap(const T* a, size_t a_rows, size_t a_cols, size_t a_stride,
+                            const T* b, size_t b_rows, size_t b_cols, size_t b_stride) {
+            if (a == b && a_stride == b_stride) {
+                return false;
+            }
+            return blocks_intersect(a, a_rows, a_cols, a_stride, b, b_rows, b_cols, b_stride);
+        }
+
+        /*
+         * Dot product of two vectors of size `n` with strides `inc_x` and `inc_y`.
+         * Four independent accumulators hide the latency of the additions.
+         * */
+        template <class T>
+        T dot(size_t n, const T* x, size_t inc_x, const T* y, size_t inc_y) {
+            T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+            size_t i = 0;
+            if (inc_x == 1 && inc_y == 1) {
+                for (; i + 4 <= n; i += 4) {
+                    acc0 += x[i] * y[i];
+                    acc1 += x[i + 1] * y[i + 1];
+                    acc2 += x[i + 2] * y[i + 2];
+                    acc3 += x[i + 3] * y[i + 3];
+                }
+            }
+            for (; i < n; i++) {
+                acc0 += x[i * inc_x] * y[i * inc_y];
+            }
+            return (acc0 + acc1) + (acc2 + acc3);
+        }
+
+        /*
+         * y += alpha * x for contiguous x and y, in the widest packets the CPU supports.
+         * */
+        template <class T>
+        void axpy_scalar(size_t n, T alpha, const T* x, T* y) {
+            for (size_t i = 0; i < n; i++) {
+                y[i] += alpha * x[i];
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        void axpy_avx2(size_t n, T alpha, const T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            const typename S::avx2_type a = S::avx2_set1(alpha);
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                S::avx2_store(y + i, S::avx2_fmadd(a, S::avx2_load(x + i), S::avx2_load(y + i)));
+                S::avx2_store(y + i + w, S::avx2_fmadd(a, S::avx2_load(x + i + w), S::avx2_load(y + i + w)));
+            }
+            for (; i < n; i++) {
+                y[i] += alpha * x[i];
+            }
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        void axpy_avx512(size_t n, T alpha, const T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            const typename S::avx512_type a = S::avx512_set1(alpha);
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                S::avx512_store(y + i, S::avx512_fmadd(a, S::avx512_load(x + i), S::avx512_load(y + i)));
+            }
+            if (i < n) {
+                const typename S::avx512_mask mask = S::avx512_tail_mask(n - i);
+                S::avx512_mask_store(y + i, mask, S::avx512_fmadd(a, S::avx512_mask_load(mask, x + i),
+                                                                  S::avx512_mask_load(mask, y + i)));
+            }
+        }
+#endif
+
+        template <class T>
+        void axpy_contiguous(size_t n, T alpha, const T* x, T* y, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    axpy_avx512(n, alpha, x, y);
+                    return;
+                case SIMD_AVX2:
+                    axpy_avx2(n, alpha, x, y);
+                    return;
+                default:
+                    break;
+            }
+#endif
+            axpy_scalar(n, alpha, x, y);
+        }
+
+        template <class T>
+        void axpy_contiguous(size_t n, T alpha, const T* x, T* y, std::false_type) {
+            axpy_scalar(n, alpha, x, y);
+        }
+
+        /*
+         * y += alpha * x, where x has stride `inc_x` and y is contiguous.
+         * */
+        template <class T>
+        void axpy(size_t n, T alpha, const T* x, size_t inc_x, T* y) {
+            if (inc_x == 1) {
+                axpy_contiguous(n, alpha, x, y, typename SimdTraits<T>::vectorized());
+            }
+            else {
+                for (size_t i = 0; i < n; i++) {
+                    y[i] += alpha * x[i * inc_x];
+                }
+            }
+        }
+
+        /*
+         * Fold the contiguous span x[0, n) into `init` with Op (AddOp, MinOp or MaxOp).
+         * Every accumulator starts from `init`, so it must be the identity of Op (zero for AddOp)
+         * or, for MinOp and MaxOp, one of the elements.
+         * */
+        template <class Op, class T>
+        T reduce_scalar(size_t n, const T* x, T init) {
+            T acc0 = init, acc1 = init, acc2 = init, acc3 = init;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc0 = Op::scalar(acc0, x[i]);
+                acc1 = Op::scalar(acc1, x[i + 1]);
+                acc2 = Op::scalar(acc2, x[i + 2]);
+                acc3 = Op::scalar(acc3, x[i + 3]);
+            }
+            for (; i < n; i++) {
+                acc0 = Op::scalar(acc0, x[i]);
+            }
+            return Op::scalar(Op::scalar(acc0, acc1), Op::scalar(acc2, acc3));
+        }
+
+        /*
+         * Sum of |x[i] - center|^2 over a contiguous span, with four independent accumulators.
+         * */
+        template <class T>
+        T squared_magnitude(T x) {
+            return x * x;
+        }
+
+        template <class T>
+        T squared_magnitude(const std::complex<T>& x) {
+            return std::norm(x);
+        }
+
+        template <class T>
+        typename Magnitude<T>::type squared_deviation_scalar(size_t n, const T* x, T center) {
+            typedef typename Magnitude<T>::type M;
+            M acc0 = M(), acc1 = M(), acc2 = M(), acc3 = M();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc0 += squared_magnitude(x[i] - center);
+                acc1 += squared_magnitude(x[i + 1] - center);
+                acc2 += squared_magnitude(x[i + 2] - center);
+                acc3 += squared_magnitude(x[i + 3] - center);
+            }
+            for (; i < n; i++) {
+                acc0 += squared_magnitude(x[i] - center);
+            }
+            return (acc0 + acc1) + (acc2 + acc3);
+        }
+
+        /*
+         * Combine the lanes of a register, stored to memory, with Op.
+         * */
+        template <class Op, class T>
+        T fold_lanes(const T* lanes, size_t width) {
+            T res = lanes[0];
+            for (size_t l = 1; l < width; l++) {
+                res = Op::scalar(res, lanes[l]);
+            }
+            return res;
+        }
+
+#if NUMPP_X86_SIMD
+        template <class Op, class T>
+        __attribute__((target("avx2")))
+        T reduce_avx2(size_t n, const T* x, T init) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            typename S::avx2_type acc0 = S::avx2_set1(init), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+            size_t i = 0;
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = Op::avx2(acc0, S::avx2_load(x + i));
+                acc1 = Op::avx2(acc1, S::avx2_load(x + i + w));
+                acc2 = Op::avx2(acc2, S::avx2_load(x + i + 2 * w));
+                acc3 = Op::avx2(acc3, S::avx2_load(x + i + 3 * w));
+            }
+            for (; i + w <= n; i += w) {
+                acc0 = Op::avx2(acc0, S::avx2_load(x + i));
+            }
+            T lanes[S::avx2_width];
+            S::avx2_store(lanes, Op::avx2(Op::avx2(acc0, acc1), Op::avx2(acc2, acc3)));
+            T res = fold_lanes<Op>(lanes, w);
+            for (; i < n; i++) {
+                res = Op::scalar(res, x[i]);
+            }
+            return res;
+        }
+
+        template <class Op, class T>
+        __attribute__((target("avx512f")))
+        T reduce_avx512(size_t n, const T* x, T init) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            typename S::avx512_type acc0 = S::avx512_set1(init), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+            size_t i = 0;
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = Op::avx512(acc0, S::avx512_load(x + i));
+                acc1 = Op::avx512(acc1, S::avx512_load(x + i + w));
+                acc2 = Op::avx512(acc2, S::avx512_load(x + i + 2 * w));
+                acc3 = Op::avx512(acc3, S::avx512_load(x + i + 3 * w));
+            }
+            for (; i + w <= n; i += w) {
+                acc0 = Op::avx512(acc0, S::avx512_load(x + i));
+            }
+            T lanes[S::avx512_width];
+            S::avx512_store(lanes, Op::avx512(Op::avx512(acc0, acc1), Op::avx512(acc2, acc3)));
+            T res = fold_lanes<Op>(lanes, w);
+            for (; i < n; i++) {
+                res = Op::scalar(res, x[i]);
+            }
+            return res;
+        }
+
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        T squared_deviation_avx2(size_t n, const T* x, T center) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            const typename S::avx2_type c = S::avx2_set1(center);
+            typename S::avx2_type acc0 = S::avx2_set1(T()), acc1 = acc0;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                const typename S::avx2_type d0 = SubOp::avx2(S::avx2_load(x + i), c);
+                const typename S::avx2_type d1 = SubOp::avx2(S::avx2_load(x + i + w), c);
+                acc0 = S::avx2_fmadd(d0, d0, acc0);
+                acc1 = S::avx2_fmadd(d1, d1, acc1);
+            }
+            T lanes[S::avx2_width];
+            S::avx2_store(lanes, AddOp::avx2(acc0, acc1));
+            T res = fold_lanes<AddOp>(lanes, w);
+            for (; i < n; i++) {
+                res += (x[i] - center) * (x[i] - center);
+            }
+            return res;
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        T squared_deviation_avx512(size_t n, const T* x, T center) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            const typename S::avx512_type c = S::avx512_set1(center);
+            typename S::avx512_type acc0 = S::avx512_set1(T()), acc1 = acc0;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                const typename S::avx512_type d0 = SubOp::avx512(S::avx512_load(x + i), c);
+                const typename S::avx512_type d1 = SubOp::avx512(S::avx512_load(x + i + w), c);
+                acc0 = S::avx512_fmadd(d0, d0, acc0);
+                acc1 = S::avx512_fmadd(d1, d1, acc1);
+            }
+            if (i + w <= n) {
+                const typename S::avx512_type d = SubOp::avx512(S::avx512_load(x + i), c);
+                acc0 = S::avx512_fmadd(d, d, acc0);
+                i += w;
+            }
+            T lanes[S::avx512_width];
+            S::avx512_store(lanes, AddOp::avx512(acc0, acc1));
+            T res = fold_lanes<AddOp>(lanes, w);
+            for (; i < n; i++) {
+                res += (x[i] - center) * (x[i] - center);
+            }
+            return res;
+        }
+
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        T inner_product_avx2(size_t n, const T* x, const T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            typename S::avx2_type acc0 = S::avx2_set1(T()), acc1 = acc0;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                acc0 = S::avx2_fmadd(S::avx2_load(x + i), S::avx2_load(y + i), acc0);
+                acc1 = S::avx2_fmadd(S::avx2_load(x + i + w), S::avx2_load(y + i + w), acc1);
+            }
+            T lanes[S::avx2_width];
+            S::avx2_store(lanes, AddOp::avx2(acc0, acc1));
+            T res = fold_lanes<AddOp>(lanes, w);
+            for (; i < n; i++) {
+                res += x[i] * y[i];
+            }
+            return res;
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        T inner_product_avx512(size_t n, const T* x, const T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            typename S::avx512_type acc0 = S::avx512_set1(T()), acc1 = acc0;
+            size_t i = 0;
+            for (; i + 2 * w <= n; i += 2 * w) {
+                acc0 = S::avx512_fmadd(S::avx512_load(x + i), S::avx512_load(y + i), acc0);
+                acc1 = S::avx512_fmadd(S::avx512_load(x + i + w), S::avx512_load(y + i + w), acc1);
+            }
+            if (i + w <= n) {
+                acc0 = S::avx512_fmadd(S::avx512_load(x + i), S::avx512_load(y + i), acc0);
+                i += w;
+            }
+            if (i < n) {
+                const typename S::avx512_mask mask = S::avx512_tail_mask(n - i);
+                acc1 = S::avx512_fmadd(S::avx512_mask_load(mask, x + i), S::avx512_mask_load(mask, y + i), acc1);
+            }
+            T lanes[S::avx512_width];
+            S::avx512_store(lanes, AddOp::avx512(acc0, acc1));
+            return fold_lanes<AddOp>(lanes, w);
+        }
+#endif
+
+        template <class Op, class T>
+        T reduce(size_t n, const T* x, T init, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    return reduce_avx512<Op>(n, x, init);
+                case SIMD_AVX2:
+                    return reduce_avx2<Op>(n, x, init);
+                default:
+                    break;
+            }
+#endif
+            return reduce_scalar<Op>(n, x, init);
+        }
+
+        template <class Op, class T>
+        T reduce(size_t n, const T* x, T init, std::false_type) {
+            return reduce_scalar<Op>(n, x, init);
+        }
+
+        template <class Op, class T>
+        T reduce(size_t n, const T* x, T init) {
+            return reduce<Op>(n, x, init, typename SimdTraits<T>::vectorized());
+        }
+
+        template <class T>
+        T squared_deviation(size_t n, const T* x, T center, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    return squared_deviation_avx512(n, x, center);
+                case SIMD_AVX2:
+                    return squared_deviation_avx2(n, x, center);
+                default:
+                    break;
+            }
+#endif
+            return squared_deviation_scalar(n, x, center);
+        }
+
+        template <class T>
+        typename Magnitude<T>::type squared_deviation(size_t n, const T* x, T center, std::false_type) {
+            return squared_deviation_scalar(n, x, center);
+        }
+
+        template <class T>
+        T inner_product(size_t n, const T* x, const T* y, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    return inner_product_avx512(n, x, y);
+                case SIMD_AVX2:
+                    return inner_product_avx2(n, x, y);
+                default:
+                    break;
+            }
+#endif
+            return dot(n, x, 1, y, 1);
+        }
+
+        template <class T>
+        T inner_product(size_t n, const T* x, const T* y, std::false_type) {
+            return dot(n, x, 1, y, 1);
+        }
+
+        /*
+         * Spans longer than PAIRWISE_BLOCK elements are halved recursively and the two halves reduced separately,
+         * so the rounding error of a sum grows with log(n) rather than n at the cost of one extra addition per block.
+         * */
+        const size_t PAIRWISE_BLOCK = 256;
+
+        /*
+         * Reduce [begin, end) pairwise, calling `block(block_begin, block_end)` on spans of at most PAIRWISE_BLOCK indexes.
+         * Split points are multiples of PAIRWISE_BLOCK, so the SIMD loops mostly see whole blocks.
+         * */
+        template <class R, class Block>
+        R pairwise(size_t begin, size_t end, Block block) {
+            if (end - begin <= PAIRWISE_BLOCK) {
+                return block(begin, end);
+            }
+            const size_t half = ((end - begin) / PAIRWISE_BLOCK + 1) / 2 * PAIRWISE_BLOCK;
+            return pairwise<R>(begin, begin + half, block) + pairwise<R>(begin + half, end, block);
+        }
+
+        /*
+         * Sum of the contiguous span x[0, n).
+         * */
+        template <class T>
+        T pairwise_sum(size_t n, const T* x) {
+            return pairwise<T>(0, n, [x](size_t begin, size_t end) {
+                return reduce<AddOp>(end - begin, x + begin, T());
+            });
+        }
+
+        /*
+         * Sum of |x[i] - center|^2 over the contiguous span x[0, n).
+         * */
+        template <class T>
+        typename Magnitude<T>::type pairwise_squared_deviation(size_t n, const T* x, T center) {
+            return pairwise<typename Magnitude<T>::type>(0, n, [x, center](size_t begin, size_t end) {
+                return squared_deviation(end - begin, x + begin, center, typename SimdTraits<T>::vectorized());
+            });
+        }
+
+        /*
+         * Sum of x[i] * y[i] over the contiguous spans x[0, n) and y[0, n).
+         * */
+        template <class T>
+        T pairwise_inner_product(size_t n, const T* x, const T* y) {
+            return pairwise<T>(0, n, [x, y](size_t begin, size_t end) {
+                return inner_product(end - begin, x + begin, y + begin, typename SimdTraits<T>::vectorized());
+            });
+        }
+
+        /*
+         * Blocks of at most PAIRWISE_ROWS rows are folded row by row, taller blocks are halved like in `pairwise`.
+         * */
+        const size_t PAIRWISE_ROWS = 16;
+
+        template <class Op, class T>
+        void fold_columns_pairwise(size_t rows, size_t cols, const T* x, size_t lda, T* out, T* scratch,
+                                   BinaryKernel<T> kernel) {
+            if (rows <= PAIRWISE_ROWS) {
+                std::copy(x, x + cols, out);
+                for (size_t r = 1; r < rows; r++) {
+                    kernel(cols, out, x + r * lda, out);
+                }
+                return;
+            }
+            const size_t half = rows / 2;
+            fold_columns_pairwise<Op>(half, cols, x, lda, out, scratch, kernel);
+            fold_columns_pairwise<Op>(rows - half, cols, x + half * lda, lda, scratch, scratch + cols, kernel);
+            kernel(cols, out, scratch, out);
+        }
+
+        /*
+         * out[c] = Op(x[0][c], x[1][c], ..., x[rows - 1][c]) for a rows by cols block with row stride `lda` and rows >= 1.
+         * Whole rows are combined with the element-wise kernels, pairwise like `pairwise_sum`.
+         * */
+        template <class Op, class T>
+        void fold_columns(size_t rows, size_t cols, const T* x, size_t lda, T* out) {
+            size_t depth = 0;
+            for (size_t r = rows; r > PAIRWISE_ROWS; r -= r / 2) {
+                depth++;
+            }
+            BasicAlignedBuffer<T> scratch(depth * cols, pool_resource());
+            fold_columns_pairwise<Op>(rows, cols, x, lda, out, scratch.data(),
+                                      select_binary_kernel<Op, T>(simd_level(), typename SimdTraits<T>::vectorized()));
+        }
+
+        /*
+         * Pack a mc by kc block of A into row panels of MR rows:
+         * within a panel, the MR elements of one column are contiguous. Short panels are padded with zeros.
+         * */
+        template <class T>
+        void gemm_pack_a(size_t mc, size_t kc, const T* a, size_t rs_a, size_t cs_a, T* packed) {
+            const size_t MR = GemmTile<T>::MR;
+            for (size_t i0 = 0; i0 < mc; i0 += MR) {
+                const size_t mr = std::min(MR, mc - i0);
+                for (size_t p = 0; p < kc; p++) {
+                    const T* src = a + i0 * rs_a + p * cs_a;
+                    size_t i = 0;
+                    for (; i < mr; i++) {
+                        packed[i] = src[i * rs_a];
+                    }
+                    for (; i < MR; i++) {
+                        packed[i] = T();
+                    }
+                    packed += MR;
+                }
+            }
+        }
+
+        /*
+         * Pack a kc by nc block of B into column panels of NR columns:
+         * within a panel, the NR elements of one row are contiguous. Short panels are padded with zeros.
+         * */
+        template <class T>
+        void gemm_pack_b(size_t kc, size_t nc, const T* b, size_t rs_b, size_t cs_b, T* packed) {
+            const size_t NR = GemmTile<T>::NR;
+            for (size_t j0 = 0; j0 < nc; j0 += NR) {
+                const size_t nr = std::min(NR, nc - j0);
+                for (size_t p = 0; p < kc; p++) {
+                    const T* src = b + p * rs_b + j0 * cs_b;
+                    size_t j = 0;
+                    if (cs_b == 1) {
+                        for (; j < nr; j++) {
+                            packed[j] = src[j];
+                        }
+                    }
+                    else {
+                        for (; j < nr; j++) {
+                            packed[j] = src[j * cs_b];
+                        }
+                    }
+                    for (; j < NR; j++) {
+                        packed[j] = T();
+                    }
+                    packed += NR;
+                }
+            }
+        }
+
+        /*
+         * C[MR x NR] += A_panel * B_panel, portable version.
+         * */
+        template <class T>
+        void gemm_micro_kernel_generic(size_t kc, const T* a, const T* b, T* c, size_t ldc) {
+            const size_t MR = GemmTile<T>::MR;
+            const size_t NR = GemmTile<T>::NR;
+            T acc[GemmTile<T>::MR][GemmTile<T>::NR] = {};
+            for (size_t p = 0; p < kc; p++) {
+                for (size_t i = 0; i < MR; i++) {
+                    const T a_ip = a[i];
+                    for (size_t j = 0; j < NR; j++) {
+                        acc[i][j] += a_ip * b[j];
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+            for (size_t i = 0; i < MR; i++) {
+                for (size_t j = 0; j < NR; j++) {
+                    c[i * ldc + j] += acc[i][j];
+                }
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        /*
+         * C[6 x NR] += A_panel * B_panel with AVX2 and FMA: the tile lives in 12 ymm accumulators,
+         * two per row of C (8 doubles or 16 floats).
+         * */
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        void gemm_micro_kernel_avx2(size_t kc, const T* a, const T* b, T* c, size_t ldc) {
+            typedef SimdTraits<T> S;
+            typedef typename S::avx2_type V;
+            const size_t w = S::avx2_width;
+            static_assert(GemmTile<T>::MR == 6 && GemmTile<T>::NR == 2 * S::avx2_width, "Unexpected GEMM tile.");
+
+            V c00 = S::avx2_set1(0), c01 = S::avx2_set1(0);
+            V c10 = S::avx2_set1(0), c11 = S::avx2_set1(0);
+            V c20 = S::avx2_set1(0), c21 = S::avx2_set1(0);
+            V c30 = S::avx2_set1(0), c31 = S::avx2_set1(0);
+            V c40 = S::avx2_set1(0), c41 = S::avx2_set1(0);
+            V c50 = S::avx2_set1(0), c51 = S::avx2_set1(0);
+
+            for (size_t p = 0; p < kc; p++) {
+                const V b0 = S::avx2_load(b);
+                const V b1 = S::avx2_load(b + w);
+                V ai;
+
+                ai = S::avx2_set1(a[0]);
+                c00 = S::avx2_fmadd(ai, b0, c00);
+                c01 = S::avx2_fmadd(ai, b1, c01);
+                ai = S::avx2_set1(a[1]);
+                c10 = S::avx2_fmadd(ai, b0, c10);
+                c11 = S::avx2_fmadd(ai, b1, c11);
+                ai = S::avx2_set1(a[2]);
+                c20 = S::avx2_fmadd(ai, b0, c20);
+                c21 = S::avx2_fmadd(ai, b1, c21);
+                ai = S::avx2_set1(a[3]);
+                c30 = S::avx2_fmadd(ai, b0, c30);
+                c31 = S::avx2_fmadd(ai, b1, c31);
+                ai = S::avx2_set1(a[4]);
+                c40 = S::avx2_fmadd(ai, b0, c40);
+                c41 = S::avx2_fmadd(ai, b1, c41);
+                ai = S::avx2_set1(a[5]);
+                c50 = S::avx2_fmadd(ai, b0, c50);
+                c51 = S::avx2_fmadd(ai, b1, c51);
+
+                a += GemmTile<T>::MR;
+                b += GemmTile<T>::NR;
+            }
+
+            T* c0 = c;
+            T* c1 = c0 + ldc;
+            T* c2 = c1 + ldc;
+            T* c3 = c2 + ldc;
+            T* c4 = c3 + ldc;
+            T* c5 = c4 + ldc;
+            S::avx2_store(c0, AddOp::avx2(S::avx2_load(c0), c00));
+            S::avx2_store(c0 + w, AddOp::avx2(S::avx2_load(c0 + w), c01));
+            S::avx2_store(c1, AddOp::avx2(S::avx2_load(c1), c10));
+            S::avx2_store(c1 + w, AddOp::avx2(S::avx2_load(c1 + w), c11));
+            S::avx2_store(c2, AddOp::avx2(S::avx2_load(c2), c20));
+            S::avx2_store(c2 + w, AddOp::avx2(S::avx2_load(c2 + w), c21));
+            S::avx2_store(c3, AddOp::avx2(S::avx2_load(c3), c30));
+            S::avx2_store(c3 + w, AddOp::avx2(S::avx2_load(c3 + w), c31));
+            S::avx2_store(c4, AddOp::avx2(S::avx2_load(c4), c40));
+            S::avx2_store(c4 + w, AddOp::avx2(S::avx2_load(c4 + w), c41));
+            S::avx2_store(c5, AddOp::avx2(S::avx2_load(c5), c50));
+            S::avx2_store(c5 + w, AddOp::avx2(S::avx2_load(c5 + w), c51));
+        }
+#endif
+
+        template <class T>
+        using GemmMicroKernel = void (*)(size_t kc, const T* a, const T* b, T* c, size_t ldc);
+
+        template <class T>
+        GemmMicroKernel<T> gemm_select_micro_kernel(std::true_type) {
+#if NUMPP_X86_SIMD
+            if (simd_level() >= SIMD_AVX2) {
+                return gemm_micro_kernel_avx2<T>;
+            }
+#endif
+            return gemm_micro_kernel_generic<T>;
+        }
+
+        template <class T>
+        GemmMicroKernel<T> gemm_select_micro_kernel(std::false_type) {
+            return gemm_micro_kernel_generic<T>;
+        }
+
+        /*
+         * Multiply a packed mc by kc block of A with a packed kc by nc panel of B into C.
+         * Edge tiles are computed into a scratch tile and only the valid part is added to C.
+         * */
+        template <class T>
+        void gemm_macro_kernel(size_t mc, size_t nc, size_t kc, const T* packed_a, const T* packed_b,
+                               T* c, size_t ldc, GemmMicroKernel<T> micro_kernel) {
+            const size_t MR = GemmTile<T>::MR;
+            const size_t NR = GemmTile<T>::NR;
+            T edge_tile[GemmTile<T>::MR * GemmTile<T>::NR];
+            for (size_t j0 = 0; j0 < nc; j0 += NR) {
+                const size_t nr = std::min(NR, nc - j0);
+                const T* b_panel = packed_b + j0 * kc;
+                for (size_t i0 = 0; i0 < mc; i0 += MR) {
+                    const size_t mr = std::min(MR, mc - i0);
+                    const T* a_panel = packed_a + i0 * kc;
+                    T* c_tile = c + i0 * ldc + j0;
+
+                    if (mr == MR && nr == NR) {
+                        micro_kernel(kc, a_panel, b_panel, c_tile, ldc);
+                    }
+                    else {
+                        std::fill(edge_tile, edge_tile + MR * NR, T());
+                        micro_kernel(kc, a_panel, b_panel, edge_tile, NR);
+                        for (size_t i = 0; i < mr; i++) {
+                            for (size_t j = 0; j < nr; j++) {
+                                c_tile[i * ldc + j] += edge_tile[i * NR + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /*
+         * Blocked GEMM following the usual five loops around the micro-kernel:
+         * B is packed once per (KC x NC) panel and A once per (MC x KC) block.
+         * */
+        template <class T>
+        void gemm_blocked(size_t m, size_t n, size_t k,
+                          const T* a, size_t rs_a, size_t cs_a,
+                          const T* b, size_t rs_b, size_t cs_b,
+                          T* c, size_t ldc) {
+            const size_t MR = GemmTile<T>::MR;
+            const size_t NR = GemmTile<T>::NR;
+            const GemmMicroKernel<T> micro_kernel = gemm_select_micro_kernel<T>(typename SimdTraits<T>::vectorized());
+            const size_t nc_max = std::min(GEMM_NC, (n + NR - 1) / NR * NR);
+            const size_t kc_max = std::min(GEMM_KC, k);
+            const size_t mc_max = std::min(GEMM_MC, (m + MR - 1) / MR * MR);
+            // Scratch comes from the per-thread pool rather than the default resource, so that it is reused
+            // across calls and never grows an arena the caller installed for its results.
+            BasicAlignedBuffer<T> packed_a(mc_max * kc_max, pool_resource());
+            BasicAlignedBuffer<T> packed_b(kc_max * nc_max, pool_resource());
+
+            for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+                const size_t nc = std::min(GEMM_NC, n - jc);
+                for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                    const size_t kc = std::min(GEMM_KC, k - pc);
+                    gemm_pack_b(kc, nc, b + pc * rs_b + jc * cs_b, rs_b, cs_b, packed_b.data());
+                    for (size_t ic = 0; ic < m; ic += GEMM_MC) {
+                        const size_t mc = std::min(GEMM_MC, m - ic);
+                        gemm_pack_a(mc, kc, a + ic * rs_a + pc * cs_a, rs_a, cs_a, packed_a.data());
+                        gemm_macro_kernel(mc, nc, kc, packed_a.data(), packed_b.data(),
+                                          c + ic * ldc + jc, ldc, micro_kernel);
+                    }
+                }
+            }
+        }
+
+        /*
+         * C += A * B, where A is m by k, B is k by n and C is m by n with row stride `ldc`.
+         *
+         * The path is chosen from the shape:
+         * matrix-vector (n == 1) and vector-matrix (m == 1) products stream through A or B once,
+         * small products use a plain i-k-j loop, and everything else goes through the packed, blocked kernel.
+         * */
+        template <class T>
+        void gemm(size_t m, size_t n, size_t k,
+                  const T* a, size_t rs_a, size_t cs_a,
+                  const T* b, size_t rs_b, size_t cs_b,
+                  T* c, size_t ldc) {
+            if (m == 0 || n == 0 || k == 0) {
+                return;
+            }
+
+            const size_t MR = GemmTile<T>::MR;
+            const size_t NR = GemmTile<T>::NR;
+            if (n == 1) {
+                // Matrix-vector product: one dot product per row of A.
+                for (size_t i = 0; i < m; i++) {
+                    c[i * ldc] += dot(k, a + i * rs_a, cs_a, b, rs_b);
+                }
+            }
+            else if (m == 1) {
+                // Vector-matrix product: accumulate scaled rows of B.
+                for (size_t p = 0; p < k; p++) {
+                    axpy(n, a[p * cs_a], b + p * rs_b, cs_b, c);
+                }
+            }
+            else if (m * n * k < GEMM_SMALL_FLOPS) {
+                for (size_t i = 0; i < m; i++) {
+                    T* c_row = c + i * ldc;
+                    for (size_t p = 0; p < k; p++) {
+                        axpy(n, a[i * rs_a + p * cs_a], b + p * rs_b, cs_b, c_row);
+                    }
+                }
+            }
+            else if (m * n * k < 2 * parallel::MIN_FLOPS_PER_TASK) {
+                gemm_blocked(m, n, k, a, rs_a, cs_a, b, rs_b, cs_b, c, ldc);
+            }
+            else if (m >= n) {
+                // Every thread computes its own block of rows of C (each packing B on its own).
+                const size_t grain = std::max(MR, parallel::MIN_FLOPS_PER_TASK / (n * k));
+                parallel::parallel_for(0, m, grain, [=](size_t i_begin, size_t i_end) {
+                    gemm_blocked(i_end - i_begin, n, k, a + i_begin * rs_a, rs_a, cs_a, b, rs_b, cs_b,
+                                 c + i_begin * ldc, ldc);
+                }, MR);
+            }
+            else {
+                const size_t grain = std::max(NR, parallel::MIN_FLOPS_PER_TASK / (m * k));
+                parallel::parallel_for(0, n, grain, [=](size_t j_begin, size_t j_end) {
+                    gemm_blocked(m, j_end - j_begin, k, a, rs_a, cs_a, b + j_begin * cs_b, rs_b, cs_b,
+                                 c + j_begin, ldc);
+                }, NR);
+            }
+        }
+
+
+        /*
+         * Tiles of at most TRANSPOSE_TILE by TRANSPOSE_TILE elements fit in L1 together with their transpose;
+         * larger transposes are split recursively down to that size.
+         * */
+        const size_t TRANSPOSE_TILE = 32;
+
+        /*
+         * dst = src^T for a rows by cols block of src (row stride `lds`) and a cols by rows block of dst (row stride `ldd`).
+         * */
+        template <class T>
+        using TransposeKernel = void (*)(size_t rows, size_t cols, const T* src, size_t lds, T* dst, size_t ldd);
+
+        template <class T>
+        void transpose_tile_scalar(size_t rows, size_t cols, const T* src, size_t lds, T* dst, size_t ldd) {
+            for (size_t r = 0; r < rows; r++) {
+                for (size_t c = 0; c < cols; c++) {
+                    dst[c * ldd + r] = src[r * lds + c];
+                }
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        /*
+         * Transposes 4 by 4 blocks in registers: pairs of rows are interleaved, then the 128-bit halves are exchanged.
+         * */
+        __attribute__((target("avx2")))
+        void transpose_tile_avx2(size_t rows, size_t cols, const double* src, size_t lds, double* dst, size_t ldd) {
+            size_t r = 0;
+            for (; r + 4 <= rows; r += 4) {
+                size_t c = 0;
+                for (; c + 4 <= cols; c += 4) {
+                    const double* s = src + r * lds + c;
+                    const __m256d r0 = _mm256_loadu_pd(s);
+                    const __m256d r1 = _mm256_loadu_pd(s + lds);
+                    const __m256d r2 = _mm256_loadu_pd(s + 2 * lds);
+                    const __m256d r3 = _mm256_loadu_pd(s + 3 * lds);
+                    const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+                    const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+                    const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+                    const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+                    double* d = dst + c * ldd + r;
+                    _mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+                    _mm256_storeu_pd(d + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+                    _mm256_storeu_pd(d + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+                    _mm256_storeu_pd(d + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+                }
+                transpose_tile_scalar<double>(4, cols - c, src + r * lds + c, lds, dst + c * ldd + r, ldd);
+            }
+            transpose_tile_scalar<double>(rows - r, cols, src + r * lds, lds, dst + r, ldd);
+        }
+#endif
+
+        /*
+         * Only double has a SIMD tile; other element types use the portable loop.
+         * */
+        template <class T>
+        TransposeKernel<T> transpose_tile_kernel(SimdLevel level = simd_level()) {
+            (void) level;
+            return transpose_tile_scalar<T>;
+        }
+
+        template <>
+        TransposeKernel<double> transpose_tile_kernel<double>(SimdLevel level) {
+#if NUMPP_X86_SIMD
+            if (level >= SIMD_AVX2) {
+                return transpose_tile_avx2;
+            }
+#endif
+            return transpose_tile_scalar<double>;
+        }
+
+        /*
+         * Cache-oblivious transpose: halve the longer side until the block is a single tile.
+         * */
+        template <class T>
+        void transpose_recursive(size_t rows, size_t cols, const T* src, size_t lds, T* dst, size_t ldd,
+                                 TransposeKernel<T> tile) {
+            if (rows <= TRANSPOSE_TILE && cols <= TRANSPOSE_TILE) {
+                tile(rows, cols, src, lds, dst, ldd);
+            }
+            else if (rows >= cols) {
+                const size_t half = (rows / 2 + 3) / 4 * 4;
+                transpose_recursive(half, cols, src, lds, dst, ldd, tile);
+                transpose_recursive(rows - half, cols, src + half * lds, lds, dst + half, ldd, tile);
+            }
+            else {
+                const size_t half = (cols / 2 + 3) / 4 * 4;
+                transpose_recursive(rows, half, src, lds, dst, ldd, tile);
+                transpose_recursive(rows, cols - half, src + half, lds, dst + half * ldd, ldd, tile);
+            }
+        }
+
+        /*
+         * dst = src^T, where src is rows by cols. Blocks of source columns (rows of dst) are transposed in parallel.
+         * */
+        template <class T>
+        void transpose(size_t rows, size_t cols, const T* src, size_t lds, T* dst, size_t ldd) {
+            const TransposeKernel<T> tile = transpose_tile_kernel<T>();
+            const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(rows, 1) + 1;
+            parallel::parallel_for(0, cols, grain, [=](size_t c_begin, size_t c_end) {
+                transpose_recursive(rows, c_end - c_begin, src + c_begin, lds, dst + c_begin * ldd, ldd, tile);
+            }, TRANSPOSE_TILE);
+        }
+
+        /*
+         * a = a^T for the n by n matrix `a` (row stride `lda`), tile by tile:
+         * a diagonal tile is transposed by swapping its elements, an off-diagonal pair of tiles through a scratch tile.
+         * */
+        template <class T>
+        void transpose_square_inplace(size_t n, T* a, size_t lda) {
+            const TransposeKernel<T> tile = transpose_tile_kernel<T>();
+            const size_t tiles = (n + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+            const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / (TRANSPOSE_TILE * std::max<size_t>(n, 1)) + 1;
+            parallel::parallel_for(0, tiles, grain, [=](size_t i_begin, size_t i_end) {
+                T scratch[TRANSPOSE_TILE * TRANSPOSE_TILE];
+                for (size_t i = i_begin; i < i_end; i++) {
+                    const size_t r0 = i * TRANSPOSE_TILE;
+                    const size_t rows = std::min(TRANSPOSE_TILE, n - r0);
+                    for (size_t r = r0; r < r0 + rows; r++) {
+                        for (size_t c = r + 1; c < r0 + rows; c++) {
+                            std::swap(a[r * lda + c], a[c * lda + r]);
+                        }
+                    }
+                    for (size_t c0 = r0 + TRANSPOSE_TILE; c0 < n; c0 += TRANSPOSE_TILE) {
+                        const size_t cols = std::min(TRANSPOSE_TILE, n - c0);
+                        T* upper = a + r0 * lda + c0;
+                        T* lower = a + c0 * lda + r0;
+                        tile(rows, cols, upper, lda, scratch, TRANSPOSE_TILE);
+                        tile(cols, rows, lower, lda, upper, lda);
+                        for (size_t r = 0; r < cols; r++) {
+                            std::copy(scratch + r * TRANSPOSE_TILE, scratch + r * TRANSPOSE_TILE + rows, lower + r * lda);
+                        }
+                    }
+                }
+            });
+        }
+
+        /*
+         * Columns factored per panel by lu_factor; the rest of the matrix is updated once per panel with a GEMM.
+         * */
+        const size_t LU_BLOCK = 64;
+
+        /*
+         * Rows per block in the substitutions of lu_solve.
+         * */
+        const size_t LU_SOLVE_BLOCK = 32;
+
+        /*
+         * C -= A * B through gemm, where the m by k block A (row stride `lda`) is negated into a scratch buffer first.
+         * */
+        template <class T>
+        void gemm_subtract(size_t m, size_t n, size_t k, const T* a, size_t lda,
+                           const T* b, size_t ldb, T* c, size_t ldc) {
+            if (m == 0 || n == 0 || k == 0) {
+                return;
+            }
+            BasicAlignedBuffer<T> negated_a(m * k, pool_resource());
+            for (size_t i = 0; i < m; i++) {
+                for (size_t p = 0; p < k; p++) {
+                    negated_a.data()[i * k + p] = -a[i * lda + p];
+                }
+            }
+            gemm(m, n, k, negated_a.data(), k, 1, b, ldb, 1, c, ldc);
+        }
+
+        /*
+         * In-place LU factorization with partial pivoting of the n by n matrix `a` (row stride `lda`):
+         * afterwards the strict lower part of `a` holds L (whose diagonal is all ones) and the upper part holds U,
+         * with P * A = L * U. Row i of P * A is row perm[i] of A, and `sign` is the parity of the permutation.
+         * Returns false when a zero pivot was met, i.e. A is singular.
+         * */
+        template <class T>
+        bool lu_factor(size_t n, T* a, size_t lda, size_t* perm, int& sign) {
+            bool regular = true;
+            sign = 1;
+            for (size_t i = 0; i < n; i++) {
+                perm[i] = i;
+            }
+
+            for (size_t k0 = 0; k0 < n; k0 += LU_BLOCK) {
+                const size_t kb = std::min(LU_BLOCK, n - k0);
+                const size_t k1 = k0 + kb;
+
+                // Factor the panel of columns [k0, k1), swapping whole rows.
+                for (size_t j = k0; j < k1; j++) {
+                    size_t pivot = j;
+                    for (size_t i = j + 1; i < n; i++) {
+                        if (std::abs(a[i * lda + j]) > std::abs(a[pivot * lda + j])) {
+                            pivot = i;
+                        }
+                    }
+                    if (pivot != j) {
+                        std::swap_ranges(a + j * lda, a + j * lda + n, a + pivot * lda);
+                        std::swap(perm[j], perm[pivot]);
+                        sign = -sign;
+                    }
+
+                    const T* pivot_row = a + j * lda;
+                    if (pivot_row[j] == T()) {
+                        // The whole column below is zero as well: nothing to eliminate.
+                        regular = false;
+                        continue;
+                    }
+                    for (size_t i = j + 1; i < n; i++) {
+                        T* row = a + i * lda;
+                        const T l = row[j] / pivot_row[j];
+                        row[j] = l;
+                        axpy(k1 - j - 1, -l, pivot_row + j + 1, 1, row + j + 1);
+                    }
+                }
+
+                if (k1 == n) {
+                    break;
+                }
+
+                // U12 = L11^-1 * A12
+                for (size_t j = k0; j < k1; j++) {
+                    for (size_t i = j + 1; i < k1; i++) {
+                        axpy(n - k1, -a[i * lda + j], a + j * lda + k1, 1, a + i * lda + k1);
+                    }
+                }
+
+                // A22 -= L21 * U12
+                gemm_subtract(n - k1, n - k1, kb, a + k1 * lda + k0, lda, a + k0 * lda + k1, lda, a + k1 * lda + k1, lda);
+            }
+            return regular;
+        }
+
+        /*
+         * Overwrite the n by k right-hand sides `x` (row stride `ldx`, already permuted by P)
+         * with the solution of L * U * X = X, given the packed factors produced by lu_factor.
+         *
+         * Both substitutions go through blocks of LU_SOLVE_BLOCK rows: the contribution of all earlier blocks
+         * is subtracted with one GEMM, then the block itself is solved row by row.
+         * */
+        template <class T>
+        void lu_solve(size_t n, const T* lu, size_t ld_lu, T* x, size_t ldx, size_t k) {
+            // Forward substitution with the unit lower triangle.
+            for (size_t i0 = 0; i0 < n; i0 += LU_SOLVE_BLOCK) {
+                const size_t i1 = std::min(n, i0 + LU_SOLVE_BLOCK);
+                gemm_subtract(i1 - i0, k, i0, lu + i0 * ld_lu, ld_lu, x, ldx, x + i0 * ldx, ldx);
+                for (size_t i = i0 + 1; i < i1; i++) {
+                    for (size_t j = i0; j < i; j++) {
+                        axpy(k, -lu[i * ld_lu + j], x + j * ldx, 1, x + i * ldx);
+                    }
+                }
+            }
+
+            // Backward substitution with the upper triangle.
+            for (size_t i1 = n; i1 > 0;) {
+                const size_t i0 = i1 > LU_SOLVE_BLOCK ? i1 - LU_SOLVE_BLOCK : 0;
+                gemm_subtract(i1 - i0, k, n - i1, lu + i0 * ld_lu + i1, ld_lu, x + i1 * ldx, ldx, x + i0 * ldx, ldx);
+                for (size_t i = i1; i-- > i0;) {
+                    T* x_i = x + i * ldx;
+                    for (size_t j = i + 1; j < i1; j++) {
+                        axpy(k, -lu[i * ld_lu + j], x + j * ldx, 1, x_i);
+                    }
+                    const T pivot = lu[i * ld_lu + i];
+                    for (size_t c = 0; c < k; c++) {
+                        x_i[c] /= pivot;
+                    }
+                }
+                i1 = i0;
+            }
+        }
+
+        /*
+         * Gaussian elimination with partial pivoting of the rows by cols matrix `a` (row stride `lda`), in place.
+         * In every column the entry of largest magnitude among the remaining rows becomes the pivot,
+         * and the entries it eliminates are set to exactly zero.
+         * With `reduced`, pivots are scaled to one and eliminated above as well (Gauss-Jordan), giving the RREF;
+         * otherwise the result is a row echelon form. Returns the number of pivots (the rank).
+         * */
+        template <class T>
+        size_t row_echelon(size_t rows, size_t cols, T* a, size_t lda, bool reduced) {
+            size_t pivot_num = 0;
+            for (size_t col = 0; col < cols && pivot_num < rows; col++) {
+                size_t pivot_row = pivot_num;
+                for (size_t row = pivot_num + 1; row < rows; row++) {
+                    if (std::abs(a[row * lda + col]) > std::abs(a[pivot_row * lda + col])) {
+                        pivot_row = row;
+                    }
+                }
+                if (a[pivot_row * lda + col] == T()) {
+                    continue;
+                }
+                if (pivot_row != pivot_num) {
+                    std::swap_ranges(a + pivot_row * lda + col, a + pivot_row * lda + cols, a + pivot_num * lda + col);
+                }
+
+                // Entries left of `col` are zero in the pivot row, so only the columns from `col` on are touched.
+                T* pivot = a + pivot_num * lda;
+                if (reduced) {
+                    const T scale = pivot[col];
+                    for (size_t c = col + 1; c < cols; c++) {
+                        pivot[c] /= scale;
+                    }
+                    pivot[col] = T(1);
+                }
+
+                const size_t first_row = reduced ? 0 : pivot_num + 1;
+                const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / (cols - col) + 1;
+                const size_t skip_row = pivot_num;
+                parallel::parallel_for(first_row, rows, grain, [=](size_t r_begin, size_t r_end) {
+                    for (size_t row = r_begin; row < r_end; row++) {
+                        T* target = a + row * lda;
+                        if (row == skip_row || target[col] == T()) {
+                            continue;
+                        }
+                        axpy(cols - col - 1, -(target[col] / pivot[col]), pivot + col + 1, 1, target + col + 1);
+                        target[col] = T();
+                    }
+                });
+                pivot_num++;
+            }
+            return pivot_num;
+        }
+
+        /*
+         * Rows [row_begin, row_end) of C = A * B for a sparse A in CSR form (row_pointers, col_indexes, values)
+         * and a dense B with n columns (row stride `ldb`). C has row stride `ldc` and is overwritten.
+         * Every non-zero a_ip adds a_ip times row p of B to row i of C, so the work is nnz(A) * n;
+         * a single column (a sparse matrix-vector product) is a gathered dot product per row instead.
+         * */
+        template <class T>
+        void csr_dense_multiply(size_t row_begin, size_t row_end, size_t n,
+                                const size_t* row_pointers, const size_t* col_indexes, const T* values,
+                                const T* b, size_t ldb, T* c, size_t ldc) {
+            for (size_t i = row_begin; i < row_end; i++) {
+                if (n == 1) {
+                    T acc = T();
+                    for (size_t q = row_pointers[i]; q < row_pointers[i + 1]; q++) {
+                        acc += values[q] * b[col_indexes[q] * ldb];
+                    }
+                    c[i * ldc] = acc;
+                    continue;
+                }
+
+                T* c_row = c + i * ldc;
+                std::fill(c_row, c_row + n, T());
+                for (size_t q = row_pointers[i]; q < row_pointers[i + 1]; q++) {
+                    axpy(n, values[q], b + col_indexes[q] * ldb, 1, c_row);
+                }
+            }
+        }
+
+        /*
+         * Rows [row_begin, row_end) of C = A * B for a dense A with k columns (row stride `lda`)
+         * and a sparse B in CSR form with k rows. C has row stride `ldc`, n columns, and is overwritten.
+         * Zero entries of A are skipped, so a sparse B only costs nnz(B) per non-zero of A.
+         * */
+        template <class T>
+        void dense_csr_multiply(size_t row_begin, size_t row_end, size_t k, size_t n, const T* a, size_t lda,
+                                const size_t* row_pointers, const size_t* col_indexes, const T* values,
+                                T* c, size_t ldc) {
+            for (size_t i = row_begin; i < row_end; i++) {
+                T* c_row = c + i * ldc;
+                std::fill(c_row, c_row + n, T());
+                for (size_t p = 0; p < k; p++) {
+                    const T a_ip = a[i * lda + p];
+                    if (a_ip == T()) {
+                        continue;
+                    }
+                    for (size_t q = row_pointers[p]; q < row_pointers[p + 1]; q++) {
+                        c_row[col_indexes[q]] += a_ip * values[q];
+                    }
+                }
+            }
+        }
+
+        /*
+         * Determinant and inverse of an N by N matrix `a` (row stride `lda`) for small, compile-time N.
+         * Sizes 1 to 4 use closed-form cofactor expressions without any loops;
+         * larger sizes factor a copy on the stack with lu_factor.
+         * `invert` writes A^-1 to `out` (row stride `ldo`, which may be `a` itself) and returns false,
+         * leaving `out` untouched, when A is singular.
+         * */
+        template <class T, size_t N>
+        struct SmallSquare {
+            static T determinant(const T* a, size_t lda) {
+                T lu[N * N];
+                for (size_t r = 0; r < N; r++) {
+                    std::copy(a + r * lda, a + r * lda + N, lu + r * N);
+                }
+                size_t perm[N];
+                int sign = 1;
+                if (!lu_factor(N, lu, N, perm, sign)) {
+                    return T();
+                }
+                T res = static_cast<T>(sign);
+                for (size_t i = 0; i < N; i++) {
+                    res *= lu[i * N + i];
+                }
+                return res;
+            }
+
+            static bool invert(const T* a, size_t lda, T* out, size_t ldo) {
+                T lu[N * N];
+                for (size_t r = 0; r < N; r++) {
+                    std::copy(a + r * lda, a + r * lda + N, lu + r * N);
+                }
+                size_t perm[N];
+                int sign = 1;
+                if (!lu_factor(N, lu, N, perm, sign)) {
+                    return false;
+                }
+                // Solve L * U * X = P.
+                for (size_t r = 0; r < N; r++) {
+                    std::fill(out + r * ldo, out + r * ldo + N, T());
+                    out[r * ldo + perm[r]] = T(1);
+                }
+                lu_solve(N, lu, N, out, ldo, N);
+                return true;
+            }
+        };
+
+        template <class T>
+        struct SmallSquare<T, 1> {
+            static T determinant(const T* a, size_t) {
+                return a[0];
+            }
+
+            static bool invert(const T* a, size_t, T* out, size_t) {
+                if (a[0] == T()) {
+                    return false;
+                }
+                out[0] = T(1) / a[0];
+                return true;
+            }
+        };
+
+        template <class T>
+        struct SmallSquare<T, 2> {
+            static T determinant(const T* a, size_t lda) {
+                return a[0] * a[lda + 1] - a[1] * a[lda];
+            }
+
+            static bool invert(const T* a, size_t lda, T* out, size_t ldo) {
+                const T m00 = a[0], m01 = a[1];
+                const T m10 = a[lda], m11 = a[lda + 1];
+                const T det = m00 * m11 - m01 * m10;
+                if (det == T()) {
+                    return false;
+                }
+                const T inv_det = T(1) / det;
+                out[0] = m11 * inv_det;
+                out[1] = -m01 * inv_det;
+                out[ldo] = -m10 * inv_det;
+                out[ldo + 1] = m00 * inv_det;
+                return true;
+            }
+        };
+
+        template <class T>
+        struct SmallSquare<T, 3> {
+            static T determinant(const T* a, size_t lda) {
+                const T* r0 = a;
+                const T* r1 = a + lda;
+                const T* r2 = a + 2 * lda;
+                return r0[0] * (r1[1] * r2[2] - r1[2] * r2[1])
+                       - r0[1] * (r1[0] * r2[2] - r1[2] * r2[0])
+                       + r0[2] * (r1[0] * r2[1] - r1[1] * r2[0]);
+            }
+
+            static bool invert(const T* a, size_t lda, T* out, size_t ldo) {
+                const T m00 = a[0], m01 = a[1], m02 = a[2];
+                const T m10 = a[lda], m11 = a[lda + 1], m12 = a[lda + 2];
+                const T m20 = a[2 * lda], m21 = a[2 * lda + 1], m22 = a[2 * lda + 2];
+
+                // Cofactors of the first column give the determinant; the adjugate is the transposed cofactor matrix.
+                const T b00 = m11 * m22 - m12 * m21;
+                const T b10 = m12 * m20 - m10 * m22;
+                const T b20 = m10 * m21 - m11 * m20;
+                const T det = m00 * b00 + m01 * b10 + m02 * b20;
+                if (det == T()) {
+                    return false;
+                }
+                const T inv_det = T(1) / det;
+                T* o0 = out;
+                T* o1 = out + ldo;
+                T* o2 = out + 2 * ldo;
+                o0[0] = b00 * inv_det;
+                o0[1] = (m02 * m21 - m01 * m22) * inv_det;
+                o0[2] = (m01 * m12 - m02 * m11) * inv_det;
+                o1[0] = b10 * inv_det;
+                o1[1] = (m00 * m22 - m02 * m20) * inv_det;
+                o1[2] = (m02 * m10 - m00 * m12) * inv_det;
+                o2[0] = b20 * inv_det;
+                o2[1] = (m01 * m20 - m00 * m21) * inv_det;
+                o2[2] = (m00 * m11 - m01 * m10) * inv_det;
+                return true;
+            }
+        };
+
+        template <class T>
+        struct SmallSquare<T, 4> {
+            /*
+             * 2 by 2 minors of the top two rows (s) and of the bottom two rows (c), from which
+             * the determinant and all cofactors follow (Laplace expansion along the top two rows).
+             * */
+            struct Minors {
+                T s0, s1, s2, s3, s4, s5;
+                T c0, c1, c2, c3, c4, c5;
+
+                Minors(const T* a, size_t lda) {
+                    const T* r0 = a;
+                    const T* r1 = a + lda;
+                    const T* r2 = a + 2 * lda;
+                    const T* r3 = a + 3 * lda;
+                    s0 = r0[0] * r1[1] - r1[0] * r0[1];
+                    s1 = r0[0] * r1[2] - r1[0] * r0[2];
+                    s2 = r0[0] * r1[3] - r1[0] * r0[3];
+                    s3 = r0[1] * r1[2] - r1[1] * r0[2];
+                    s4 = r0[1] * r1[3] - r1[1] * r0[3];
+                    s5 = r0[2] * r1[3] - r1[2] * r0[3];
+                    c5 = r2[2] * r3[3] - r3[2] * r2[3];
+                    c4 = r2[1] * r3[3] - r3[1] * r2[3];
+                    c3 = r2[1] * r3[2] - r3[1] * r2[2];
+                    c2 = r2[0] * r3[3] - r3[0] * r2[3];
+                    c1 = r2[0] * r3[2] - r3[0] * r2[2];
+                    c0 = r2[0] * r3[1] - r3[0] * r2[1];
+                }
+
+                T determinant() const {
+                    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+                }
+            };
+
+            static T determinant(const T* a, size_t lda) {
+                return Minors(a, lda).determinant();
+            }
+
+            static bool invert(const T* a, size_t lda, T* out, size_t ldo) {
+                const Minors k(a, lda);
+                const T det = k.determinant();
+                if (det == T()) {
+                    return false;
+                }
+                const T m00 = a[0], m01 = a[1], m02 = a[2], m03 = a[3];
+                const T m10 = a[lda], m11 = a[lda + 1], m12 = a[lda + 2], m13 = a[lda + 3];
+                const T m20 = a[2 * lda], m21 = a[2 * lda + 1], m22 = a[2 * lda + 2], m23 = a[2 * lda + 3];
+                const T m30 = a[3 * lda], m31 = a[3 * lda + 1], m32 = a[3 * lda + 2], m33 = a[3 * lda + 3];
+                const T inv_det = T(1) / det;
+                T* o0 = out;
+                T* o1 = out + ldo;
+                T* o2 = out + 2 * ldo;
+                T* o3 = out + 3 * ldo;
+                o0[0] = (m11 * k.c5 - m12 * k.c4 + m13 * k.c3) * inv_det;
+                o0[1] = (-m01 * k.c5 + m02 * k.c4 - m03 * k.c3) * inv_det;
+                o0[2] = (m31 * k.s5 - m32 * k.s4 + m33 * k.s3) * inv_det;
+                o0[3] = (-m21 * k.s5 + m22 * k.s4 - m23 * k.s3) * inv_det;
+                o1[0] = (-m10 * k.c5 + m12 * k.c2 - m13 * k.c1) * inv_det;
+                o1[1] = (m00 * k.c5 - m02 * k.c2 + m03 * k.c1) * inv_det;
+                o1[2] = (-m30 * k.s5 + m32 * k.s2 - m33 * k.s1) * inv_det;
+                o1[3] = (m20 * k.s5 - m22 * k.s2 + m23 * k.s1) * inv_det;
+                o2[0] = (m10 * k.c4 - m11 * k.c2 + m13 * k.c0) * inv_det;
+                o2[1] = (-m00 * k.c4 + m01 * k.c2 - m03 * k.c0) * inv_det;
+                o2[2] = (m30 * k.s4 - m31 * k.s2 + m33 * k.s0) * inv_det;
+                o2[3] = (-m20 * k.s4 + m21 * k.s2 - m23 * k.s0) * inv_det;
+                o3[0] = (-m10 * k.c3 + m11 * k.c1 - m12 * k.c0) * inv_det;
+                o3[1] = (m00 * k.c3 - m01 * k.c1 + m02 * k.c0) * inv_det;
+                o3[2] = (-m30 * k.s3 + m31 * k.s1 - m32 * k.s0) * inv_det;
+                o3[3] = (m20 * k.s3 - m21 * k.s1 + m22 * k.s0) * inv_det;
+                return true;
+            }
+        };
+
+        /*
+         * Kernels over batches of same-shape matrices stored lane-interleaved: element (r, c) of every matrix
+         * in the batch forms one contiguous array of "lanes" (one lane per matrix), and the arrays of consecutive
+         * elements are `ld` apart. Packets therefore run across the batch, so each instruction works on several
+         * independent matrices however small they are.
+         *
+         * Callers hand over at most BATCH_LANES lanes at a time, which keeps the lanes of a whole small matrix in cache.
+         * */
+        const size_t BATCH_LANES = 256;
+
+        /*
+         * c = a * b for every lane, where a is m by k and b is k by n.
+         * */
+        template <class T>
+        void batch_gemm_scalar(size_t m, size_t n, size_t k, const T* a, const T* b, T* c, size_t ld, size_t lanes) {
+            for (size_t r = 0; r < m; r++) {
+                for (size_t j = 0; j < n; j++) {
+                    T* out = c + (r * n + j) * ld;
+                    std::fill(out, out + lanes, T());
+                    for (size_t p = 0; p < k; p++) {
+                        const T* x = a + (r * k + p) * ld;
+                        const T* y = b + (p * n + j) * ld;
+                        for (size_t i = 0; i < lanes; i++) {
+                            out[i] += x[i] * y[i];
+                        }
+                    }
+                }
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        void batch_gemm_avx2(size_t m, size_t n, size_t k, const T* a, const T* b, T* c, size_t ld, size_t lanes) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            for (size_t r = 0; r < m; r++) {
+                for (size_t j = 0; j < n; j++) {
+                    T* out = c + (r * n + j) * ld;
+                    size_t i = 0;
+                    for (; i + w <= lanes; i += w) {
+                        typename S::avx2_type acc = S::avx2_set1(T());
+                        for (size_t p = 0; p < k; p++) {
+                            acc = S::avx2_fmadd(S::avx2_load(a + (r * k + p) * ld + i), S::avx2_load(b + (p * n + j) * ld + i), acc);
+                        }
+                        S::avx2_store(out + i, acc);
+                    }
+                    for (; i < lanes; i++) {
+                        T acc = T();
+                        for (size_t p = 0; p < k; p++) {
+                            acc += a[(r * k + p) * ld + i] * b[(p * n + j) * ld + i];
+                        }
+                        out[i] = acc;
+                    }
+                }
+            }
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        void batch_gemm_avx512(size_t m, size_t n, size_t k, const T* a, const T* b, T* c, size_t ld, size_t lanes) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            for (size_t r = 0; r < m; r++) {
+                for (size_t j = 0; j < n; j++) {
+                    T* out = c + (r * n + j) * ld;
+                    size_t i = 0;
+                    for (; i + w <= lanes; i += w) {
+                        typename S::avx512_type acc = S::avx512_set1(T());
+                        for (size_t p = 0; p < k; p++) {
+                            acc = S::avx512_fmadd(S::avx512_load(a + (r * k + p) * ld + i), S::avx512_load(b + (p * n + j) * ld + i), acc);
+                        }
+                        S::avx512_store(out + i, acc);
+                    }
+                    if (i < lanes) {
+                        const typename S::avx512_mask mask = S::avx512_tail_mask(lanes - i);
+                        typename S::avx512_type acc = S::avx512_set1(T());
+                        for (size_t p = 0; p < k; p++) {
+                            acc = S::avx512_fmadd(S::avx512_mask_load(mask, a + (r * k + p) * ld + i),
+                                                  S::avx512_mask_load(mask, b + (p * n + j) * ld + i), acc);
+                        }
+                        S::avx512_mask_store(out + i, mask, acc);
+                    }
+                }
+            }
+        }
+#endif
+
+        template <class T>
+        void batch_gemm(size_t m, size_t n, size_t k, const T* a, const T* b, T* c, size_t ld, size_t lanes, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    batch_gemm_avx512(m, n, k, a, b, c, ld, lanes);
+                    return;
+                case SIMD_AVX2:
+                    batch_gemm_avx2(m, n, k, a, b, c, ld, lanes);
+                    return;
+                default:
+                    break;
+            }
+#endif
+            batch_gemm_scalar(m, n, k, a, b, c, ld, lanes);
+        }
+
+        template <class T>
+        void batch_gemm(size_t m, size_t n, size_t k, const T* a, const T* b, T* c, size_t ld, size_t lanes, std::false_type) {
+            batch_gemm_scalar(m, n, k, a, b, c, ld, lanes);
+        }
+
+        /*
+         * y[i] -= a[i] * x[i] over contiguous spans of `n` elements.
+         * */
+        template <class T>
+        void multiply_subtract_scalar(size_t n, const T* a, const T* x, T* y) {
+            for (size_t i = 0; i < n; i++) {
+                y[i] -= a[i] * x[i];
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        template <class T>
+        __attribute__((target("avx2,fma")))
+        void multiply_subtract_avx2(size_t n, const T* a, const T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                S::avx2_store(y + i, S::avx2_fnmadd(S::avx2_load(a + i), S::avx2_load(x + i), S::avx2_load(y + i)));
+            }
+            for (; i < n; i++) {
+                y[i] -= a[i] * x[i];
+            }
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        void multiply_subtract_avx512(size_t n, const T* a, const T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                S::avx512_store(y + i, S::avx512_fnmadd(S::avx512_load(a + i), S::avx512_load(x + i), S::avx512_load(y + i)));
+            }
+            if (i < n) {
+                const typename S::avx512_mask mask = S::avx512_tail_mask(n - i);
+                S::avx512_mask_store(y + i, mask, S::avx512_fnmadd(S::avx512_mask_load(mask, a + i), S::avx512_mask_load(mask, x + i),
+                                                                   S::avx512_mask_load(mask, y + i)));
+            }
+        }
+#endif
+
+        template <class T>
+        void multiply_subtract(size_t n, const T* a, const T* x, T* y, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    multiply_subtract_avx512(n, a, x, y);
+                    return;
+                case SIMD_AVX2:
+                    multiply_subtract_avx2(n, a, x, y);
+                    return;
+                default:
+                    break;
+            }
+#endif
+            multiply_subtract_scalar(n, a, x, y);
+        }
+
+        template <class T>
+        void multiply_subtract(size_t n, const T* a, const T* x, T* y, std::false_type) {
+            multiply_subtract_scalar(n, a, x, y);
+        }
+
+        /*
+         * Swap x[i] and y[i] wherever bit i of the mask words is set.
+         * */
+        template <class T>
+        void swap_where_scalar(size_t n, const uint64_t* words, T* x, T* y) {
+            for (size_t i = 0; i < n; i++) {
+                if ((words[i / MASK_WORD_BITS] >> (i % MASK_WORD_BITS)) & 1) {
+                    std::swap(x[i], y[i]);
+                }
+            }
+        }
+
+#if NUMPP_X86_SIMD
+        template <class T>
+        __attribute__((target("avx2")))
+        void swap_where_avx2(size_t n, const uint64_t* words, T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx2_width;
+            size_t i = 0;
+            for (; i + w <= n; i += w) {
+                const unsigned bits = static_cast<unsigned>(mask_bits(words, i, w));
+                if (bits != 0) {
+                    const __m256i lanes = S::avx2_lanes(bits);
+                    const typename S::avx2_type vx = S::avx2_load(x + i);
+                    const typename S::avx2_type vy = S::avx2_load(y + i);
+                    S::avx2_store(x + i, S::avx2_select(lanes, vy, vx));
+                    S::avx2_store(y + i, S::avx2_select(lanes, vx, vy));
+                }
+            }
+            for (; i < n; i++) {
+                if ((words[i / MASK_WORD_BITS] >> (i % MASK_WORD_BITS)) & 1) {
+                    std::swap(x[i], y[i]);
+                }
+            }
+        }
+
+        template <class T>
+        __attribute__((target("avx512f")))
+        void swap_where_avx512(size_t n, const uint64_t* words, T* x, T* y) {
+            typedef SimdTraits<T> S;
+            const size_t w = S::avx512_width;
+            for (size_t i = 0; i < n; i += w) {
+                const typename S::avx512_mask bits = static_cast<typename S::avx512_mask>(mask_bits(words, i, std::min(w, n - i)));
+                if (bits != 0) {
+                    // Only lanes whose bit is set are loaded and stored, so the tail needs no special case.
+                    const typename S::avx512_type vx = S::avx512_mask_load(bits, x + i);
+                    const typename S::avx512_type vy = S::avx512_mask_load(bits, y + i);
+                    S::avx512_mask_store(x + i, bits, vy);
+                    S::avx512_mask_store(y + i, bits, vx);
+                }
+            }
+        }
+#endif
+
+        template <class T>
+        void swap_where(size_t n, const uint64_t* words, T* x, T* y, std::true_type) {
+#if NUMPP_X86_SIMD
+            switch (simd_level()) {
+                case SIMD_AVX512:
+                    swap_where_avx512(n, words, x, y);
+                    return;
+                case SIMD_AVX2:
+                    swap_where_avx2(n, words, x, y);
+                    return;
+                default:
+                    break;
+            }
+#endif
+            swap_where_scalar(n, words, x, y);
+        }
+
+        template <class T>
+        void swap_where(size_t n, const uint64_t* words, T* x, T* y, std::false_type) {
+            swap_where_scalar(n, words, x, y);
+        }
+
+        /*
+         * Determinants of `lanes` matrices of size 1 to 4 from their closed forms, as SmallSquare computes them.
+         * */
+        template <class T>
+        void batch_small_determinant(size_t n, const T* a, size_t ld, size_t lanes, T* det) {
+            typedef typename SimdTraits<T>::vectorized vectorized;
+            const BinaryKernel<T> mul = binary_kernel<T>(OP_MUL);
+            T minor1[BATCH_LANES];
+            T minor2[BATCH_LANES];
+            // out = a[p] a[q] - a[r] a[s], elements given by their row-major index.
+            auto minor = [&](size_t p, size_t q, size_t r, size_t s, T* out) {
+                mul(lanes, a + p * ld, a + q * ld, out);
+                multiply_subtract(lanes, a + r * ld, a + s * ld, out, vectorized());
+            };
+
+            switch (n) {
+                case 1:
+                    std::copy(a, a + lanes, det);
+                    return;
+                case 2:
+                    minor(0, 3, 1, 2, det);
+                    return;
+                case 3:
+                    // a00 (a11 a22 - a12 a21) - a01 (a10 a22 - a12 a20) - a02 (a11 a20 - a10 a21)
+                    minor(4, 8, 5, 7, minor1);
+                    mul(lanes, a, minor1, det);
+                    minor(3, 8, 5, 6, minor1);
+                    multiply_subtract(lanes, a + ld, minor1, det, vectorized());
+                    minor(4, 6, 3, 7, minor1);
+                    multiply_subtract(lanes, a + 2 * ld, minor1, det, vectorized());
+                    return;
+                default: {
+                    // Laplace expansion along the first two rows: det = s0 c5 - s1 c4 + s2 c3 + s3 c2 - s4 c1 + s5 c0,
+                    // with the minors of the last two rows negated where the sign is +, so every term is subtracted.
+                    static const size_t terms[6][8] = {
+                            {0, 5, 4, 1, 10, 15, 14, 11},
+                            {0, 6, 4, 2, 9, 15, 13, 11},
+                            {0, 7, 4, 3, 13, 10, 9, 14},
+                            {1, 6, 5, 2, 12, 11, 8, 15},
+                            {1, 7, 5, 3, 8, 14, 12, 10},
+                            {2, 7, 6, 3, 12, 9, 8, 13}
+                    };
+                    for (size_t t = 0; t < 6; t++) {
+                        minor(terms[t][0], terms[t][1], terms[t][2], terms[t][3], minor1);
+                        minor(terms[t][4], terms[t][5], terms[t][6], terms[t][7], minor2);
+                        if (t == 0) {
+                            mul(lanes, minor1, minor2, det);
+                        }
+                        else {
+                            multiply_subtract(lanes, minor1, minor2, det, vectorized());
+                        }
+                    }
+                    return;
+                }
+            }
+        }
+
+        /*
+         * Gaussian elimination with partial pivoting on `lanes` (at most BATCH_LANES) augmented matrices [A | B] at once,
+         * where every A is n by n and every B is n by k, so each row holds n + k elements. On return the A part
+         * holds U and the B part holds the solution X of A X = B; with k = 0 only A is reduced.
+         * Keeping both parts in one buffer lets every update walk a single set of arrays.
+         *
+         * Pivots are chosen per lane. Row swaps are applied with blends to the lanes that need them, and `sign`
+         * (if not null) has its lanes negated on every swap. Lanes that meet a zero pivot get their `singular` flag set;
+         * the rest of their results is meaningless.
+         * */
+        template <class T>
+        void batch_gauss_solve(size_t n, size_t k, T* ab, size_t ld, size_t lanes, T* sign, unsigned char* singular) {
+            typedef typename SimdTraits<T>::vectorized vectorized;
+            typedef decltype(std::abs(T())) Real;
+            Real largest[BATCH_LANES];
+            size_t pivot[BATCH_LANES];
+            T factor[BATCH_LANES];
+            uint64_t words[BATCH_LANES / MASK_WORD_BITS];
+            const BinaryKernel<T> divide = binary_kernel<T>(OP_DIV);
+            const size_t width = n + k;
+
+            for (size_t j = 0; j < n; j++) {
+                // Pivot search, lane by lane: each pass over a row reads one contiguous array.
+                const T* diagonal = ab + (j * width + j) * ld;
+                for (size_t i = 0; i < lanes; i++) {
+                    largest[i] = std::abs(diagonal[i]);
+                    pivot[i] = j;
+                }
+                for (size_t r = j + 1; r < n; r++) {
+                    const T* element = ab + (r * width + j) * ld;
+                    for (size_t i = 0; i < lanes; i++) {
+                        const Real value = std::abs(element[i]);
+                        if (value > largest[i]) {
+                            largest[i] = value;
+                            pivot[i] = r;
+                        }
+                    }
+                }
+                for (size_t i = 0; i < lanes; i++) {
+                    if (largest[i] == Real()) {
+                        singular[i] = 1;
+                    }
+                }
+
+                for (size_t r = j + 1; r < n; r++) {
+                    std::fill(words, words + mask_word_count(lanes), uint64_t(0));
+                    bool any = false;
+                    for (size_t i = 0; i < lanes; i++) {
+                        if (pivot[i] == r) {
+                            words[i / MASK_WORD_BITS] |= uint64_t(1) << (i % MASK_WORD_BITS);
+                            any = true;
+                            if (sign) {
+                                sign[i] = -sign[i];
+                            }
+                        }
+                    }
+                    if (!any) {
+                        continue;
+                    }
+                    // Columns left of j are already zero below the diagonal, and unused afterwards.
+                    for (size_t c = j; c < width; c++) {
+                        swap_where(lanes, words, ab + (j * width + c) * ld, ab + (r * width + c) * ld, vectorized());
+                    }
+                }
+
+                for (size_t r = j + 1; r < n; r++) {
+                    divide(lanes, ab + (r * width + j) * ld, diagonal, factor);
+                    for (size_t c = j + 1; c < width; c++) {
+                        multiply_subtract(lanes, factor, ab + (j * width + c) * ld, ab + (r * width + c) * ld, vectorized());
+                    }
+                }
+            }
+
+            // Back substitution with U.
+            for (size_t r = n; r-- > 0;) {
+                for (size_t c = r + 1; c < n; c++) {
+                    for (size_t q = n; q < width; q++) {
+                        multiply_subtract(lanes, ab + (r * width + c) * ld, ab + (c * width + q) * ld, ab + (r * width + q) * ld,
+                                          vectorized());
+                    }
+                }
+                for (size_t q = n; q < width; q++) {
+                    divide(lanes, ab + (r * width + q) * ld, ab + (r * width + r) * ld, ab + (r * width + q) * ld);
+                }
+            }
+        }
+    }
+}
+
+#endif //NUMPP_KERNELS_H
@@ -0,0 +1,619 @@
+#ifndef NUMPP_MASK_H
+#define NUMPP_MASK_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPParallel.h"
+#include "NumPPExpression.h"
+#include "NumPPStats.h"
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+namespace numpp {
+    /*
+     * Boolean masks: comparisons, where() and masked assignment.
+     *
+     * Comparisons take the same operands as the arithmetic operators (matrices, sections, expressions and scalars)
+     * and are evaluated at once into a bit-packed Mask, a SIMD register of elements at a time.
+     * where() and masked assignment read the mask a register's worth of bits at a time and blend
+     * (or store through a lane mask), so they never branch on single elements on the SIMD paths.
+     * */
+    Mask::Mask() : _words(), _rows(0), _cols(0) {}
+
+    Mask::Mask(size_t rows, size_t cols, bool value) :
+            _words(kernels::mask_word_count(rows * cols)), _rows(rows), _cols(cols) {
+        std::fill(_words.data(), _words.data() + _words.size(), value ? ~uint64_t(0) : uint64_t(0));
+        clearPadding();
+    }
+
+    void Mask::clearPadding() {
+        const size_t used = _rows * _cols % kernels::MASK_WORD_BITS;
+        if (used != 0) {
+            _words.data()[_words.size() - 1] &= (uint64_t(1) << used) - 1;
+        }
+    }
+
+    std::vector<size_t> Mask::shape() const {
+        return std::vector<size_t>{_rows, _cols};
+    }
+
+    size_t Mask::rowCount() const {
+        return _rows;
+    }
+
+    size_t Mask::colCount() const {
+        return _cols;
+    }
+
+    bool Mask::at(size_t x, size_t y) const {
+        const size_t i = x * _cols + y;
+        return (_words.data()[i / kernels::MASK_WORD_BITS] >> (i % kernels::MASK_WORD_BITS)) & 1;
+    }
+
+    void Mask::set(size_t x, size_t y, bool value) {
+        const size_t i = x * _cols + y;
+        const uint64_t bit = uint64_t(1) << (i % kernels::MASK_WORD_BITS);
+        uint64_t& word = _words.data()[i / kernels::MASK_WORD_BITS];
+        word = value ? word | bit : word & ~bit;
+    }
+
+    size_t Mask::count() const {
+        return kernels::count_bits(_words.size(), _words.data());
+    }
+
+    bool Mask::any() const {
+        const uint64_t* words = _words.data();
+        return std::any_of(words, words + _words.size(), [](uint64_t word) { return word != 0; });
+    }
+
+    bool Mask::all() const {
+        return count() == _rows * _cols;
+    }
+
+    template <class U>
+    BasicMatrix<U> Mask::astype() const {
+        BasicMatrix<U> res(_rows, _cols, U(0));
+        U* data = res.dataHolder();
+        const uint64_t* words = _words.data();
+        for (size_t w = 0; w < _words.size(); w++) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                data[w * kernels::MASK_WORD_BITS + kernels::lowest_bit(bits)] = U(1);
+            }
+        }
+        return res;
+    }
+
+    uint64_t* Mask::dataHolder() {
+        return _words.data();
+    }
+
+    const uint64_t* Mask::dataHolder() const {
+        return _words.data();
+    }
+
+    size_t Mask::wordCount() const {
+        return _words.size();
+    }
+
+    Mask Mask::operator~() const {
+        Mask res = *this;
+        uint64_t* words = res._words.data();
+        for (size_t w = 0; w < res._words.size(); w++) {
+            words[w] = ~words[w];
+        }
+        res.clearPadding();
+        return res;
+    }
+
+    Mask& Mask::operator&=(const Mask& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            throw IllegalArithmeticsException{"To combine two masks, their shapes must be the same."};
+        }
+        uint64_t* words = _words.data();
+        const uint64_t* other_words = other._words.data();
+        for (size_t w = 0; w < _words.size(); w++) {
+            words[w] &= other_words[w];
+        }
+        return *this;
+    }
+
+    Mask& Mask::operator|=(const Mask& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            throw IllegalArithmeticsException{"To combine two masks, their shapes must be the same."};
+        }
+        uint64_t* words = _words.data();
+        const uint64_t* other_words = other._words.data();
+        for (size_t w = 0; w < _words.size(); w++) {
+            words[w] |= other_words[w];
+        }
+        return *this;
+    }
+
+    Mask& Mask::operator^=(const Mask& other) {
+        if (!(_rows == other._rows && _cols == other._cols)) {
+            throw IllegalArithmeticsException{"To combine two masks, their shapes must be the same."};
+        }
+        uint64_t* words = _words.data();
+        const uint64_t* other_words = other._words.data();
+        for (size_t w = 0; w < _words.size(); w++) {
+            words[w] ^= other_words[w];
+        }
+        return *this;
+    }
+
+    Mask operator&(const Mask& mask1, const Mask& mask2) {
+        Mask res = mask1;
+        return res &= mask2;
+    }
+
+    Mask operator|(const Mask& mask1, const Mask& mask2) {
+        Mask res = mask1;
+        return res |= mask2;
+    }
+
+    Mask operator^(const Mask& mask1, const Mask& mask2) {
+        Mask res = mask1;
+        return res ^= mask2;
+    }
+
+    size_t count_nonzero(const Mask& mask) {
+        return mask.count();
+    }
+
+    template <class Scalar>
+    size_t count_nonzero(const BasicMatrix<Scalar>& matrix) {
+        return (matrix != Scalar()).count();
+    }
+
+    /*
+     * Nodes of the two operands of a comparison or of where(), as for the arithmetic operators (see BinaryResult).
+     * */
+    template <class L, class R,
+              bool Valid = OperandTraits<L>::is_operand && OperandTraits<R>::is_operand
+                           && (OperandTraits<L>::is_matrix_like || OperandTraits<R>::is_matrix_like)>
+    struct MaskOperands {};
+
+    template <class L, class R>
+    struct MaskOperands<L, R, true> {
+        typedef typename std::conditional<OperandTraits<L>::is_matrix_like,
+                                          typename OperandTraits<L>::value_type,
+                                          typename OperandTraits<R>::value_type>::type value_type;
+        typedef typename OperandTraits<L>::template node<value_type>::type lhs_node;
+        typedef typename OperandTraits<R>::template node<value_type>::type rhs_node;
+
+        typedef Mask comparison_type;
+        typedef BasicMatrix<value_type> selection_type;
+    };
+
+    /*
+     * Set bit i + (c - c_begin) of `words` for every column c in [c_begin, c_end) where `lhs` Op `rhs` holds.
+     * */
+    template <class Op, class LC, class RC>
+    void compare_scalar(const LC& lhs, const RC& rhs, size_t c_begin, size_t c_end, uint64_t* words, size_t i) {
+        for (size_t c = c_begin; c < c_end; c++, i++) {
+            if (Op::scalar(lhs.at(c), rhs.at(c))) {
+                words[i / kernels::MASK_WORD_BITS] |= uint64_t(1) << (i % kernels::MASK_WORD_BITS);
+            }
+        }
+    }
+
+#if NUMPP_X86_SIMD
+    template <class Op, class Scalar, class LC, class RC>
+    __attribute__((target("sse2")))
+    void compare_sse2(const LC& lhs, const RC& rhs, size_t c, size_t c_end, uint64_t* words, size_t i) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        for (; c + Simd::sse2_width <= c_end; c += Simd::sse2_width, i += Simd::sse2_width) {
+            kernels::put_mask_bits(words, i, Op::sse2(lhs.sse2(c), rhs.sse2(c)), Simd::sse2_width);
+        }
+        compare_scalar<Op>(lhs, rhs, c, c_end, words, i);
+    }
+
+    template <class Op, class Scalar, class LC, class RC>
+    __attribute__((target("avx2")))
+    void compare_avx2(const LC& lhs, const RC& rhs, size_t c, size_t c_end, uint64_t* words, size_t i) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        for (; c + Simd::avx2_width <= c_end; c += Simd::avx2_width, i += Simd::avx2_width) {
+            kernels::put_mask_bits(words, i, Op::avx2(lhs.avx2(c), rhs.avx2(c)), Simd::avx2_width);
+        }
+        compare_scalar<Op>(lhs, rhs, c, c_end, words, i);
+    }
+
+    template <class Op, class Scalar, class LC, class RC>
+    __attribute__((target("avx512f")))
+    void compare_avx512(const LC& lhs, const RC& rhs, size_t c, size_t c_end, uint64_t* words, size_t i) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        for (; c + Simd::avx512_width <= c_end; c += Simd::avx512_width, i += Simd::avx512_width) {
+            kernels::put_mask_bits(words, i, Op::avx512(lhs.avx512(c), rhs.avx512(c)), Simd::avx512_width);
+        }
+        compare_scalar<Op>(lhs, rhs, c, c_end, words, i);
+    }
+#endif
+
+    /*
+     * The last parameter is kernels::SimdTraits<Scalar>::vectorized.
+     * */
+    template <class Op, class Scalar, class LC, class RC>
+    void compare_row(const LC& lhs, const RC& rhs, size_t c_begin, size_t c_end, uint64_t* words, size_t i, std::true_type) {
+#if NUMPP_X86_SIMD
+        switch (kernels::simd_level()) {
+            case kernels::SIMD_AVX512:
+                compare_avx512<Op, Scalar>(lhs, rhs, c_begin, c_end, words, i);
+                return;
+            case kernels::SIMD_AVX2:
+                compare_avx2<Op, Scalar>(lhs, rhs, c_begin, c_end, words, i);
+                return;
+            case kernels::SIMD_SSE2:
+                compare_sse2<Op, Scalar>(lhs, rhs, c_begin, c_end, words, i);
+                return;
+            default:
+                break;
+        }
+#endif
+        compare_scalar<Op>(lhs, rhs, c_begin, c_end, words, i);
+    }
+
+    template <class Op, class Scalar, class LC, class RC>
+    void compare_row(const LC& lhs, const RC& rhs, size_t c_begin, size_t c_end, uint64_t* words, size_t i, std::false_type) {
+        compare_scalar<Op>(lhs, rhs, c_begin, c_end, words, i);
+    }
+
+    /*
+     * Compare the elements [begin, end) in row-major order, reading rows through RowAccess<..., BroadcastColumns>.
+     * */
+    template <class Op, bool BroadcastColumns, class L, class R>
+    void compare_elements(const L& lhs, const R& rhs, size_t cols, size_t begin, size_t end, uint64_t* words) {
+        typedef typename L::value_type Scalar;
+        size_t r = begin / cols;
+        size_t c = begin % cols;
+        for (size_t i = begin; i < end; r++, c = 0) {
+            const size_t n = std::min(cols - c, end - i);
+            compare_row<Op, Scalar>(RowAccess<L, BroadcastColumns>::row(lhs, r), RowAccess<R, BroadcastColumns>::row(rhs, r),
+                                    c, c + n, words, i, typename kernels::SimdTraits<Scalar>::vectorized());
+            i += n;
+        }
+    }
+
+    template <class Op, class L, class R>
+    Mask compare(const L& lhs, const R& rhs) {
+        static_assert(std::is_same<typename L::value_type, typename R::value_type>::value,
+                      "Comparisons need matrices of the same element type; convert one with astype<U>().");
+        NUMPP_STATS_PROFILE("compare");
+
+        if (L::has_shape && R::has_shape && (lhs.rows() != rhs.rows() || lhs.cols() != rhs.cols())) {
+            throw IllegalArithmeticsException{"To compare two matrices element-wise, their shapes must be the same."};
+        }
+        const size_t rows = L::has_shape ? lhs.rows() : rhs.rows();
+        const size_t cols = L::has_shape ? lhs.cols() : rhs.cols();
+
+        Mask mask(rows, cols, false);
+        uint64_t* words = mask.dataHolder();
+        const bool broadcast = lhs.broadcasts_columns() || rhs.broadcasts_columns();
+        // Chunks start at whole words, so no two threads write to the same word.
+        parallel::parallel_for(0, rows * cols, parallel::MIN_ELEMENTS_PER_TASK, [&](size_t begin, size_t end) {
+            if (broadcast) {
+                compare_elements<Op, true>(lhs, rhs, cols, begin, end, words);
+            }
+            else {
+                compare_elements<Op, false>(lhs, rhs, cols, begin, end, words);
+            }
+        }, kernels::MASK_WORD_BITS);
+        return mask;
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator<(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::LessOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                        typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator<=(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::LessEqualOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                             typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator>(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::GreaterOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                           typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator>=(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::GreaterEqualOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                                typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator==(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::EqualOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                         typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    template <class L, class R>
+    typename MaskOperands<L, R>::comparison_type operator!=(L&& lhs, R&& rhs) {
+        typedef MaskOperands<L, R> Operands;
+        return compare<kernels::NotEqualOp>(typename Operands::lhs_node(std::forward<L>(lhs)),
+                                            typename Operands::rhs_node(std::forward<R>(rhs)));
+    }
+
+    /*
+     * out[c] = mask bit ? lhs[c] : rhs[c] for the columns from c to `cols` of a row, where bit i belongs to column c.
+     * */
+    template <class LC, class RC, class Scalar>
+    void select_scalar(const uint64_t* words, size_t i, const LC& lhs, const RC& rhs, Scalar* out, size_t c, size_t cols) {
+        for (; c < cols; c++, i++) {
+            out[c] = (words[i / kernels::MASK_WORD_BITS] >> (i % kernels::MASK_WORD_BITS)) & 1 ? lhs.at(c) : rhs.at(c);
+        }
+    }
+
+#if NUMPP_X86_SIMD
+    template <class LC, class RC, class Scalar>
+    __attribute__((target("avx2")))
+    void select_avx2(const uint64_t* words, size_t i, const LC& lhs, const RC& rhs, Scalar* out, size_t cols) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        size_t c = 0;
+        for (; c + Simd::avx2_width <= cols; c += Simd::avx2_width) {
+            const __m256i lanes = Simd::avx2_lanes(static_cast<unsigned>(kernels::mask_bits(words, i + c, Simd::avx2_width)));
+            Simd::avx2_store(out + c, Simd::avx2_select(lanes, lhs.avx2(c), rhs.avx2(c)));
+        }
+        select_scalar(words, i + c, lhs, rhs, out, c, cols);
+    }
+
+    template <class LC, class RC, class Scalar>
+    __attribute__((target("avx512f")))
+    void select_avx512(const uint64_t* words, size_t i, const LC& lhs, const RC& rhs, Scalar* out, size_t cols) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        size_t c = 0;
+        for (; c + Simd::avx512_width <= cols; c += Simd::avx512_width) {
+            const typename Simd::avx512_mask bits =
+                    static_cast<typename Simd::avx512_mask>(kernels::mask_bits(words, i + c, Simd::avx512_width));
+            Simd::avx512_store(out + c, Simd::avx512_select(bits, lhs.avx512(c), rhs.avx512(c)));
+        }
+        select_scalar(words, i + c, lhs, rhs, out, c, cols);
+    }
+#endif
+
+    /*
+     * The last parameter is kernels::SimdTraits<Scalar>::vectorized.
+     * SSE2 has no blend instruction, so that level uses the scalar loop.
+     * */
+    template <class LC, class RC, class Scalar>
+    void select_row(const uint64_t* words, size_t i, const LC& lhs, const RC& rhs, Scalar* out, size_t cols, std::true_type) {
+#if NUMPP_X86_SIMD
+        switch (kernels::simd_level()) {
+            case kernels::SIMD_AVX512:
+                select_avx512(words, i, lhs, rhs, out, cols);
+                return;
+            case kernels::SIMD_AVX2:
+                select_avx2(words, i, lhs, rhs, out, cols);
+                return;
+            default:
+                break;
+        }
+#endif
+        select_scalar(words, i, lhs, rhs, out, 0, cols);
+    }
+
+    template <class LC, class RC, class Scalar>
+    void select_row(const uint64_t* words, size_t i, const LC& lhs, const RC& rhs, Scalar* out, size_t cols, std::false_type) {
+        select_scalar(words, i, lhs, rhs, out, 0, cols);
+    }
+
+    /*
+     * Elements of `a` where the mask is true and of `b` elsewhere. Either side may be a scalar,
+     * e.g. `numpp::where(mat < 0, 0.0, mat)` (like NumPy's `np.where`).
+     * */
+    template <bool BroadcastColumns, class L, class R, class Scalar>
+    void select_rows(const uint64_t* words, const L& lhs, const R& rhs, Scalar* out, size_t cols, size_t r_begin, size_t r_end) {
+        for (size_t r = r_begin; r < r_end; r++) {
+            select_row(words, r * cols, RowAccess<L, BroadcastColumns>::row(lhs, r), RowAccess<R, BroadcastColumns>::row(rhs, r),
+                       out + r * cols, cols, typename kernels::SimdTraits<Scalar>::vectorized());
+        }
+    }
+
+    template <class A, class B>
+    typename MaskOperands<A, B>::selection_type where(const Mask& mask, A&& a, B&& b) {
+        typedef MaskOperands<A, B> Operands;
+        typedef typename Operands::value_type Scalar;
+        NUMPP_STATS_PROFILE("where");
+
+        const typename Operands::lhs_node lhs(std::forward<A>(a));
+        const typename Operands::rhs_node rhs(std::forward<B>(b));
+        const size_t rows = mask.rowCount();
+        const size_t cols = mask.colCount();
+        if ((Operands::lhs_node::has_shape && (lhs.rows() != rows || lhs.cols() != cols))
+            || (Operands::rhs_node::has_shape && (rhs.rows() != rows || rhs.cols() != cols))) {
+            throw IllegalArithmeticsException{"The mask and the operands of where must have the same shape."};
+        }
+
+        BasicMatrix<Scalar> res(rows, cols, BasicAlignedBuffer<Scalar>(rows * cols));
+        Scalar* out = res.dataHolder();
+        const uint64_t* words = mask.dataHolder();
+        const bool broadcast = lhs.broadcasts_columns() || rhs.broadcasts_columns();
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(cols, 1) + 1;
+        parallel::parallel_for(0, rows, grain, [&](size_t r_begin, size_t r_end) {
+            if (broadcast) {
+                select_rows<true>(words, lhs, rhs, out, cols, r_begin, r_end);
+            }
+            else {
+                select_rows<false>(words, lhs, rhs, out, cols, r_begin, r_end);
+            }
+        });
+        return res;
+    }
+
+    /*
+     * out[c] = source[c] for the columns of a row whose mask bit (starting at bit i) is set.
+     * */
+    template <class C, class Scalar>
+    void assign_masked_scalar(const uint64_t* words, size_t i, const C& source, Scalar* out, size_t c, size_t cols) {
+        for (; c < cols; c += kernels::MASK_WORD_BITS) {
+            const size_t n = std::min(kernels::MASK_WORD_BITS, cols - c);
+            for (uint64_t bits = kernels::mask_bits(words, i + c, n); bits != 0; bits &= bits - 1) {
+                const size_t col = c + kernels::lowest_bit(bits);
+                out[col] = source.at(col);
+            }
+        }
+    }
+
+#if NUMPP_X86_SIMD
+    template <class C, class Scalar>
+    __attribute__((target("avx2")))
+    void assign_masked_avx2(const uint64_t* words, size_t i, const C& source, Scalar* out, size_t cols) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        size_t c = 0;
+        for (; c + Simd::avx2_width <= cols; c += Simd::avx2_width) {
+            const unsigned bits = static_cast<unsigned>(kernels::mask_bits(words, i + c, Simd::avx2_width));
+            if (bits != 0) {
+                Simd::avx2_mask_store(out + c, Simd::avx2_lanes(bits), source.avx2(c));
+            }
+        }
+        assign_masked_scalar(words, i, source, out, c, cols);
+    }
+
+    template <class C, class Scalar>
+    __attribute__((target("avx512f")))
+    void assign_masked_avx512(const uint64_t* words, size_t i, const C& source, Scalar* out, size_t cols) {
+        typedef kernels::SimdTraits<Scalar> Simd;
+        size_t c = 0;
+        for (; c + Simd::avx512_width <= cols; c += Simd::avx512_width) {
+            const typename Simd::avx512_mask bits =
+                    static_cast<typename Simd::avx512_mask>(kernels::mask_bits(words, i + c, Simd::avx512_width));
+            if (bits != 0) {
+                Simd::avx512_mask_store(out + c, bits, source.avx512(c));
+            }
+        }
+        assign_masked_scalar(words, i, source, out, c, cols);
+    }
+#endif
+
+    /*
+     * The last parameter is kernels::SimdTraits<Scalar>::vectorized.
+     * */
+    template <class C, class Scalar>
+    void assign_masked_row(const uint64_t* words, size_t i, const C& source, Scalar* out, size_t cols, std::true_type) {
+#if NUMPP_X86_SIMD
+        switch (kernels::simd_level()) {
+            case kernels::SIMD_AVX512:
+                assign_masked_avx512(words, i, source, out, cols);
+                return;
+            case kernels::SIMD_AVX2:
+                assign_masked_avx2(words, i, source, out, cols);
+                return;
+            default:
+                break;
+        }
+#endif
+        assign_masked_scalar(words, i, source, out, 0, cols);
+    }
+
+    template <class C, class Scalar>
+    void assign_masked_row(const uint64_t* words, size_t i, const C& source, Scalar* out, size_t cols, std::false_type) {
+        assign_masked_scalar(words, i, source, out, 0, cols);
+    }
+
+    template <bool BroadcastColumns, class Node, class Scalar>
+    void assign_masked_rows(const uint64_t* words, const Node& source, Scalar* data, size_t stride, size_t cols,
+                            size_t r_begin, size_t r_end) {
+        for (size_t r = r_begin; r < r_end; r++) {
+            assign_masked_row(words, r * cols, RowAccess<Node, BroadcastColumns>::row(source, r), data + r * stride, cols,
+                              typename kernels::SimdTraits<Scalar>::vectorized());
+        }
+    }
+
+    /*
+     * Write the elements of `source` (an expression node) selected by `mask` into the row-major block at `data`.
+     * */
+    template <class Node, class Scalar>
+    void assign_masked(const Mask& mask, const Node& source, Scalar* data, size_t stride) {
+        const size_t rows = mask.rowCount();
+        const size_t cols = mask.colCount();
+        if (Node::has_shape && (source.rows() != rows || source.cols() != cols)) {
+            throw IllegalArithmeticsException{"To assign to masked elements, the shapes of the matrices must be the same."};
+        }
+        if (source.overlaps(data, rows, cols, stride)) {
+            // The source reads elements of the target at other positions: take a copy of it first.
+            BasicMatrix<Scalar> copy{source.rows(), source.cols(), BasicAlignedBuffer<Scalar>(source.rows() * source.cols())};
+            evaluate(source, copy.dataHolder(), copy.stride());
+            assign_masked(mask, MatrixReference<Scalar>(copy), data, stride);
+            return;
+        }
+
+        const uint64_t* words = mask.dataHolder();
+        const bool broadcast = source.broadcasts_columns();
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(cols, 1) + 1;
+        parallel::parallel_for(0, rows, grain, [&](size_t r_begin, size_t r_end) {
+            if (broadcast) {
+                assign_masked_rows<true>(words, source, data, stride, cols, r_begin, r_end);
+            }
+            else {
+                assign_masked_rows<false>(words, source, data, stride, cols, r_begin, r_end);
+            }
+        });
+    }
+
+    template <class Scalar>
+    BasicMaskedView<Scalar> BasicMatrix<Scalar>::operator[](Mask mask) {
+        return BasicMaskedView<Scalar>{this, std::move(mask)};
+    }
+
+    template <class Scalar>
+    BasicMaskedView<Scalar>::BasicMaskedView(BasicMatrix<Scalar>* matrix, Mask mask) : _matrix(matrix), _mask(std::move(mask)) {
+        if (!(_mask.rowCount() == matrix->rowCount() && _mask.colCount() == matrix->colCount())) {
+            throw IllegalArithmeticsException{"A mask must have the same shape as the matrix it selects from."};
+        }
+    }
+
+    template <class Scalar>
+    const Mask& BasicMaskedView<Scalar>::mask() const {
+        return _mask;
+    }
+
+    template <class Scalar>
+    size_t BasicMaskedView<Scalar>::count() const {
+        return _mask.count();
+    }
+
+    template <class Scalar>
+    BasicMaskedView<Scalar>& BasicMaskedView<Scalar>::operator=(Scalar value) {
+        assign_masked(_mask, ScalarOperand<Scalar>(value), _matrix->dataHolder(), _matrix->stride());
+        return *this;
+    }
+
+    template <class Scalar>
+    BasicMaskedView<Scalar>& BasicMaskedView<Scalar>::operator=(const BasicMatrix<Scalar>& values) {
+        assign_masked(_mask, MatrixReference<Scalar>(values), _matrix->dataHolder(), _matrix->stride());
+        return *this;
+    }
+
+    template <class Scalar>
+    template <class E>
+    BasicMaskedView<Scalar>& BasicMaskedView<Scalar>::operator=(const MatrixExpression<E>& values) {
+        assign_masked(_mask, values.derived(), _matrix->dataHolder(), _matrix->stride());
+        return *this;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicMaskedView<Scalar>::eval() const {
+        BasicMatrix<Scalar> res(1, _mask.count(), BasicAlignedBuffer<Scalar>(_mask.count()));
+        Scalar* out = res.dataHolder();
+        const uint64_t* words = _mask.dataHolder();
+        const size_t cols = _mask.colCount();
+        for (size_t w = 0; w < _mask.wordCount(); w++) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                const size_t i = w * kernels::MASK_WORD_BITS + kernels::lowest_bit(bits);
+                *out++ = _matrix->at(i / cols, i % cols);
+            }
+        }
+        return res;
+    }
+}
+
+#endif //NUMPP_MASK_H
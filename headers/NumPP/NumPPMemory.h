@@ -0,0 +1,241 @@
+#ifndef NUMPP_MEMORY_H
+#define NUMPP_MEMORY_H
+
+#include "NumPPDeclaration.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace numpp {
+    namespace memory {
+        /*
+         * The pool serves blocks of POOL_MIN_BLOCK << k bytes for k in [0, POOL_NUM_CLASSES), up to POOL_MAX_BLOCK.
+         * */
+        const size_t POOL_MIN_BLOCK = 64;
+        const size_t POOL_NUM_CLASSES = 15;
+        const size_t POOL_MAX_BLOCK = POOL_MIN_BLOCK << (POOL_NUM_CLASSES - 1);
+
+        /*
+         * A thread caches at most POOL_MAX_CACHED blocks and about POOL_CACHE_BYTES per size class.
+         * */
+        const size_t POOL_MAX_CACHED = 32;
+        const size_t POOL_CACHE_BYTES = 4 << 20;
+
+        /*
+         * Alignment of every block the pool and the arenas take from upstream.
+         * */
+        const size_t BLOCK_ALIGNMENT = 64;
+
+        class NewDeleteResource : public MemoryResource {
+        public:
+            void* allocate(size_t bytes, size_t alignment) override {
+                // Over-allocate so that both the aligned block and the original pointer (stored right before the block) fit.
+                void* raw = std::malloc(bytes + alignment + sizeof(void*));
+                if (raw == nullptr) {
+                    throw std::bad_alloc();
+                }
+
+                uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + alignment - 1)
+                        & ~static_cast<uintptr_t>(alignment - 1);
+                reinterpret_cast<void**>(aligned)[-1] = raw;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            void deallocate(void* p, size_t, size_t) override {
+                if (p != nullptr) {
+                    std::free(reinterpret_cast<void**>(p)[-1]);
+                }
+            }
+        };
+
+        size_t pool_class_size(size_t size_class) {
+            return POOL_MIN_BLOCK << size_class;
+        }
+
+        size_t pool_class_capacity(size_t size_class) {
+            return std::min(POOL_MAX_CACHED, std::max<size_t>(2, POOL_CACHE_BYTES / pool_class_size(size_class)));
+        }
+
+        /*
+         * Smallest size class holding `bytes`; only valid for bytes <= POOL_MAX_BLOCK.
+         * */
+        size_t pool_size_class(size_t bytes) {
+            size_t size_class = 0;
+            while (pool_class_size(size_class) < bytes) {
+                size_class++;
+            }
+            return size_class;
+        }
+
+        struct PoolCache {
+            void* blocks[POOL_NUM_CLASSES][POOL_MAX_CACHED];
+            size_t counts[POOL_NUM_CLASSES];
+
+            PoolCache();
+            ~PoolCache();
+        };
+
+        /*
+         * Set once the calling thread's cache has been destroyed, so buffers freed later during thread exit
+         * go straight back to the heap. A plain bool, so it outlives every other thread_local.
+         * */
+        bool& pool_cache_finished() {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        PoolCache::PoolCache() {
+            std::fill(counts, counts + POOL_NUM_CLASSES, 0);
+        }
+
+        PoolCache::~PoolCache() {
+            pool_cache_finished() = true;
+            MemoryResource* upstream = new_delete_resource();
+            for (size_t c = 0; c < POOL_NUM_CLASSES; c++) {
+                for (size_t i = 0; i < counts[c]; i++) {
+                    upstream->deallocate(blocks[c][i], pool_class_size(c), BLOCK_ALIGNMENT);
+                }
+                counts[c] = 0;
+            }
+        }
+
+        /*
+         * The calling thread's cache, or nullptr once the thread is shutting down.
+         * */
+        PoolCache* pool_cache() {
+            if (pool_cache_finished()) {
+                return nullptr;
+            }
+            static thread_local PoolCache cache;
+            return &cache;
+        }
+
+        class PoolResource : public MemoryResource {
+        public:
+            void* allocate(size_t bytes, size_t alignment) override {
+                if (bytes > POOL_MAX_BLOCK || alignment > BLOCK_ALIGNMENT) {
+                    return new_delete_resource()->allocate(bytes, alignment);
+                }
+
+                size_t size_class = pool_size_class(bytes);
+                PoolCache* cache = pool_cache();
+                if (cache != nullptr && cache->counts[size_class] > 0) {
+                    return cache->blocks[size_class][--cache->counts[size_class]];
+                }
+                return new_delete_resource()->allocate(pool_class_size(size_class), BLOCK_ALIGNMENT);
+            }
+
+            void deallocate(void* p, size_t bytes, size_t alignment) override {
+                if (bytes > POOL_MAX_BLOCK || alignment > BLOCK_ALIGNMENT) {
+                    new_delete_resource()->deallocate(p, bytes, alignment);
+                    return;
+                }
+
+                size_t size_class = pool_size_class(bytes);
+                PoolCache* cache = pool_cache();
+                if (cache != nullptr && cache->counts[size_class] < pool_class_capacity(size_class)) {
+                    cache->blocks[size_class][cache->counts[size_class]++] = p;
+                    return;
+                }
+                new_delete_resource()->deallocate(p, pool_class_size(size_class), BLOCK_ALIGNMENT);
+            }
+        };
+
+        /*
+         * Override installed by the innermost ScopedResource of the calling thread, if any.
+         * */
+        MemoryResource*& scoped_resource() {
+            static thread_local MemoryResource* resource = nullptr;
+            return resource;
+        }
+
+        std::atomic<MemoryResource*>& global_resource() {
+            static std::atomic<MemoryResource*> resource(new_delete_resource());
+            return resource;
+        }
+    }
+
+    MemoryResource* new_delete_resource() {
+        // Never destroyed, so buffers freed during static destruction can still reach it.
+        static MemoryResource* resource = new memory::NewDeleteResource();
+        return resource;
+    }
+
+    MemoryResource* pool_resource() {
+        static MemoryResource* resource = new memory::PoolResource();
+        return resource;
+    }
+
+    MemoryResource* get_default_resource() {
+        MemoryResource* scoped = memory::scoped_resource();
+        return scoped != nullptr ? scoped : memory::global_resource().load(std::memory_order_acquire);
+    }
+
+    MemoryResource* set_default_resource(MemoryResource* resource) {
+        return memory::global_resource().exchange(resource == nullptr ? new_delete_resource() : resource,
+                                                  std::memory_order_acq_rel);
+    }
+
+    ArenaResource::ArenaResource(size_t initial_size, MemoryResource* upstream) :
+            _upstream(upstream), _chunks(nullptr), _cursor(nullptr), _end(nullptr),
+            _initial_size(std::max<size_t>(initial_size, 1024)), _next_chunk_size(_initial_size) {}
+
+    ArenaResource::~ArenaResource() {
+        release();
+    }
+
+    void ArenaResource::grow(size_t min_bytes) {
+        // Chunks double in size, so a long-lived arena makes only a logarithmic number of upstream calls.
+        size_t size = std::max(_next_chunk_size, min_bytes + sizeof(Chunk));
+        Chunk* chunk = static_cast<Chunk*>(_upstream->allocate(size, memory::BLOCK_ALIGNMENT));
+        chunk->next = _chunks;
+        chunk->size = size;
+        _chunks = chunk;
+        _cursor = reinterpret_cast<char*>(chunk + 1);
+        _end = reinterpret_cast<char*>(chunk) + size;
+        _next_chunk_size = size * 2;
+    }
+
+    void* ArenaResource::allocate(size_t bytes, size_t alignment) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(_cursor) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        if (_cursor == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(_end)) {
+            grow(bytes + alignment);
+            aligned = (reinterpret_cast<uintptr_t>(_cursor) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        }
+        _cursor = reinterpret_cast<char*>(aligned + bytes);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void ArenaResource::deallocate(void* p, size_t bytes, size_t) {
+        if (static_cast<char*>(p) + bytes == _cursor) {
+            _cursor = static_cast<char*>(p);
+        }
+    }
+
+    void ArenaResource::release() {
+        while (_chunks != nullptr) {
+            Chunk* next = _chunks->next;
+            _upstream->deallocate(_chunks, _chunks->size, memory::BLOCK_ALIGNMENT);
+            _chunks = next;
+        }
+        _cursor = _end = nullptr;
+        _next_chunk_size = _initial_size;
+    }
+
+    ScopedResource::ScopedResource(MemoryResource* resource) : _previous(memory::scoped_resource()) {
+        memory::scoped_resource() = resource;
+    }
+
+    ScopedResource::~ScopedResource() {
+        memory::scoped_resource() = _previous;
+    }
+
+    ScopedArena::ScopedArena(size_t initial_size) : _arena(initial_size), _scope(&_arena) {}
+
+    ArenaResource& ScopedArena::resource() {
+        return _arena;
+    }
+}
+
+#endif //NUMPP_MEMORY_H
@@ -0,0 +1,268 @@
+#ifndef NUMPP_PARALLEL_H
+#define NUMPP_PARALLEL_H
+
+#include "NumPPDeclaration.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace numpp {
+    /*
+     * Thread-pool backend used by the heavy kernels.
+     *
+     * Work is split into independent chunks which the calling thread and the pool's workers take in turn,
+     * so a pool of n threads has n - 1 workers. Only inputs larger than the kernels' thresholds are split;
+     * everything else (and anything started from inside a parallel region) runs on the calling thread.
+     * */
+    namespace parallel {
+        /*
+         * Element-wise work below this many elements per chunk is not worth waking another thread for.
+         * */
+        const size_t MIN_ELEMENTS_PER_TASK = 1 << 15;
+
+        /*
+         * Matrix products below this many multiply-adds per chunk stay on one thread.
+         * */
+        const size_t MIN_FLOPS_PER_TASK = 64 * 64 * 64;
+
+        class ThreadPool {
+        private:
+            std::vector<std::thread> _workers;
+
+            std::mutex _mutex;
+            std::condition_variable _wake;
+            std::condition_variable _done;
+
+            /*
+             * The running job: `_task` is called with every index in [0, _num_tasks),
+             * `_next` hands out indexes, `_busy` counts workers still inside the job.
+             * `_generation` changes on every job so sleeping workers can tell a new job from a spurious wake-up.
+             * */
+            const std::function<void(size_t)>* _task;
+            size_t _num_tasks;
+            std::atomic<size_t> _next;
+            size_t _busy;
+            size_t _generation;
+            bool _stop;
+            std::exception_ptr _error;
+
+            /*
+             * Only one job runs at a time; other callers run their work serially instead of waiting.
+             * */
+            std::mutex _run_mutex;
+
+            void work();
+            void drain();
+
+        public:
+            explicit ThreadPool(size_t num_threads);
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            ~ThreadPool();
+
+            /*
+             * Number of threads taking part in a job, the calling thread included.
+             * */
+            size_t size() const;
+
+            /*
+             * Call `task(i)` for every i in [0, num_tasks) and return once all calls have finished.
+             * The first exception thrown by a task is rethrown here.
+             * */
+            void run(size_t num_tasks, const std::function<void(size_t)>& task);
+        };
+
+        /*
+         * Set while the current thread is executing a task, so nested parallel loops run serially.
+         * */
+        bool& in_parallel_region() {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        ThreadPool::ThreadPool(size_t num_threads) :
+                _task(nullptr), _num_tasks(0), _next(0), _busy(0), _generation(0), _stop(false) {
+            for (size_t i = 1; i < num_threads; i++) {
+                _workers.emplace_back(&ThreadPool::work, this);
+            }
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (std::thread& worker : _workers) {
+                worker.join();
+            }
+        }
+
+        size_t ThreadPool::size() const {
+            return _workers.size() + 1;
+        }
+
+        void ThreadPool::drain() {
+            in_parallel_region() = true;
+            for (size_t i = _next++; i < _num_tasks; i = _next++) {
+                try {
+                    (*_task)(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!_error) {
+                        _error = std::current_exception();
+                    }
+                    // Skip the remaining chunks.
+                    _next = _num_tasks;
+                }
+            }
+            in_parallel_region() = false;
+        }
+
+        void ThreadPool::work() {
+            size_t seen_generation = 0;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _wake.wait(lock, [&] { return _stop || _generation != seen_generation; });
+                if (_stop) {
+                    return;
+                }
+                seen_generation = _generation;
+                _busy++;
+                lock.unlock();
+
+                drain();
+
+                lock.lock();
+                if (--_busy == 0) {
+                    _done.notify_one();
+                }
+            }
+        }
+
+        void ThreadPool::run(size_t num_tasks, const std::function<void(size_t)>& task) {
+            std::unique_lock<std::mutex> run_lock(_run_mutex, std::try_to_lock);
+            if (_workers.empty() || num_tasks < 2 || in_parallel_region() || !run_lock.owns_lock()) {
+                for (size_t i = 0; i < num_tasks; i++) {
+                    task(i);
+                }
+                return;
+            }
+
+            {
+                // A worker that woke up too late for the previous job may still be leaving it.
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.wait(lock, [&] { return _busy == 0; });
+                _task = &task;
+                _num_tasks = num_tasks;
+                _next = 0;
+                _error = nullptr;
+                _generation++;
+            }
+            _wake.notify_all();
+
+            drain();
+
+            std::exception_ptr error;
+            {
+                // Workers still inside the job may be touching `task`, which goes away when we return.
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.wait(lock, [&] { return _busy == 0; });
+                _task = nullptr;
+                _num_tasks = 0;
+                error = _error;
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        /*
+         * NUMPP_NUM_THREADS if set to a positive number, otherwise the number of hardware threads.
+         * */
+        size_t default_num_threads() {
+            const char* env = std::getenv("NUMPP_NUM_THREADS");
+            if (env != nullptr) {
+                char* end = nullptr;
+                long value = std::strtol(env, &end, 10);
+                if (end != env && value > 0) {
+                    return static_cast<size_t>(value);
+                }
+            }
+            size_t hardware = std::thread::hardware_concurrency();
+            return hardware == 0 ? 1 : hardware;
+        }
+
+        std::unique_ptr<ThreadPool>& pool_holder() {
+            static std::unique_ptr<ThreadPool> holder;
+            return holder;
+        }
+
+        std::mutex& pool_mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        /*
+         * The shared pool, created on first use.
+         * */
+        ThreadPool& pool() {
+            std::lock_guard<std::mutex> lock(pool_mutex());
+            std::unique_ptr<ThreadPool>& holder = pool_holder();
+            if (!holder) {
+                holder.reset(new ThreadPool(default_num_threads()));
+            }
+            return *holder;
+        }
+
+        /*
+         * Split [begin, end) into chunks of at least `grain` indexes and call `body(chunk_begin, chunk_end)`
+         * for each of them, in parallel when there is more than one chunk.
+         * Chunks are only made a multiple of `align` long (except the last one), e.g. to keep whole register tiles together.
+         * */
+        template <class Body>
+        void parallel_for(size_t begin, size_t end, size_t grain, Body body, size_t align = 1) {
+            if (end <= begin) {
+                return;
+            }
+            const size_t length = end - begin;
+            size_t num_tasks = 1;
+            if (!in_parallel_region() && length >= 2 * grain) {
+                ThreadPool& threads = pool();
+                num_tasks = std::min(threads.size(), length / std::max<size_t>(grain, 1));
+            }
+            if (num_tasks <= 1) {
+                body(begin, end);
+                return;
+            }
+
+            size_t chunk = (length + num_tasks - 1) / num_tasks;
+            chunk = (chunk + align - 1) / align * align;
+            num_tasks = (length + chunk - 1) / chunk;
+            std::function<void(size_t)> task = [&](size_t i) {
+                const size_t chunk_begin = begin + i * chunk;
+                body(chunk_begin, std::min(chunk_begin + chunk, end));
+            };
+            pool().run(num_tasks, task);
+        }
+    }
+
+    void set_num_threads(size_t num_threads) {
+        std::lock_guard<std::mutex> lock(parallel::pool_mutex());
+        std::unique_ptr<parallel::ThreadPool>& holder = parallel::pool_holder();
+        holder.reset();
+        holder.reset(new parallel::ThreadPool(num_threads == 0 ? parallel::default_num_threads() : num_threads));
+    }
+
+    size_t get_num_threads() {
+        return parallel::pool().size();
+    }
+}
+
+#endif //NUMPP_PARALLEL_H
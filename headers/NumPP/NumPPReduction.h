@@ -0,0 +1,439 @@
+#ifndef NUMPP_REDUCTION_H
+#define NUMPP_REDUCTION_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPParallel.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace numpp {
+    /*
+     * Helpers of the reductions (sum, mean, var, min, max, argmin, argmax, norm, dot).
+     *
+     * Whole-matrix reductions split the elements into segments that do not depend on the number of threads:
+     * chunks of SEGMENT_SIZE elements when the rows are contiguous in memory, whole rows otherwise.
+     * Each segment is reduced on its own, possibly in parallel, and the partial results are combined in order,
+     * so a reduction gives bit-for-bit the same result however many threads ran it.
+     * */
+    namespace reduction {
+        const size_t SEGMENT_SIZE = parallel::MIN_ELEMENTS_PER_TASK;
+
+        void check_axis(Axis axis) {
+            if (axis != AXIS_0 && axis != AXIS_1) {
+                throw IllegalArithmeticsException("Axis is either 1 or 0.");
+            }
+        }
+
+        template <class Scalar>
+        bool is_contiguous(const BasicMatrix<Scalar>& matrix) {
+            return matrix.stride() == matrix.colCount() || matrix.rowCount() <= 1;
+        }
+
+        /*
+         * Call `reduce(row, col, length)` on every segment of a rows by cols matrix and return the results in order.
+         * When `contiguous`, segments may span several rows: they are passed as row 0 and an offset `col` into the storage.
+         * */
+        template <class R, class Reduce>
+        std::vector<R> reduce_segments(size_t rows, size_t cols, bool contiguous, Reduce reduce) {
+            const size_t size = rows * cols;
+            const size_t count = contiguous ? (size + SEGMENT_SIZE - 1) / SEGMENT_SIZE : rows;
+            const size_t grain = contiguous ? 1 : std::max<size_t>(1, SEGMENT_SIZE / std::max<size_t>(cols, 1));
+            std::vector<R> partials(count);
+            parallel::parallel_for(0, count, grain, [&](size_t begin, size_t end) {
+                for (size_t s = begin; s < end; s++) {
+                    partials[s] = contiguous ? reduce(0, s * SEGMENT_SIZE, std::min(SEGMENT_SIZE, size - s * SEGMENT_SIZE))
+                                             : reduce(s, 0, cols);
+                }
+            });
+            return partials;
+        }
+
+        /*
+         * The m by 1 matrix of `reduce(row, row_data, cols)` for every row (AXIS_1), in parallel for large matrices.
+         * */
+        template <class R, class Scalar, class Reduce>
+        BasicMatrix<R> reduce_rows(const BasicMatrix<Scalar>& matrix, Reduce reduce) {
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            BasicMatrix<R> res(rows, 1);
+            R* out = res.dataHolder();
+            const size_t grain = std::max<size_t>(1, parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(cols, 1));
+            parallel::parallel_for(0, rows, grain, [&](size_t begin, size_t end) {
+                for (size_t r = begin; r < end; r++) {
+                    out[r] = reduce(r, data + r * stride, cols);
+                }
+            });
+            return res;
+        }
+
+        /*
+         * Call `body(col_begin, col_end)` on blocks of columns of a matrix with `rows` rows (for AXIS_0),
+         * in parallel for large matrices.
+         * */
+        template <class Body>
+        void for_column_blocks(size_t rows, size_t cols, Body body) {
+            const size_t grain = std::max<size_t>(1, parallel::MIN_ELEMENTS_PER_TASK / std::max<size_t>(rows, 1));
+            parallel::parallel_for(0, cols, grain, body, 16);
+        }
+
+        /*
+         * The 1 by n matrix folding every column with Op; needs at least one row.
+         * */
+        template <class Op, class Scalar>
+        BasicMatrix<Scalar> fold_columns(const BasicMatrix<Scalar>& matrix) {
+            const size_t rows = matrix.rowCount();
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            BasicMatrix<Scalar> res(1, matrix.colCount());
+            Scalar* out = res.dataHolder();
+            for_column_blocks(rows, matrix.colCount(), [&](size_t begin, size_t end) {
+                kernels::fold_columns<Op>(rows, end - begin, data + begin, stride, out + begin);
+            });
+            return res;
+        }
+
+        void check_not_empty(size_t size) {
+            if (size == 0) {
+                throw IllegalArithmeticsException("The minimum and maximum of an empty matrix or axis are undefined.");
+            }
+        }
+
+        /*
+         * Index of the first extreme of the contiguous span x[0, n), n >= 1: the extreme is found with the SIMD kernels,
+         * then located with a linear search.
+         * */
+        template <class Op, class Scalar>
+        size_t arg_extreme(size_t n, const Scalar* x) {
+            const Scalar extreme = kernels::reduce<Op>(n, x, x[0]);
+            const size_t index = static_cast<size_t>(std::find(x, x + n, extreme) - x);
+            return index < n ? index : 0;
+        }
+
+        /*
+         * The first extreme of a non-empty matrix and its row-major flat index.
+         * */
+        template <class Op, class Scalar>
+        std::pair<Scalar, size_t> extreme(const BasicMatrix<Scalar>& matrix) {
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            check_not_empty(rows * cols);
+
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            std::vector<std::pair<Scalar, size_t>> partials = reduce_segments<std::pair<Scalar, size_t>>(
+                    rows, cols, is_contiguous(matrix), [&](size_t r, size_t c, size_t length) {
+                        const Scalar* x = data + r * stride + c;
+                        const size_t i = arg_extreme<Op>(length, x);
+                        return std::make_pair(x[i], r * cols + c + i);
+                    });
+            std::pair<Scalar, size_t> res = partials[0];
+            for (size_t s = 1; s < partials.size(); s++) {
+                if (Op::prefers(res.first, partials[s].first)) {
+                    res = partials[s];
+                }
+            }
+            return res;
+        }
+
+        template <class Op, class Scalar>
+        BasicMatrix<Scalar> extremes(const BasicMatrix<Scalar>& matrix, Axis axis) {
+            check_axis(axis);
+            if (axis == AXIS_1) {
+                check_not_empty(matrix.colCount());
+                return reduce_rows<Scalar>(matrix, [](size_t, const Scalar* x, size_t n) {
+                    return kernels::reduce<Op>(n, x, x[0]);
+                });
+            }
+            check_not_empty(matrix.rowCount());
+            return fold_columns<Op>(matrix);
+        }
+
+        template <class Op, class Scalar>
+        BasicMatrix<size_t> arg_extremes(const BasicMatrix<Scalar>& matrix, Axis axis) {
+            check_axis(axis);
+            if (axis == AXIS_1) {
+                check_not_empty(matrix.colCount());
+                return reduce_rows<size_t>(matrix, [](size_t, const Scalar* x, size_t n) {
+                    return arg_extreme<Op>(n, x);
+                });
+            }
+
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            check_not_empty(rows);
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            BasicMatrix<size_t> res(1, cols, 0);
+            size_t* out = res.dataHolder();
+            for_column_blocks(rows, cols, [&](size_t begin, size_t end) {
+                BasicAlignedBuffer<Scalar> best(end - begin, pool_resource());
+                std::copy(data + begin, data + end, best.data());
+                for (size_t r = 1; r < rows; r++) {
+                    const Scalar* x = data + r * stride + begin;
+                    for (size_t c = 0; c < end - begin; c++) {
+                        if (Op::prefers(best.data()[c], x[c])) {
+                            best.data()[c] = x[c];
+                            out[begin + c] = r;
+                        }
+                    }
+                }
+            });
+            return res;
+        }
+
+        /*
+         * The mean and variance of integer matrices are computed on a double copy.
+         * */
+        template <class Scalar>
+        Scalar mean(const BasicMatrix<Scalar>& matrix, std::false_type) {
+            return numpp::sum(matrix) / static_cast<Scalar>(matrix.rowCount() * matrix.colCount());
+        }
+
+        template <class Scalar>
+        double mean(const BasicMatrix<Scalar>& matrix, std::true_type) {
+            return numpp::mean(matrix.template astype<double>());
+        }
+
+        template <class Scalar>
+        BasicMatrix<Scalar> mean(const BasicMatrix<Scalar>& matrix, Axis axis, std::false_type) {
+            BasicMatrix<Scalar> res = numpp::sum(matrix, axis);
+            res /= static_cast<Scalar>(axis == AXIS_0 ? matrix.rowCount() : matrix.colCount());
+            return res;
+        }
+
+        template <class Scalar>
+        BasicMatrix<double> mean(const BasicMatrix<Scalar>& matrix, Axis axis, std::true_type) {
+            return numpp::mean(matrix.template astype<double>(), axis);
+        }
+
+        template <class Scalar>
+        typename Magnitude<Scalar>::type var(const BasicMatrix<Scalar>& matrix, size_t ddof, std::false_type) {
+            typedef typename Magnitude<Scalar>::type M;
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            const Scalar center = numpp::mean(matrix);
+            std::vector<M> partials = reduce_segments<M>(rows, cols, is_contiguous(matrix), [&](size_t r, size_t c, size_t length) {
+                return kernels::pairwise_squared_deviation(length, data + r * stride + c, center);
+            });
+            return kernels::pairwise_sum(partials.size(), partials.data()) / (static_cast<M>(rows * cols) - static_cast<M>(ddof));
+        }
+
+        template <class Scalar>
+        double var(const BasicMatrix<Scalar>& matrix, size_t ddof, std::true_type) {
+            return numpp::var(matrix.template astype<double>(), ddof);
+        }
+
+        template <class Scalar>
+        BasicMatrix<typename Magnitude<Scalar>::type> var(const BasicMatrix<Scalar>& matrix, Axis axis, size_t ddof,
+                                                          std::false_type) {
+            typedef typename Magnitude<Scalar>::type M;
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            const BasicMatrix<Scalar> centers = numpp::mean(matrix, axis);
+            const Scalar* center = centers.dataHolder();
+            BasicMatrix<M> res(0, 0);
+            if (axis == AXIS_1) {
+                res = reduce_rows<M>(matrix, [center](size_t r, const Scalar* x, size_t n) {
+                    return kernels::pairwise_squared_deviation(n, x, center[r]);
+                });
+            }
+            else {
+                res = BasicMatrix<M>(1, cols, M());
+                M* out = res.dataHolder();
+                for_column_blocks(rows, cols, [&](size_t begin, size_t end) {
+                    for (size_t r = 0; r < rows; r++) {
+                        const Scalar* x = data + r * stride;
+                        for (size_t c = begin; c < end; c++) {
+                            out[c] += kernels::squared_magnitude(x[c] - center[c]);
+                        }
+                    }
+                });
+            }
+            res /= static_cast<M>(axis == AXIS_0 ? rows : cols) - static_cast<M>(ddof);
+            return res;
+        }
+
+        template <class Scalar>
+        BasicMatrix<double> var(const BasicMatrix<Scalar>& matrix, Axis axis, size_t ddof, std::true_type) {
+            return numpp::var(matrix.template astype<double>(), axis, ddof);
+        }
+
+        template <class Scalar>
+        typename Magnitude<Scalar>::type norm(const BasicMatrix<Scalar>& matrix, NormOrder order, std::false_type) {
+            typedef typename Magnitude<Scalar>::type M;
+            const size_t rows = matrix.rowCount();
+            const size_t cols = matrix.colCount();
+            const size_t stride = matrix.stride();
+            const Scalar* data = matrix.dataHolder();
+            if (order == NORM_1) {
+                BasicMatrix<M> sums(1, cols, M());
+                M* out = sums.dataHolder();
+                for_column_blocks(rows, cols, [&](size_t begin, size_t end) {
+                    for (size_t r = 0; r < rows; r++) {
+                        const Scalar* x = data + r * stride;
+                        for (size_t c = begin; c < end; c++) {
+                            out[c] += std::abs(x[c]);
+                        }
+                    }
+                });
+                // Absolute sums are never negative, so zero can start the maximum.
+                return kernels::reduce<kernels::MaxOp>(cols, out, M());
+            }
+            if (order == NORM_INF) {
+                const BasicMatrix<M> sums = reduce_rows<M>(matrix, [](size_t, const Scalar* x, size_t n) {
+                    M res = M();
+                    for (size_t i = 0; i < n; i++) {
+                        res += std::abs(x[i]);
+                    }
+                    return res;
+                });
+                return kernels::reduce<kernels::MaxOp>(rows, sums.dataHolder(), M());
+            }
+            if (order != NORM_FRO) {
+                throw IllegalArithmeticsException("Norm order is one of NORM_FRO, NORM_1 and NORM_INF.");
+            }
+            std::vector<M> partials = reduce_segments<M>(rows, cols, is_contiguous(matrix), [&](size_t r, size_t c, size_t length) {
+                return kernels::pairwise_squared_deviation(length, data + r * stride + c, Scalar());
+            });
+            return std::sqrt(kernels::pairwise_sum(partials.size(), partials.data()));
+        }
+
+        template <class Scalar>
+        double norm(const BasicMatrix<Scalar>& matrix, NormOrder order, std::true_type) {
+            return numpp::norm(matrix.template astype<double>(), order);
+        }
+    }
+
+    template <class Scalar>
+    Scalar sum(const BasicMatrix<Scalar>& matrix) {
+        const size_t stride = matrix.stride();
+        const Scalar* data = matrix.dataHolder();
+        std::vector<Scalar> partials = reduction::reduce_segments<Scalar>(
+                matrix.rowCount(), matrix.colCount(), reduction::is_contiguous(matrix), [&](size_t r, size_t c, size_t length) {
+                    return kernels::pairwise_sum(length, data + r * stride + c);
+                });
+        return kernels::pairwise_sum(partials.size(), partials.data());
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> sum(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        reduction::check_axis(axis);
+        if (axis == AXIS_1) {
+            return reduction::reduce_rows<Scalar>(matrix, [](size_t, const Scalar* x, size_t n) {
+                return kernels::pairwise_sum(n, x);
+            });
+        }
+        if (matrix.rowCount() == 0) {
+            return BasicMatrix<Scalar>(1, matrix.colCount(), Scalar());
+        }
+        return reduction::fold_columns<kernels::AddOp>(matrix);
+    }
+
+    template <class Scalar>
+    typename Promoted<Scalar>::type mean(const BasicMatrix<Scalar>& matrix) {
+        return reduction::mean(matrix, std::is_integral<Scalar>());
+    }
+
+    template <class Scalar>
+    BasicMatrix<typename Promoted<Scalar>::type> mean(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        return reduction::mean(matrix, axis, std::is_integral<Scalar>());
+    }
+
+    template <class Scalar>
+    typename Magnitude<Scalar>::type var(const BasicMatrix<Scalar>& matrix, size_t ddof) {
+        return reduction::var(matrix, ddof, std::is_integral<Scalar>());
+    }
+
+    template <class Scalar>
+    BasicMatrix<typename Magnitude<Scalar>::type> var(const BasicMatrix<Scalar>& matrix, Axis axis, size_t ddof) {
+        reduction::check_axis(axis);
+        return reduction::var(matrix, axis, ddof, std::is_integral<Scalar>());
+    }
+
+    template <class Scalar>
+    Scalar min(const BasicMatrix<Scalar>& matrix) {
+        return reduction::extreme<kernels::MinOp>(matrix).first;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> min(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        return reduction::extremes<kernels::MinOp>(matrix, axis);
+    }
+
+    template <class Scalar>
+    Scalar max(const BasicMatrix<Scalar>& matrix) {
+        return reduction::extreme<kernels::MaxOp>(matrix).first;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> max(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        return reduction::extremes<kernels::MaxOp>(matrix, axis);
+    }
+
+    template <class Scalar>
+    size_t argmin(const BasicMatrix<Scalar>& matrix) {
+        return reduction::extreme<kernels::MinOp>(matrix).second;
+    }
+
+    template <class Scalar>
+    BasicMatrix<size_t> argmin(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        return reduction::arg_extremes<kernels::MinOp>(matrix, axis);
+    }
+
+    template <class Scalar>
+    size_t argmax(const BasicMatrix<Scalar>& matrix) {
+        return reduction::extreme<kernels::MaxOp>(matrix).second;
+    }
+
+    template <class Scalar>
+    BasicMatrix<size_t> argmax(const BasicMatrix<Scalar>& matrix, Axis axis) {
+        return reduction::arg_extremes<kernels::MaxOp>(matrix, axis);
+    }
+
+    template <class Scalar>
+    typename Magnitude<Scalar>::type norm(const BasicMatrix<Scalar>& matrix, NormOrder order) {
+        return reduction::norm(matrix, order, std::is_integral<Scalar>());
+    }
+
+    template <class Scalar>
+    Scalar dot(const BasicMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2) {
+        const size_t rows = matrix1.rowCount();
+        const size_t cols = matrix1.colCount();
+        const size_t stride1 = matrix1.stride();
+        const size_t stride2 = matrix2.stride();
+        const Scalar* data1 = matrix1.dataHolder();
+        const Scalar* data2 = matrix2.dataHolder();
+        if (rows == matrix2.rowCount() && cols == matrix2.colCount()) {
+            const bool contiguous = reduction::is_contiguous(matrix1) && reduction::is_contiguous(matrix2);
+            std::vector<Scalar> partials = reduction::reduce_segments<Scalar>(rows, cols, contiguous, [&](size_t r, size_t c, size_t length) {
+                return kernels::pairwise_inner_product(length, data1 + r * stride1 + c, data2 + r * stride2 + c);
+            });
+            return kernels::pairwise_sum(partials.size(), partials.data());
+        }
+
+        const size_t length = rows * cols;
+        const bool vectors = (rows == 1 || cols == 1) && (matrix2.rowCount() == 1 || matrix2.colCount() == 1);
+        if (!vectors || length != matrix2.rowCount() * matrix2.colCount()) {
+            throw IllegalArithmeticsException{"To take the dot product of two matrices, their shapes must be the same, "
+                                              "or they must be vectors of the same length."};
+        }
+        // A row and a column vector: a column is read with the row stride of its matrix.
+        const size_t inc1 = rows == 1 ? 1 : stride1;
+        const size_t inc2 = matrix2.rowCount() == 1 ? 1 : stride2;
+        if (inc1 == 1 && inc2 == 1) {
+            return kernels::pairwise_inner_product(length, data1, data2);
+        }
+        return kernels::dot(length, data1, inc1, data2, inc2);
+    }
+}
+
+#endif //NUMPP_REDUCTION_H
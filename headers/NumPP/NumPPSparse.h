@@ -0,0 +1,820 @@
+#ifndef NUMPP_SPARSE_H
+#define NUMPP_SPARSE_H
+
+#include "NumPPDeclaration.h"
+#include "NumPPKernels.h"
+#include "NumPPParallel.h"
+#include <algorithm>
+#include <utility>
+
+namespace numpp {
+    /*
+     * One entry (row, col, value) of a sparse matrix, as passed to the triplet constructor.
+     * */
+    template <class Scalar>
+    struct BasicTriplet {
+        size_t row;
+        size_t col;
+        Scalar value;
+    };
+
+    typedef BasicTriplet<double> Triplet;
+
+    template <class Scalar>
+    class BasicSparseSection;
+
+    /*
+     * A matrix stored in compressed sparse row (CSR) form: for every row, the column indexes and values
+     * of its non-zero entries, sorted by column. Memory and the cost of every operation scale with
+     * the number of non-zeros instead of rows * cols, so a 100000 by 100000 matrix with a few non-zeros
+     * per row is cheap. Zeros are never stored: entries that become zero are dropped.
+     *
+     * The CSC form of a matrix is the CSR form of its transpose: `T()` converts between the two in O(nnz),
+     * and `fromCSC` builds a matrix from CSC arrays.
+     *
+     * Only operations that keep zeros zero stay sparse (`+`, `-` and element-wise `*` with another sparse matrix,
+     * `*` and `/` by a scalar, products). Combining a sparse matrix with a dense one in `+` or `-`,
+     * or multiplying sparse by dense, gives a dense Matrix.
+     * */
+    template <class Scalar>
+    class BasicSparseMatrix {
+    private:
+        friend class BasicSparseSection<Scalar>;
+
+        size_t _rows;
+        size_t _cols;
+
+        /*
+         * The entries of row i are [_row_pointers[i], _row_pointers[i + 1]) in `_col_indexes` and `_values`.
+         * */
+        std::vector<size_t> _row_pointers;
+        std::vector<size_t> _col_indexes;
+        std::vector<Scalar> _values;
+
+        /*
+         * Copy of the rows and columns in the given (already resolved) slices.
+         * */
+        BasicSparseMatrix extract(Slice row_slice, Slice col_slice) const;
+
+        /*
+         * Drop stored zeros, keeping the order of the remaining entries.
+         * */
+        void prune();
+
+    public:
+        typedef Scalar value_type;
+
+        BasicSparseMatrix();
+
+        /*
+         * An m by n zero matrix; it stores nothing but m + 1 row pointers.
+         * */
+        BasicSparseMatrix(size_t m, size_t n);
+
+        /*
+         * An m by n matrix with the given entries in any order. Entries at the same position are summed.
+         * Indexes outside the shape throw IllegalArithmeticsException.
+         * */
+        BasicSparseMatrix(size_t m, size_t n, const std::vector<BasicTriplet<Scalar>>& triplets);
+
+        /*
+         * The non-zero entries of a dense matrix (or a section).
+         * */
+        explicit BasicSparseMatrix(const BasicMatrix<Scalar>& matrix);
+
+        /*
+         * Take over CSR or CSC arrays: m + 1 (n + 1 for CSC) pointers starting at 0,
+         * and strictly increasing column (row) indexes within every row (column).
+         * Malformed arrays throw IllegalArithmeticsException.
+         * */
+        static BasicSparseMatrix fromCSR(size_t m, size_t n, std::vector<size_t> row_pointers,
+                                         std::vector<size_t> col_indexes, std::vector<Scalar> values);
+        static BasicSparseMatrix fromCSC(size_t m, size_t n, std::vector<size_t> col_pointers,
+                                         std::vector<size_t> row_indexes, std::vector<Scalar> values);
+
+        static BasicSparseMatrix identity(size_t n);
+
+        std::vector<size_t> shape() const;
+
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        /*
+         * Number of stored (non-zero) entries.
+         * */
+        size_t nonZeros() const;
+
+        /*
+         * The entry at row x and column y, found by binary search within row x.
+         * */
+        Scalar at(size_t x, size_t y) const;
+
+        const std::vector<size_t>& rowPointers() const;
+        const std::vector<size_t>& colIndexes() const;
+        const std::vector<Scalar>& values() const;
+
+        /*
+         * Row and column selection with the same indexes as Matrix (negative indexes, `ED`, `{start, end}`):
+         * `sp[{0, 10}][{5, ED}]`. Sections of a sparse matrix are read-only;
+         * they convert to a SparseMatrix (copying only the selected non-zeros) or to a dense Matrix with toMatrix().
+         * */
+        BasicSparseSection<Scalar> operator[](SignedSlice slice_numpp) const;
+        BasicSparseSection<Scalar> operator[](int index_numpp) const;
+
+        BasicSparseMatrix& operator*=(Scalar other);
+        BasicSparseMatrix& operator/=(Scalar other);
+        BasicSparseMatrix& operator+=(const BasicSparseMatrix& other);
+        BasicSparseMatrix& operator-=(const BasicSparseMatrix& other);
+
+        /*
+         * Transpose form of this matrix
+         * */
+        BasicSparseMatrix T() const;
+
+        /*
+         * Copy into a dense matrix of the same shape.
+         * */
+        BasicMatrix<Scalar> toMatrix() const;
+    };
+
+    typedef BasicSparseMatrix<double> SparseMatrix;
+
+    /*
+     * The result of `operator[]` on a sparse matrix: a parent matrix and the selected rows and columns.
+     * Like a Matrix section, it is only valid while the parent is alive and can be sliced two times at most.
+     * */
+    template <class Scalar>
+    class BasicSparseSection {
+    private:
+        const BasicSparseMatrix<Scalar>* _parentMatrix;
+        Section _indexesOfParentMatrix;
+
+    public:
+        BasicSparseSection(const BasicSparseMatrix<Scalar>* parentMatrix, Section indexesOfParentMatrix);
+
+        /*
+         * Select columns within the selected rows.
+         * */
+        BasicSparseSection operator[](SignedSlice slice_numpp) const;
+        BasicSparseSection operator[](int index_numpp) const;
+
+        size_t rowCount() const;
+
+        size_t colCount() const;
+
+        /*
+         * The only element of a 1 by 1 section.
+         * */
+        Scalar num() const;
+
+        BasicSparseMatrix<Scalar> eval() const;
+
+        operator BasicSparseMatrix<Scalar>() const;
+
+        BasicMatrix<Scalar> toMatrix() const;
+    };
+
+    /*
+     * Resolve negative indexes and `ED` of a slice over `extent` rows (or columns).
+     * */
+    Slice resolve_slice(SignedSlice slice_numpp, size_t extent) {
+        Slice slice {
+            static_cast<size_t>(std::abs(slice_numpp.start_idx)),
+            static_cast<size_t>(std::abs(slice_numpp.end_idx))
+        };
+        if (slice_numpp.start_idx < 0) {
+            slice.start_idx = extent + slice_numpp.start_idx;
+        }
+        if (slice_numpp.end_idx == ED) {
+            slice.end_idx = extent;
+        }
+        else if (slice_numpp.end_idx < 0) {
+            slice.end_idx = extent + slice_numpp.end_idx;
+        }
+
+        if (slice.start_idx > slice.end_idx || slice.end_idx > extent) {
+            throw IllegalArithmeticsException{"The slice is out of the range of the matrix."};
+        }
+        return slice;
+    }
+
+    /*
+     * A single index (or `ED` for everything) as a slice, as Matrix::operator[](int) selects it.
+     * */
+    SignedSlice index_slice(int index_numpp, size_t extent) {
+        if (index_numpp == ED) {
+            return SignedSlice{0, static_cast<int>(extent)};
+        }
+        if (index_numpp >= 0) {
+            return SignedSlice{index_numpp, index_numpp + 1};
+        }
+        return SignedSlice{index_numpp, static_cast<int>(extent + index_numpp + 1)};
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>::BasicSparseMatrix() : BasicSparseMatrix<Scalar>(0, 0) {}
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>::BasicSparseMatrix(size_t m, size_t n) : _rows(m), _cols(n), _row_pointers(m + 1, 0) {}
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>::BasicSparseMatrix(size_t m, size_t n, const std::vector<BasicTriplet<Scalar>>& triplets) :
+            BasicSparseMatrix<Scalar>(m, n) {
+        // Bucket the entries by row (a counting sort), then sort and merge every row on its own.
+        for (const BasicTriplet<Scalar>& triplet : triplets) {
+            if (triplet.row >= m || triplet.col >= n) {
+                throw IllegalArithmeticsException{"The index of an entry is out of the shape of the sparse matrix."};
+            }
+            _row_pointers[triplet.row + 1]++;
+        }
+        for (size_t r = 0; r < m; r++) {
+            _row_pointers[r + 1] += _row_pointers[r];
+        }
+
+        std::vector<std::pair<size_t, Scalar>> entries(triplets.size());
+        std::vector<size_t> next(_row_pointers.begin(), _row_pointers.end() - 1);
+        for (const BasicTriplet<Scalar>& triplet : triplets) {
+            entries[next[triplet.row]++] = std::make_pair(triplet.col, triplet.value);
+        }
+
+        _col_indexes.reserve(entries.size());
+        _values.reserve(entries.size());
+        size_t begin = 0;
+        for (size_t r = 0; r < m; r++) {
+            const size_t end = _row_pointers[r + 1];
+            std::sort(entries.begin() + begin, entries.begin() + end,
+                      [](const std::pair<size_t, Scalar>& x, const std::pair<size_t, Scalar>& y) { return x.first < y.first; });
+            for (size_t i = begin; i < end;) {
+                const size_t col = entries[i].first;
+                Scalar value = entries[i++].second;
+                while (i < end && entries[i].first == col) {
+                    value += entries[i++].second;
+                }
+                if (value != Scalar()) {
+                    _col_indexes.push_back(col);
+                    _values.push_back(value);
+                }
+            }
+            _row_pointers[r + 1] = _values.size();
+            begin = end;
+        }
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>::BasicSparseMatrix(const BasicMatrix<Scalar>& matrix) :
+            BasicSparseMatrix<Scalar>(matrix.rowCount(), matrix.colCount()) {
+        for (size_t r = 0; r < _rows; r++) {
+            const Scalar* row = matrix.dataHolder() + r * matrix.stride();
+            for (size_t c = 0; c < _cols; c++) {
+                if (row[c] != Scalar()) {
+                    _col_indexes.push_back(c);
+                    _values.push_back(row[c]);
+                }
+            }
+            _row_pointers[r + 1] = _values.size();
+        }
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseMatrix<Scalar>::fromCSR(size_t m, size_t n, std::vector<size_t> row_pointers,
+                                                                 std::vector<size_t> col_indexes, std::vector<Scalar> values) {
+        if (row_pointers.size() != m + 1 || row_pointers[0] != 0 || row_pointers[m] != col_indexes.size()
+                || col_indexes.size() != values.size()) {
+            throw IllegalArithmeticsException{"The sizes of the CSR arrays do not match the shape of the sparse matrix."};
+        }
+        for (size_t r = 0; r < m; r++) {
+            if (row_pointers[r] > row_pointers[r + 1]) {
+                throw IllegalArithmeticsException{"The row pointers of a CSR matrix must not decrease."};
+            }
+            for (size_t i = row_pointers[r]; i < row_pointers[r + 1]; i++) {
+                if (col_indexes[i] >= n || (i > row_pointers[r] && col_indexes[i] <= col_indexes[i - 1])) {
+                    throw IllegalArithmeticsException{"The column indexes of every row must be increasing and within the shape."};
+                }
+            }
+        }
+
+        BasicSparseMatrix<Scalar> res(m, n);
+        res._row_pointers = std::move(row_pointers);
+        res._col_indexes = std::move(col_indexes);
+        res._values = std::move(values);
+        res.prune();
+        return res;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseMatrix<Scalar>::fromCSC(size_t m, size_t n, std::vector<size_t> col_pointers,
+                                                                 std::vector<size_t> row_indexes, std::vector<Scalar> values) {
+        // CSC arrays of A are the CSR arrays of A^T.
+        return fromCSR(n, m, std::move(col_pointers), std::move(row_indexes), std::move(values)).T();
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseMatrix<Scalar>::identity(size_t n) {
+        BasicSparseMatrix<Scalar> res(n, n);
+        res._col_indexes.resize(n);
+        res._values.assign(n, Scalar(1));
+        for (size_t i = 0; i < n; i++) {
+            res._col_indexes[i] = i;
+            res._row_pointers[i + 1] = i + 1;
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    void BasicSparseMatrix<Scalar>::prune() {
+        size_t kept = 0;
+        size_t begin = 0;
+        for (size_t r = 0; r < _rows; r++) {
+            const size_t end = _row_pointers[r + 1];
+            for (size_t i = begin; i < end; i++) {
+                if (_values[i] != Scalar()) {
+                    _col_indexes[kept] = _col_indexes[i];
+                    _values[kept++] = _values[i];
+                }
+            }
+            _row_pointers[r + 1] = kept;
+            begin = end;
+        }
+        _col_indexes.resize(kept);
+        _values.resize(kept);
+    }
+
+    template <class Scalar>
+    std::vector<size_t> BasicSparseMatrix<Scalar>::shape() const {
+        return std::vector<size_t>{_rows, _cols};
+    }
+
+    template <class Scalar>
+    size_t BasicSparseMatrix<Scalar>::rowCount() const {
+        return _rows;
+    }
+
+    template <class Scalar>
+    size_t BasicSparseMatrix<Scalar>::colCount() const {
+        return _cols;
+    }
+
+    template <class Scalar>
+    size_t BasicSparseMatrix<Scalar>::nonZeros() const {
+        return _values.size();
+    }
+
+    template <class Scalar>
+    Scalar BasicSparseMatrix<Scalar>::at(size_t x, size_t y) const {
+        const size_t* begin = _col_indexes.data() + _row_pointers[x];
+        const size_t* end = _col_indexes.data() + _row_pointers[x + 1];
+        const size_t* found = std::lower_bound(begin, end, y);
+        return found != end && *found == y ? _values[found - _col_indexes.data()] : Scalar();
+    }
+
+    template <class Scalar>
+    const std::vector<size_t>& BasicSparseMatrix<Scalar>::rowPointers() const {
+        return _row_pointers;
+    }
+
+    template <class Scalar>
+    const std::vector<size_t>& BasicSparseMatrix<Scalar>::colIndexes() const {
+        return _col_indexes;
+    }
+
+    template <class Scalar>
+    const std::vector<Scalar>& BasicSparseMatrix<Scalar>::values() const {
+        return _values;
+    }
+
+    template <class Scalar>
+    BasicSparseSection<Scalar> BasicSparseMatrix<Scalar>::operator[](SignedSlice slice_numpp) const {
+        Section section;
+        section.state = 1;
+        section.row_slice = resolve_slice(slice_numpp, _rows);
+        section.col_slice = {0, _cols};
+        return BasicSparseSection<Scalar>{this, section};
+    }
+
+    template <class Scalar>
+    BasicSparseSection<Scalar> BasicSparseMatrix<Scalar>::operator[](int index_numpp) const {
+        return (*this)[index_slice(index_numpp, _rows)];
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseMatrix<Scalar>::extract(Slice row_slice, Slice col_slice) const {
+        BasicSparseMatrix<Scalar> res(row_slice.end_idx - row_slice.start_idx, col_slice.end_idx - col_slice.start_idx);
+        for (size_t r = row_slice.start_idx; r < row_slice.end_idx; r++) {
+            const size_t* end = _col_indexes.data() + _row_pointers[r + 1];
+            const size_t* col = std::lower_bound(_col_indexes.data() + _row_pointers[r], end, col_slice.start_idx);
+            for (; col != end && *col < col_slice.end_idx; col++) {
+                res._col_indexes.push_back(*col - col_slice.start_idx);
+                res._values.push_back(_values[col - _col_indexes.data()]);
+            }
+            res._row_pointers[r - row_slice.start_idx + 1] = res._values.size();
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>& BasicSparseMatrix<Scalar>::operator*=(Scalar other) {
+        for (Scalar& value : _values) {
+            value *= other;
+        }
+        if (other == Scalar()) {
+            prune();
+        }
+        return *this;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>& BasicSparseMatrix<Scalar>::operator/=(Scalar other) {
+        for (Scalar& value : _values) {
+            value /= other;
+        }
+        return *this;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>& BasicSparseMatrix<Scalar>::operator+=(const BasicSparseMatrix<Scalar>& other) {
+        return *this = *this + other;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar>& BasicSparseMatrix<Scalar>::operator-=(const BasicSparseMatrix<Scalar>& other) {
+        return *this = *this - other;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseMatrix<Scalar>::T() const {
+        // Counting sort by column: rows are visited in order, so every column of the result comes out sorted.
+        BasicSparseMatrix<Scalar> res(_cols, _rows);
+        for (size_t col : _col_indexes) {
+            res._row_pointers[col + 1]++;
+        }
+        for (size_t c = 0; c < _cols; c++) {
+            res._row_pointers[c + 1] += res._row_pointers[c];
+        }
+
+        res._col_indexes.resize(_values.size());
+        res._values.resize(_values.size());
+        std::vector<size_t> next(res._row_pointers.begin(), res._row_pointers.end() - 1);
+        for (size_t r = 0; r < _rows; r++) {
+            for (size_t i = _row_pointers[r]; i < _row_pointers[r + 1]; i++) {
+                const size_t dst = next[_col_indexes[i]]++;
+                res._col_indexes[dst] = r;
+                res._values[dst] = _values[i];
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicSparseMatrix<Scalar>::toMatrix() const {
+        BasicMatrix<Scalar> res{_rows, _cols};
+        for (size_t r = 0; r < _rows; r++) {
+            Scalar* row = res.dataHolder() + r * res.stride();
+            for (size_t i = _row_pointers[r]; i < _row_pointers[r + 1]; i++) {
+                row[_col_indexes[i]] = _values[i];
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicSparseSection<Scalar>::BasicSparseSection(const BasicSparseMatrix<Scalar>* parentMatrix, Section indexesOfParentMatrix) :
+            _parentMatrix(parentMatrix), _indexesOfParentMatrix(indexesOfParentMatrix) {}
+
+    template <class Scalar>
+    BasicSparseSection<Scalar> BasicSparseSection<Scalar>::operator[](SignedSlice slice_numpp) const {
+        if (_indexesOfParentMatrix.state == 2) {
+            throw IllegalArithmeticsException{"Cannot slice a matrix too many times, two times at most."};
+        }
+
+        const Slice slice = resolve_slice(slice_numpp, colCount());
+        Section section = _indexesOfParentMatrix;
+        section.state = 2;
+        section.col_slice = {_indexesOfParentMatrix.col_slice.start_idx + slice.start_idx,
+                             _indexesOfParentMatrix.col_slice.start_idx + slice.end_idx};
+        return BasicSparseSection<Scalar>{_parentMatrix, section};
+    }
+
+    template <class Scalar>
+    BasicSparseSection<Scalar> BasicSparseSection<Scalar>::operator[](int index_numpp) const {
+        return (*this)[index_slice(index_numpp, colCount())];
+    }
+
+    template <class Scalar>
+    size_t BasicSparseSection<Scalar>::rowCount() const {
+        return _indexesOfParentMatrix.row_slice.end_idx - _indexesOfParentMatrix.row_slice.start_idx;
+    }
+
+    template <class Scalar>
+    size_t BasicSparseSection<Scalar>::colCount() const {
+        return _indexesOfParentMatrix.col_slice.end_idx - _indexesOfParentMatrix.col_slice.start_idx;
+    }
+
+    template <class Scalar>
+    Scalar BasicSparseSection<Scalar>::num() const {
+        if (rowCount() != 1 || colCount() != 1) {
+            throw IllegalArithmeticsException{"Only 1 by 1 matrices can call num() method."};
+        }
+        return _parentMatrix->at(_indexesOfParentMatrix.row_slice.start_idx, _indexesOfParentMatrix.col_slice.start_idx);
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> BasicSparseSection<Scalar>::eval() const {
+        return _parentMatrix->extract(_indexesOfParentMatrix.row_slice, _indexesOfParentMatrix.col_slice);
+    }
+
+    template <class Scalar>
+    BasicSparseSection<Scalar>::operator BasicSparseMatrix<Scalar>() const {
+        return eval();
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> BasicSparseSection<Scalar>::toMatrix() const {
+        return eval().toMatrix();
+    }
+
+    /*
+     * Element-wise `x op y` of two sparse matrices of the same shape, merging the sorted rows.
+     * With `intersect`, only positions stored in both are visited (enough for products);
+     * otherwise a position missing on one side reads as zero there.
+     * */
+    template <class Op, class Scalar>
+    BasicSparseMatrix<Scalar> sparse_elementwise(const BasicSparseMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y, bool intersect) {
+        if (x.rowCount() != y.rowCount() || x.colCount() != y.colCount()) {
+            throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same."};
+        }
+
+        std::vector<size_t> row_pointers(x.rowCount() + 1, 0);
+        std::vector<size_t> col_indexes;
+        std::vector<Scalar> values;
+        const std::vector<size_t>& x_cols = x.colIndexes();
+        const std::vector<size_t>& y_cols = y.colIndexes();
+        const std::vector<Scalar>& x_values = x.values();
+        const std::vector<Scalar>& y_values = y.values();
+
+        for (size_t r = 0; r < x.rowCount(); r++) {
+            size_t i = x.rowPointers()[r], i_end = x.rowPointers()[r + 1];
+            size_t j = y.rowPointers()[r], j_end = y.rowPointers()[r + 1];
+            while (i < i_end || j < j_end) {
+                size_t col;
+                Scalar value;
+                if (j == j_end || (i < i_end && x_cols[i] < y_cols[j])) {
+                    col = x_cols[i];
+                    value = Op::scalar(x_values[i++], Scalar());
+                    if (intersect) {
+                        continue;
+                    }
+                }
+                else if (i == i_end || y_cols[j] < x_cols[i]) {
+                    col = y_cols[j];
+                    value = Op::scalar(Scalar(), y_values[j++]);
+                    if (intersect) {
+                        continue;
+                    }
+                }
+                else {
+                    col = x_cols[i];
+                    value = Op::scalar(x_values[i++], y_values[j++]);
+                }
+
+                if (value != Scalar()) {
+                    col_indexes.push_back(col);
+                    values.push_back(value);
+                }
+            }
+            row_pointers[r + 1] = values.size();
+        }
+        return BasicSparseMatrix<Scalar>::fromCSR(x.rowCount(), x.colCount(), std::move(row_pointers),
+                                                  std::move(col_indexes), std::move(values));
+    }
+
+    /*
+     * Element-wise `x op y` of a sparse and a dense matrix of the same shape as a dense matrix.
+     * */
+    template <class Op, class Scalar>
+    BasicMatrix<Scalar> sparse_dense_elementwise(const BasicSparseMatrix<Scalar>& x, const BasicMatrix<Scalar>& y, bool sparse_first) {
+        if (x.rowCount() != y.rowCount() || x.colCount() != y.colCount()) {
+            throw IllegalArithmeticsException{"To apply element-wise operation between two matrices, their shapes must be the same."};
+        }
+
+        BasicMatrix<Scalar> res{y};
+        for (size_t r = 0; r < res.rowCount(); r++) {
+            Scalar* row = res.dataHolder() + r * res.stride();
+            if (!sparse_first) {
+                for (size_t i = x.rowPointers()[r]; i < x.rowPointers()[r + 1]; i++) {
+                    row[x.colIndexes()[i]] = Op::scalar(row[x.colIndexes()[i]], x.values()[i]);
+                }
+                continue;
+            }
+
+            // x op y with x zero outside its non-zeros.
+            size_t i = x.rowPointers()[r];
+            for (size_t c = 0; c < res.colCount(); c++) {
+                Scalar x_value = Scalar();
+                if (i < x.rowPointers()[r + 1] && x.colIndexes()[i] == c) {
+                    x_value = x.values()[i++];
+                }
+                row[c] = Op::scalar(x_value, row[c]);
+            }
+        }
+        return res;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator+(const BasicSparseMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return sparse_elementwise<kernels::AddOp>(x, y, false);
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator-(const BasicSparseMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return sparse_elementwise<kernels::SubOp>(x, y, false);
+    }
+
+    /*
+     * Element-wise product; the matrix product is `multiply`.
+     * */
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator*(const BasicSparseMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return sparse_elementwise<kernels::MulOp>(x, y, true);
+    }
+
+    /*
+     * Element-wise product with a dense matrix; zeros of `x` stay zero, so the result is sparse.
+     * */
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator*(const BasicSparseMatrix<Scalar>& x, const BasicMatrix<Scalar>& y) {
+        return sparse_elementwise<kernels::MulOp>(x, BasicSparseMatrix<Scalar>{y}, true);
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator*(const BasicMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return y * x;
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> operator+(const BasicSparseMatrix<Scalar>& x, const BasicMatrix<Scalar>& y) {
+        return sparse_dense_elementwise<kernels::AddOp>(x, y, true);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> operator+(const BasicMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return sparse_dense_elementwise<kernels::AddOp>(y, x, false);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> operator-(const BasicSparseMatrix<Scalar>& x, const BasicMatrix<Scalar>& y) {
+        return sparse_dense_elementwise<kernels::SubOp>(x, y, true);
+    }
+
+    template <class Scalar>
+    BasicMatrix<Scalar> operator-(const BasicMatrix<Scalar>& x, const BasicSparseMatrix<Scalar>& y) {
+        return sparse_dense_elementwise<kernels::SubOp>(y, x, false);
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator*(const BasicSparseMatrix<Scalar>& x, typename NonDeduced<Scalar>::type y) {
+        BasicSparseMatrix<Scalar> res{x};
+        return res *= y;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator*(typename NonDeduced<Scalar>::type x, const BasicSparseMatrix<Scalar>& y) {
+        return y * x;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator/(const BasicSparseMatrix<Scalar>& x, typename NonDeduced<Scalar>::type y) {
+        BasicSparseMatrix<Scalar> res{x};
+        return res /= y;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> operator-(const BasicSparseMatrix<Scalar>& x) {
+        return x * Scalar(-1);
+    }
+
+    /*
+     * Sparse times dense (SpMM, or SpMV when `matrix2` is a column vector) as a dense matrix.
+     * Rows are split across the thread pool by their share of the non-zeros.
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicSparseMatrix<Scalar>& matrix1, const BasicMatrix<Scalar>& matrix2) {
+        if (matrix1.colCount() != matrix2.rowCount()) {
+            throw IllegalArithmeticsException{
+                    "The column size of the first matrix must be the same as the row size of the second matrix on "
+                    "the matrix multiplication operation."
+            };
+        }
+
+        const size_t m = matrix1.rowCount();
+        const size_t n = matrix2.colCount();
+        BasicMatrix<Scalar> product{m, n};
+        const size_t work_per_row = matrix1.nonZeros() * n / std::max<size_t>(m, 1) + n;
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / work_per_row + 1;
+        parallel::parallel_for(0, m, grain, [&](size_t r_begin, size_t r_end) {
+            kernels::csr_dense_multiply(r_begin, r_end, n, matrix1.rowPointers().data(), matrix1.colIndexes().data(),
+                                        matrix1.values().data(), matrix2.dataHolder(), matrix2.stride(),
+                                        product.dataHolder(), product.stride());
+        });
+        return product;
+    }
+
+    /*
+     * Dense times sparse as a dense matrix.
+     * */
+    template <class Scalar>
+    BasicMatrix<Scalar> multiply(const BasicMatrix<Scalar>& matrix1, const BasicSparseMatrix<Scalar>& matrix2) {
+        if (matrix1.colCount() != matrix2.rowCount()) {
+            throw IllegalArithmeticsException{
+                    "The column size of the first matrix must be the same as the row size of the second matrix on "
+                    "the matrix multiplication operation."
+            };
+        }
+
+        const size_t m = matrix1.rowCount();
+        const size_t k = matrix1.colCount();
+        const size_t n = matrix2.colCount();
+        BasicMatrix<Scalar> product{m, n};
+        const size_t work_per_row = k + matrix2.nonZeros() + n;
+        const size_t grain = parallel::MIN_ELEMENTS_PER_TASK / work_per_row + 1;
+        parallel::parallel_for(0, m, grain, [&](size_t r_begin, size_t r_end) {
+            kernels::dense_csr_multiply(r_begin, r_end, k, n, matrix1.dataHolder(), matrix1.stride(),
+                                        matrix2.rowPointers().data(), matrix2.colIndexes().data(), matrix2.values().data(),
+                                        product.dataHolder(), product.stride());
+        });
+        return product;
+    }
+
+    /*
+     * Sparse times sparse as a sparse matrix (Gustavson's row-by-row algorithm):
+     * every row of the product accumulates scaled rows of `matrix2` in a dense row of flags and sums,
+     * so the work is proportional to the number of multiply-adds, never to rows * cols.
+     * */
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> multiply(const BasicSparseMatrix<Scalar>& matrix1, const BasicSparseMatrix<Scalar>& matrix2) {
+        if (matrix1.colCount() != matrix2.rowCount()) {
+            throw IllegalArithmeticsException{
+                    "The column size of the first matrix must be the same as the row size of the second matrix on "
+                    "the matrix multiplication operation."
+            };
+        }
+
+        const size_t m = matrix1.rowCount();
+        const size_t n = matrix2.colCount();
+        const std::vector<size_t>& a_rows = matrix1.rowPointers();
+        const std::vector<size_t>& a_cols = matrix1.colIndexes();
+        const std::vector<Scalar>& a_values = matrix1.values();
+        const std::vector<size_t>& b_rows = matrix2.rowPointers();
+        const std::vector<size_t>& b_cols = matrix2.colIndexes();
+        const std::vector<Scalar>& b_values = matrix2.values();
+
+        std::vector<size_t> row_pointers(m + 1, 0);
+        std::vector<size_t> col_indexes;
+        std::vector<Scalar> values;
+
+        // `marker[j] == i + 1` once column j of row i has been touched; `row_cols` lists those columns.
+        std::vector<size_t> marker(n, 0);
+        std::vector<Scalar> accumulator(n);
+        std::vector<size_t> row_cols;
+        for (size_t i = 0; i < m; i++) {
+            row_cols.clear();
+            for (size_t p = a_rows[i]; p < a_rows[i + 1]; p++) {
+                const size_t k = a_cols[p];
+                const Scalar a_ik = a_values[p];
+                for (size_t q = b_rows[k]; q < b_rows[k + 1]; q++) {
+                    const size_t j = b_cols[q];
+                    if (marker[j] != i + 1) {
+                        marker[j] = i + 1;
+                        accumulator[j] = a_ik * b_values[q];
+                        row_cols.push_back(j);
+                    }
+                    else {
+                        accumulator[j] += a_ik * b_values[q];
+                    }
+                }
+            }
+
+            std::sort(row_cols.begin(), row_cols.end());
+            for (size_t j : row_cols) {
+                if (accumulator[j] != Scalar()) {
+                    col_indexes.push_back(j);
+                    values.push_back(accumulator[j]);
+                }
+            }
+            row_pointers[i + 1] = values.size();
+        }
+        return BasicSparseMatrix<Scalar>::fromCSR(m, n, std::move(row_pointers), std::move(col_indexes), std::move(values));
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> multiply(const BasicSparseMatrix<Scalar>& matrix, typename NonDeduced<Scalar>::type c) {
+        return matrix * c;
+    }
+
+    template <class Scalar>
+    BasicSparseMatrix<Scalar> transpose(const BasicSparseMatrix<Scalar>& matrix) {
+        return matrix.T();
+    }
+}
+
+#endif //NUMPP_SPARSE_H
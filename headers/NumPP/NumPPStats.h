@@ -0,0 +1,139 @@
+#ifndef NUMPP_STATS_H
+#define NUMPP_STATS_H
+
+#include "NumPPDeclaration.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/*
+ * Opt-in instrumentation. Define NUMPP_ENABLE_STATS before including NumPP to count matrix constructions,
+ * copies, moves and allocations, and the calls and time spent in the main operations; see numpp::stats().
+ * Without it the hooks below expand to nothing and stats() always reports zeros.
+ * */
+#ifdef NUMPP_ENABLE_STATS
+#define NUMPP_STATS_COUNT(counter) \
+    ::numpp::instrumentation::counter.fetch_add(1, std::memory_order_relaxed)
+#define NUMPP_STATS_ALLOCATION(bytes) \
+    ::numpp::instrumentation::count_allocation(bytes)
+#define NUMPP_STATS_PROFILE(name) \
+    static ::numpp::instrumentation::Operation& numpp_stats_operation = ::numpp::instrumentation::operation(name); \
+    const ::numpp::instrumentation::ScopedTimer numpp_stats_timer(numpp_stats_operation)
+#else
+#define NUMPP_STATS_COUNT(counter) ((void) 0)
+#define NUMPP_STATS_ALLOCATION(bytes) ((void) 0)
+#define NUMPP_STATS_PROFILE(name) ((void) 0)
+#endif
+
+namespace numpp {
+    namespace instrumentation {
+        std::atomic<size_t> constructions(0);
+        std::atomic<size_t> copies(0);
+        std::atomic<size_t> moves(0);
+        std::atomic<size_t> allocations(0);
+        std::atomic<size_t> bytes_allocated(0);
+
+        void count_allocation(size_t bytes) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        struct Operation {
+            std::atomic<size_t> calls;
+            std::atomic<long long> nanoseconds;
+
+            Operation() : calls(0), nanoseconds(0) {}
+        };
+
+        std::mutex& registry_mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        /*
+         * Operations are keyed by name, so every instantiation of a template shares one entry.
+         * Entries are never removed: each call site keeps a reference to its entry in a local static.
+         * */
+        std::map<std::string, Operation>& registry() {
+            static std::map<std::string, Operation> operations;
+            return operations;
+        }
+
+        Operation& operation(const char* name) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            return registry()[name];
+        }
+
+        /*
+         * Adds one call and the wall time until the end of the scope to an operation.
+         * Time is inclusive: an operation that calls another one is also charged for it.
+         * */
+        class ScopedTimer {
+        private:
+            Operation& _operation;
+            std::chrono::steady_clock::time_point _start;
+
+        public:
+            explicit ScopedTimer(Operation& operation) : _operation(operation), _start(std::chrono::steady_clock::now()) {}
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+            ~ScopedTimer() {
+                const long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - _start).count();
+                _operation.calls.fetch_add(1, std::memory_order_relaxed);
+                _operation.nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+            }
+        };
+    }
+
+    Stats stats() {
+        Stats snapshot;
+        snapshot.constructions = instrumentation::constructions.load(std::memory_order_relaxed);
+        snapshot.copies = instrumentation::copies.load(std::memory_order_relaxed);
+        snapshot.moves = instrumentation::moves.load(std::memory_order_relaxed);
+        snapshot.allocations = instrumentation::allocations.load(std::memory_order_relaxed);
+        snapshot.bytes_allocated = instrumentation::bytes_allocated.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(instrumentation::registry_mutex());
+        for (const auto& entry : instrumentation::registry()) {
+            const size_t calls = entry.second.calls.load(std::memory_order_relaxed);
+            if (calls != 0) {
+                OperationStats& operation = snapshot.operations[entry.first];
+                operation.calls = calls;
+                operation.seconds = static_cast<double>(entry.second.nanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+            }
+        }
+        return snapshot;
+    }
+
+    void reset_stats() {
+        instrumentation::constructions.store(0, std::memory_order_relaxed);
+        instrumentation::copies.store(0, std::memory_order_relaxed);
+        instrumentation::moves.store(0, std::memory_order_relaxed);
+        instrumentation::allocations.store(0, std::memory_order_relaxed);
+        instrumentation::bytes_allocated.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(instrumentation::registry_mutex());
+        for (auto& entry : instrumentation::registry()) {
+            entry.second.calls.store(0, std::memory_order_relaxed);
+            entry.second.nanoseconds.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Stats& snapshot) {
+        os << "constructions: " << snapshot.constructions << '\n'
+           << "copies: " << snapshot.copies << '\n'
+           << "moves: " << snapshot.moves << '\n'
+           << "allocations: " << snapshot.allocations << " (" << snapshot.bytes_allocated << " bytes)\n";
+        for (const auto& entry : snapshot.operations) {
+            os << entry.first << ": " << entry.second.calls << " calls, " << entry.second.seconds << " s\n";
+        }
+        return os;
+    }
+}
+
+#endif //NUMPP_STATS_H
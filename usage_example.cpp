@@ -2,6 +2,8 @@
  * This is a non-comprehensive example on using NumPP.
  * For more usage information, see README.md please.
  * */
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include "NumPP/Matrix2D"
 
@@ -16,6 +18,15 @@ void printMatrix(const numpp::Matrix& matrix, const std::string& name) {
     std::cout << std::endl;
 }
 
+/*
+ * Report a result this example did not expect. The example then exits with a failure, so `ctest` catches it.
+ * */
+bool check(bool passed, const std::string& description) {
+    if (!passed)
+        std::cerr << "Unexpected result: " << description << std::endl;
+    return passed;
+}
+
 int main() {
     /*
      * Set this variable to true to print exception details to the console for IllegalArithmeticsException and IteratorBeyondRangeException.
@@ -38,8 +49,9 @@ int main() {
     numpp::Matrix b = A_b[{ 0, ED }][3];
     printMatrix(b, "b =");
 
-    // 3. Solve the equation Ax = b by left multiply A inverse on the both sides.
-    numpp::Matrix x = numpp::multiply(numpp::invert(A), b);
+    // 3. Solve the equation Ax = b (through an LU decomposition of A, which is cheaper and more accurate
+    //    than left multiplying A inverse on the both sides).
+    numpp::Matrix x = numpp::solve(A, b);
     printMatrix(x, "Solution of Ax = b:");
 
     // 4. Calculate the RREF form for A|I, and get the elimination matrix E.
@@ -74,6 +86,84 @@ int main() {
         std::cout << elem << " ";
     std::cout << std::endl;
 
-
-    return 0;
+    // 7. Free functions accept element-wise expressions as well as matrices.
+    bool as_expected = true;
+    numpp::Matrix half_inverse = numpp::invert(A * 2.0);
+    as_expected &= check(numpp::norm(half_inverse - numpp::invert(A) / 2.0) < 1e-12
+                         && numpp::norm(numpp::multiply(A + A, x) - b * 2.0) < 1e-12,
+                         "free functions called with expressions");
+
+    // 8. Negative indexes count from the end, and a slice can be assigned from an overlapping slice.
+    numpp::Matrix shifted{
+        {1, 2},
+        {3, 4},
+        {5, 6},
+        {7, 8}
+    };
+    as_expected &= check(shifted[{0, -1}].rowCount() == 3 && shifted[{1, -1}].rowCount() == 2
+                         && shifted[{0, ED}][{0, -1}].colCount() == 1,
+                         "negative slice ends");
+    shifted[{1, ED}] = shifted[{0, -1}] * 2.0;
+    printMatrix(shifted, "Rows shifted down by one and doubled:");
+    as_expected &= check((shifted == numpp::Matrix{{1, 2}, {2, 4}, {6, 8}, {10, 12}}).all(),
+                         "assignment between overlapping slices");
+
+    // 9. A sparse matrix is sliced the same way as the dense matrix it was built from.
+    numpp::SparseMatrix sparse{shifted};
+    numpp::SignedSlice slices[] = {{0, -1}, {1, -1}, {-3, -1}, {-2, ED}};
+    for (numpp::SignedSlice row_slice : slices) {
+        for (numpp::SignedSlice col_slice : {numpp::SignedSlice{0, ED}, numpp::SignedSlice{0, -1}}) {
+            numpp::Matrix dense_part = shifted[row_slice][col_slice];
+            numpp::Matrix sparse_part = sparse[row_slice][col_slice].toMatrix();
+            as_expected &= check(dense_part.shape() == sparse_part.shape() && (dense_part == sparse_part).all(),
+                                 "sparse and dense slices with negative indexes");
+        }
+    }
+
+    // 10. Save a matrix in NumPy's .npy format, then read it back and map it into memory.
+    numpp::save("usage_example.npy", shifted[{1, ED}][{0, 1}]);
+    numpp::Matrix loaded = numpp::load("usage_example.npy");
+    numpp::Matrix mapped = numpp::Matrix::mmap("usage_example.npy");
+    as_expected &= check(loaded.shape() == std::vector<size_t>{3, 1} && mapped.shape() == loaded.shape()
+                         && (loaded == numpp::Matrix{{2}, {6}, {10}}).all() && (mapped == loaded).all(),
+                         "save, load and mmap round trip");
+    mapped += 1.0;
+    mapped[{0, -1}] = mapped[{1, ED}];
+    as_expected &= check((mapped == numpp::Matrix{{7}, {11}, {11}}).all()
+                         && (numpp::load("usage_example.npy") == loaded).all(),
+                         "writes to a mapped matrix stay out of the file");
+
+    numpp::save("usage_example.npy", numpp::BasicMatrix<float>{{0.5f, -1.0f, 2.0f}});
+    as_expected &= check((numpp::load<float>("usage_example.npy") == numpp::BasicMatrix<float>{{0.5f, -1.0f, 2.0f}}).all(),
+                         "save and load of float elements");
+    std::remove("usage_example.npy");
+
+    // 11. Large matrices are summarized when formatted, keeping `edge_items` rows and columns on each side.
+    as_expected &= check(numpp::format(shifted, numpp::PrintOptions(6, 4, 1)) == "Matrix([\n\t[1, 2]\n\t...\n\t[10, 12]\n])\n"
+                         && numpp::format(shifted.T(), numpp::PrintOptions(6, 4, 1)) == "Matrix([\n\t[1, ..., 10]\n\t[2, ..., 12]\n])\n"
+                         && numpp::format(shifted, numpp::PrintOptions(6, 4, 0)) == "Matrix([\n\t...\n])\n"
+                         && numpp::format(shifted * 2.0, numpp::PrintOptions(6, 4, 1)) == "Matrix([\n\t[2, 4]\n\t...\n\t[20, 24]\n])\n"
+                         && numpp::to_string(shifted - shifted) == numpp::to_string(numpp::zeros(4, 2)),
+                         "summarized formatting");
+
+    // 12. Read delimited text, keeping only some of the columns.
+    std::ofstream("usage_example.csv") << "x,y,z\n1,2,3\n4,5,6\n";
+    as_expected &= check((numpp::load_csv("usage_example.csv", ',', 1, {2, 0}) == numpp::Matrix{{3, 1}, {6, 4}}).all(),
+                         "load_csv with selected columns");
+    bool repeated_column_rejected = false;
+    try {
+        numpp::load_csv("usage_example.csv", ',', 1, {0, 0});
+    }
+    catch (const numpp::IOException&) {
+        repeated_column_rejected = true;
+    }
+    as_expected &= check(repeated_column_rejected, "load_csv with a column selected twice");
+
+    // Anything strtod understands is accepted, such as hexadecimal numbers.
+    std::ofstream("usage_example.csv") << "0x10,2.5e1,-0x1p-1\n";
+    as_expected &= check((numpp::load_csv("usage_example.csv") == numpp::Matrix{{16, 25, -0.5}}).all(),
+                         "load_csv with hexadecimal fields");
+    std::remove("usage_example.csv");
+
+    return as_expected ? 0 : 1;
 }
\ No newline at end of file